@@ -11,6 +11,58 @@
 
 /* static kernel functions */
 
+/* bitsize-independent */
+
+// multiplies a*b (as 64 bit integers), returning the low part and storing the high part in '*hi'
+// NOTE: this is independent of the limb size, and is used by the transforms
+static uint64_t mpt_mul64(uint64_t a, uint64_t b, uint64_t* hi) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 t = (unsigned __int128)a * b;
+    *hi = (uint64_t)(t >> 64);
+    return (uint64_t)t;
+#else
+    uint64_t a0 = a & 0xffffffff, a1 = a >> 32;
+    uint64_t b0 = b & 0xffffffff, b1 = b >> 32;
+
+    uint64_t t00 = a0 * b0, t01 = a0 * b1, t10 = a1 * b0, t11 = a1 * b1;
+
+    // middle column, with the carries from the low column
+    uint64_t mid = (t00 >> 32) + (t01 & 0xffffffff) + (t10 & 0xffffffff);
+
+    *hi = t11 + (t01 >> 32) + (t10 >> 32) + (mid >> 32);
+    return (mid << 32) | (t00 & 0xffffffff);
+#endif
+}
+
+
+// return the time stamp counter (or the time in nanoseconds, if there isn't one)
+static inline uint64_t mpt_rdtsc() {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return (uint64_t)(1.0e9 * mpt_time());
+#endif
+}
+
+// return whether a progress line is due at iteration 'i' (which is just a compare, unless progress lines are on)
+static inline bool mpt_prog_due(mpt_prog_t* pr, int64_t i) {
+    return pr->active && i >= pr->next && mpt_prog_poll(pr, i);
+}
+
+// run 'stmt', and add its cycles to the phase 'ph' of 'pr' (if they are being counted)
+#define MPT_PROG_PHASE(pr, ph, stmt) do { \
+    if ((pr)->cycles) { \
+        uint64_t t0_ = mpt_rdtsc(); \
+        stmt; \
+        (pr)->cyc[ph] += mpt_rdtsc() - t0_; \
+    } else { \
+        stmt; \
+    } \
+} while (0)
+
+
 /* bitsize-dependent */
 
 
@@ -119,6 +171,10 @@ static void mptl_sub(mpt_limb_t a, mpt_limb_t b, mpt_limb_t* lohi) {
 // multiplies a*b, and calculates the low and high parts and stores in 'lohi', 
 // i.e. lohi[0] == lo, and lohi[1] == hi
 static void mptl_mul(mpt_limb_t a, mpt_limb_t b, mpt_limb_t* lohi) {
+#ifdef __SIZEOF_INT128__
+    // native 64x64 -> 128 bit multiply
+    lohi[0] = mpt_mul64(a, b, &lohi[1]);
+#else
     uint64_t u1 = (a & 0xffffffff);
     uint64_t v1 = (b & 0xffffffff);
     uint64_t t = (u1 * v1);
@@ -136,14 +192,13 @@ static void mptl_mul(mpt_limb_t a, mpt_limb_t b, mpt_limb_t* lohi) {
 
     lohi[1] = (a * b) + w1 + k;
     lohi[0] = (t << 32) + w3;
+#endif
 }
 
 
 #endif
 
 
-
-
 // Returns a limb which is in a bignum, but at a non-even multiple of MPT_LIMB_BITS,
 // This method will return a limb of the bits A[offset:offset+MPT_LIMB_BITS],
 // where offset can be between 0 and MPT_LIMB_BITS (if it's more, just offset 'A' before the call)
@@ -152,6 +207,30 @@ static mpt_limb_t mptl_getodd(mpt_limb_t* A, int64_t offset) {
     return (A[0] >> (offset)) | (A[1] << (MPT_LIMB_BITS - offset)); 
 }
 
+// push the next limb 'a' of the number being reduced by 'f' (see 'mpt_fold_t')
+// The low 'p' bits are stored in 'f->C' (minus the borrow in 'f->bw', which almost always stops at the first limb),
+//   and once a limb of the high part (A >> p) is complete, it is added onto the corresponding limb of 'f->C',
+//   with the carry held in 'f->cy'
+static inline void mpt_fold_push(mpt_fold_t* f, mpt_limb_t a) {
+    int64_t k = f->k++, j = k - f->q - 1;
+    if (j < 0) {
+        mpt_limb_t v = (k == f->q) ? (a & f->mask) : a;
+        f->C[k] = (k == f->q) ? ((v - f->bw) & f->mask) : (v - f->bw);
+        f->bw = v < f->bw;
+    } else {
+        mpt_limb_t h = (mpt_limb_t)((f->prev >> f->r) | (a << (MPT_LIMB_BITS - f->r)));
+        if (j <= f->q) {
+            mpt_limb_t s = f->C[j] + h, c1 = s < h;
+            s += f->cy;
+            f->cy = c1 | (s < f->cy);
+            f->C[j] = s;
+        } else {
+            f->top = h;
+        }
+    }
+    f->prev = a;
+}
+
 /* NUMBER THEORY */
 
 // Returns the GCD (Greatest Common Denominator) of 'A' and 'B'
@@ -201,15 +280,104 @@ static int64_t mpt_modinv(int64_t a, int64_t N) {
     }
 }
 
+/* 64 bit modular arithmetic */
+
+// return -m^-1 (mod 2^64), for an odd 'm'
+static inline uint64_t mpt_neginv64(uint64_t m) {
+    // Newton's iteration doubles the number of correct bits each time (and 'm' is its own inverse mod 8)
+    uint64_t x = m;
+    int i;
+    for (i = 0; i < 5; ++i) x *= 2 - m * x;
+    return -x;
+}
+
+// return a * b * 2^-64 (mod m), where a, b < m < 2^64, 'm' is odd, and mi == -m^-1 (mod 2^64)
+static inline uint64_t mpt_montmul64(uint64_t a, uint64_t b, uint64_t m, uint64_t mi) {
+    uint64_t hi, mhi;
+    uint64_t lo = mpt_mul64(a, b, &hi);
+    mpt_mul64(lo * mi, m, &mhi);
+
+    // the low halves sum to 0 (mod 2^64), with a carry unless they were both 0
+    uint64_t r = hi + mhi, c = r < hi;
+    r += lo != 0;
+    c |= r < (uint64_t)(lo != 0);
+
+    // NOTE: these are done with masks, since branches on them are unpredictable
+    return r - (m & -(c | (r >= m)));
+}
+
+// an odd modulus less than 2^64, for Montgomery multiplication (where 'a' is held as a * 2^64 (mod m))
+typedef struct {
+
+    // the modulus, and -m^-1 (mod 2^64)
+    uint64_t m, mi;
+
+    // 2^64 (mod m), which is 1 in Montgomery form, and 2^128 (mod m), which converts into it
+    uint64_t r1, r2;
+
+} mpt_mont64_t;
+
+// set up 'M' for an odd modulus 'm' (greater than 1)
+static void mpt_mont64_init(mpt_mont64_t* M, uint64_t m) {
+    M->m = m;
+    M->mi = mpt_neginv64(m);
+    M->r1 = (0 - m) % m;
+#ifdef __SIZEOF_INT128__
+    M->r2 = (uint64_t)(((unsigned __int128)M->r1 << 64) % m);
+#else
+    // double 2^64 up to 2^128
+    uint64_t r = M->r1;
+    int i;
+    for (i = 0; i < 64; ++i) {
+        uint64_t t = r << 1;
+        r = t - (m & -((r >> 63) | (t >= m)));
+    }
+    M->r2 = r;
+#endif
+}
+
+// return a * b (mod m), where both are in Montgomery form (and so is the result)
+static inline uint64_t mpt_mont64_mul(const mpt_mont64_t* M, uint64_t a, uint64_t b) {
+    return mpt_montmul64(a, b, M->m, M->mi);
+}
+
+// convert 'a' (any 64 bit value) into Montgomery form
+static inline uint64_t mpt_mont64_to(const mpt_mont64_t* M, uint64_t a) {
+    return mpt_montmul64(a % M->m, M->r2, M->m, M->mi);
+}
+
+// convert 'a' out of Montgomery form
+static inline uint64_t mpt_mont64_from(const mpt_mont64_t* M, uint64_t a) {
+    return mpt_montmul64(a, 1, M->m, M->mi);
+}
+
+// return a^e (mod m), where 'a' is in Montgomery form (and so is the result)
+static uint64_t mpt_mont64_pow(const mpt_mont64_t* M, uint64_t a, uint64_t e) {
+    uint64_t res = M->r1;
+    while (e > 0) {
+        if (e & 1) res = mpt_mont64_mul(M, res, a);
+        a = mpt_mont64_mul(M, a, a);
+        e >>= 1;
+    }
+    return res;
+}
+
 // Calculate a*b (mod m)
 static uint64_t mpt_modmul(uint64_t a, uint64_t b, uint64_t m) {
-    int64_t res = 0;
-    while (a != 0) {
-        if (a & 1) res = (res + b) % m;
-        a >>= 1;
-        b = (b << 1) % m;
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)((unsigned __int128)a * b % m);
+#else
+    // double and add, from the top bit of 'a' (with no divisions, and no overflow even if 'm' is near 2^64)
+    a %= m;
+    b %= m;
+    uint64_t res = 0;
+    int i;
+    for (i = 63; i >= 0; --i) {
+        res = res >= m - res ? res - (m - res) : res + res;
+        if ((a >> i) & 1) res = res >= m - b ? res - (m - b) : res + b;
     }
     return res;
+#endif
 }
 
 // Calculate a^b (mod m)
@@ -226,14 +394,18 @@ static int64_t mpt_modpow(int64_t a, int64_t b, int64_t m) {
         a %= m;
         if (a < 0) a += m;
 
+        if (m % 2 == 1 && m > 1) {
+            // odd, so use Montgomery form (with no divisions in the loop)
+            mpt_mont64_t M;
+            mpt_mont64_init(&M, m);
+            return mpt_mont64_from(&M, mpt_mont64_pow(&M, mpt_mont64_to(&M, a), b));
+        }
+
         // result
-        int64_t res = 1;
+        int64_t res = 1 % m;
 
         // now, calculate using repeated squaring
         while (b > 0) {
-            /*if (m == 4309503329) {
-                printf("%lli::%lli,%lli\n", res, a, b);
-            }*/
             if (b % 2 == 1) {
                 // multiply by active bit
                 res = mpt_modmul(res, a, m);
@@ -244,70 +416,71 @@ static int64_t mpt_modpow(int64_t a, int64_t b, int64_t m) {
             b /= 2;
         }
 
-        // ensure result is positive
-        if (res < 0) res += m;
         return res;
     }
 }
 
 
-/// Internal miller rabin trial test
-static bool i_milrab(int64_t n, int64_t a) {
-
-
-    if (n % a == 0) return false;
+/// Internal miller rabin trial test, of the odd 'n' (in 'M') to base 'a', where n - 1 == 2^r * d (with 'd' odd)
+static bool i_milrab(const mpt_mont64_t* M, uint64_t d, int r, uint64_t a) {
+    // a multiple of 'n' says nothing
+    a %= M->m;
+    if (a == 0) return true;
 
-    // Decompose: n = 2^r * d + 1
-    int64_t r = 0;
-    int64_t d = n - 1;
-
-    // take out powers of 2
-    while (d % 2 == 0) {
-        r++;
-        d /= 2;
-    }
-
-    // calculate a^d (mod n)
-    int64_t x = mpt_modpow(a, d, n);
+    // calculate a^d (mod n), in Montgomery form (so 1 and -1 are compared in that form too)
+    uint64_t one = M->r1, mone = M->m - M->r1;
+    uint64_t x = mpt_mont64_pow(M, mpt_mont64_to(M, a), d);
 
-    if (x == 1 || x == n - 1) {
+    if (x == one || x == mone) {
         // still might be prime
         return true;
     } else {
-        int64_t i;
+        int i;
         // complete the test 'r-1' times
         for (i = 0; i < r - 1; ++i) {
-            x = mpt_modmul(x, x, n);
+            x = mpt_mont64_mul(M, x, x);
             // still might be prime
-
-            if (x == n - 1) return true;
+            if (x == mone) return true;
         }
         // not prime, definitely composite
         return false;
     }
 }
 
+// return whether an unsigned 64 bit integer is prime
+// This is deterministic for every 64 bit integer: after trial division by the primes up to 37, Miller-Rabin is
+//   done with bases that have been checked to have no strong pseudoprimes in the range (3 bases below 2^32, and
+//   7 above it)
+static bool mpt_isprime_u64(uint64_t n) {
+    static const uint64_t smallp[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    static const uint64_t b32[] = { 2, 7, 61 };
+    static const uint64_t b64[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+    int i;
+    for (i = 0; i < (int)(sizeof(smallp) / sizeof(*smallp)); ++i) {
+        if (n % smallp[i] == 0) return n == smallp[i];
+    }
+    if (n < 41 * 41) return n > 1;
+
+    // Decompose: n = 2^r * d + 1
+    uint64_t d = n - 1;
+    int r = __builtin_ctzll(d);
+    d >>= r;
+
+    mpt_mont64_t M;
+    mpt_mont64_init(&M, n);
+
+    const uint64_t* bs = n < ((uint64_t)1 << 32) ? b32 : b64;
+    int nb = n < ((uint64_t)1 << 32) ? 3 : 7;
+    for (i = 0; i < nb; ++i) {
+        if (!i_milrab(&M, d, r, bs[i])) return false;
+    }
+    return true;
+}
+
 // return whether an integer is prime
 static bool mpt_isprime(int64_t val) {
-    // special cases
-    if (val < 2) return 0;
-    if (val < 4 || val == 5) return 1;
-    if (val % 2 == 0 || val % 3 == 0) return 0;
-
-    /**/ if (val < 2047) return i_milrab(val, 2);
-    else if (val < 1373653) return i_milrab(val, 2) && i_milrab(val, 3);
-    else if (val < 9080191) return i_milrab(val, 31) && i_milrab(val, 73);
-    else if (val < 25326001) return i_milrab(val, 2) && i_milrab(val, 3) && i_milrab(val, 5);
-    else if (val < 3215031751UL) return i_milrab(val, 2) && i_milrab(val, 3) && i_milrab(val, 5) && i_milrab(val, 7);
-    else if (val < 4759123141UL) return i_milrab(val, 2) && i_milrab(val, 7) && i_milrab(val, 61);
-    else if (val < 1122004669633UL) return i_milrab(val, 2) && i_milrab(val, 13) && i_milrab(val, 23) && i_milrab(val, 1662803);
-    else if (val < 2152302898747UL) return i_milrab(val, 2) && i_milrab(val, 3) && i_milrab(val, 5) && i_milrab(val, 7) && i_milrab(val, 11);
-    else if (val < 3474749660383UL) return i_milrab(val, 2) && i_milrab(val, 3) && i_milrab(val, 5) && i_milrab(val, 7) && i_milrab(val, 11) && i_milrab(val, 13);
-    else if (val < 341550071728321UL) return i_milrab(val, 2) && i_milrab(val, 3) && i_milrab(val, 5) && i_milrab(val, 7) && i_milrab(val, 11) && i_milrab(val, 13) && i_milrab(val, 17);
-    else {
-        // assume not prime
-        return 0;
-    }
+    return val >= 2 && mpt_isprime_u64((uint64_t)val);
 }
 
 
@@ -0,0 +1,579 @@
+/* MPT-kern.h - template for the hot arithmetic kernels, which are compiled once per instruction set
+ *
+ * This is included by 'src/kern.c' (after 'MPT-impl.h') once for each version, with these defined:
+ *   MPT_KERN_SFX: the suffix for the function names (i.e. '_generic')
+ *   MPT_KERN_TGT: the attributes for each function (i.e. '__attribute__((target("avx2")))')
+ *   MPT_KERN_ADX: 1 to use the add/sub with carry intrinsics for the carry chains (requires 64 bit limbs on x86_64),
+ *     or 0 for portable C
+ *   MPT_KERN_VEC: the width (in bits) of the vector intrinsics to use where a loop doesn't vectorize well on its
+ *     own (256 for AVX2, 512 for AVX-512F), or 0 for portable C
+ *
+ * Each version defines 'k_sqr_basecase', 'k_sqr_cols', 'k_sqr_mod2pm1', 'k_add_n', and 'k_sub_n' (with the suffix),
+ *   which have the same meaning as the fields of 'mpt_kern_t' (as does 'k_simd_sqr'), and 'k_sqr_small_tab' if
+ *   MPT_KERN_HAS_SMALL is defined
+ *
+ */
+
+#define MPT_KERN_CAT2(a, b) a##b
+#define MPT_KERN_CAT(a, b) MPT_KERN_CAT2(a, b)
+#define MPT_KERN_FN(name) MPT_KERN_CAT(name, MPT_KERN_SFX)
+
+// for the templates of the kernels, which must be inlined so their constant arguments are folded into them
+#ifndef MPT_KERN_INLINE
+#ifdef __GNUC__
+#define MPT_KERN_INLINE inline __attribute__((always_inline))
+#else
+#define MPT_KERN_INLINE inline
+#endif
+#endif
+
+
+/* carry chains */
+
+#if MPT_KERN_ADX
+
+// R = A + B, returns the carry (unrolled, so the adc's form a single chain)
+MPT_KERN_TGT
+static mpt_limb_t MPT_KERN_FN(k_add_n)(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B) {
+    unsigned long long r0, r1, r2, r3;
+    unsigned char c = 0;
+    int64_t i;
+    for (i = 0; i + 4 <= N; i += 4) {
+        c = _addcarry_u64(c, A[i + 0], B[i + 0], &r0);
+        c = _addcarry_u64(c, A[i + 1], B[i + 1], &r1);
+        c = _addcarry_u64(c, A[i + 2], B[i + 2], &r2);
+        c = _addcarry_u64(c, A[i + 3], B[i + 3], &r3);
+        R[i + 0] = r0;
+        R[i + 1] = r1;
+        R[i + 2] = r2;
+        R[i + 3] = r3;
+    }
+    for (; i < N; ++i) {
+        c = _addcarry_u64(c, A[i], B[i], &r0);
+        R[i] = r0;
+    }
+    return c;
+}
+
+// R = A - B, returns the borrow
+MPT_KERN_TGT
+static mpt_limb_t MPT_KERN_FN(k_sub_n)(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B) {
+    unsigned long long r0, r1, r2, r3;
+    unsigned char c = 0;
+    int64_t i;
+    for (i = 0; i + 4 <= N; i += 4) {
+        c = _subborrow_u64(c, A[i + 0], B[i + 0], &r0);
+        c = _subborrow_u64(c, A[i + 1], B[i + 1], &r1);
+        c = _subborrow_u64(c, A[i + 2], B[i + 2], &r2);
+        c = _subborrow_u64(c, A[i + 3], B[i + 3], &r3);
+        R[i + 0] = r0;
+        R[i + 1] = r1;
+        R[i + 2] = r2;
+        R[i + 3] = r3;
+    }
+    for (; i < N; ++i) {
+        c = _subborrow_u64(c, A[i], B[i], &r0);
+        R[i] = r0;
+    }
+    return c;
+}
+
+#else
+
+// R = A + B, returns the carry
+MPT_KERN_TGT
+static mpt_limb_t MPT_KERN_FN(k_add_n)(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B) {
+    int64_t i;
+    mpt_limb_t c = 0;
+    for (i = 0; i < N; ++i) {
+        mpt_limb_t a = A[i], s = a + B[i];
+        mpt_limb_t c1 = s < a;
+        s += c;
+        c = c1 | (s < c);
+        R[i] = s;
+    }
+    return c;
+}
+
+// R = A - B, returns the borrow
+MPT_KERN_TGT
+static mpt_limb_t MPT_KERN_FN(k_sub_n)(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B) {
+    int64_t i;
+    mpt_limb_t c = 0;
+    for (i = 0; i < N; ++i) {
+        mpt_limb_t a = A[i], b = B[i], d = a - b;
+        mpt_limb_t c1 = a < b;
+        R[i] = d - c;
+        c = c1 | (d < c);
+    }
+    return c;
+}
+
+#endif
+
+
+/* squaring */
+
+// calculate C=A^2, A[N], C[2N]
+// uses column-wise (Comba) squaring, O(N^2), but with half as many products as 'mpt_sqr_naive':
+// each column 'k' of the output is the sum of all A[i]*A[j] (i + j == k), which is computed as twice the sum
+//   of the products with i < j, plus A[k/2]^2. The column sum is held in a 3 limb accumulator (instead of
+//   rippling carries through 'C'), and then the low limb is stored and the accumulator is shifted down
+// NOTE: 3 limbs only hold the columns of fewer than MPT_SQR_COMBA_MAX_N limbs (which the callers check)
+// NOTE: with BMI2, the compiler uses mulx here (which doesn't touch the flags, so the adc's can be overlapped with
+//   the next product). Splitting the column into separate adcx and adox chains was measured to be slower, because
+//   each 3 limb accumulator is a serial chain anyway, and this is already bound by the multiplier
+// If 'f' is not NULL, each limb of the square is pushed into it (as soon as its column is done) instead of
+//   being stored in 'C', so the square is reduced (mod 2^p - 1) without ever being written out in full
+// Only the columns from 'k0' to 'k1' (exclusive) are done, and then what is left in the accumulator (which is
+//   less than 2 limbs) is the carry into column 'k1'. If 'cy' is NULL, that is the last limb of the square
+//   (k1 == 2N - 1), and otherwise it is stored in 'cy[0..1]' (see 'mpt_sqr_comba_par')
+MPT_KERN_TGT
+static void MPT_KERN_FN(k_sqr_comba)(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_fold_t* f, int64_t k0, int64_t k1, mpt_limb_t* cy) {
+    int64_t i, k;
+
+#if defined(MPT_LIMB_U64) && defined(__SIZEOF_INT128__)
+    typedef unsigned __int128 u128;
+
+    // accumulator, as 'ah:al'
+    u128 al = 0;
+    uint64_t ah = 0;
+
+    for (k = k0; k < k1; ++k) {
+        // off-diagonal products, as 'th:tl'
+        u128 tl = 0;
+        uint64_t th = 0;
+        for (i = (k < N ? 0 : k - N + 1); i < k - i; ++i) {
+            u128 t = (u128)A[i] * A[k - i];
+            tl += t;
+            th += tl < t;
+        }
+
+        // double them, and add the diagonal
+        th = (th << 1) | (uint64_t)(tl >> 127);
+        tl <<= 1;
+        if (k % 2 == 0) {
+            u128 t = (u128)A[k / 2] * A[k / 2];
+            tl += t;
+            th += tl < t;
+        }
+
+        al += tl;
+        ah += th + (al < tl);
+
+        if (f) mpt_fold_push(f, (uint64_t)al);
+        else C[k] = (uint64_t)al;
+        al = (al >> 64) | ((u128)ah << 64);
+        ah = 0;
+    }
+
+    if (cy) {
+        cy[0] = (uint64_t)al;
+        cy[1] = (uint64_t)(al >> 64);
+    } else if (f) {
+        mpt_fold_push(f, (uint64_t)al);
+    } else {
+        C[k1] = (uint64_t)al;
+    }
+#else
+    // accumulator
+    mpt_limb_t c0 = 0, c1 = 0, c2 = 0, lohi[2];
+
+    for (k = k0; k < k1; ++k) {
+        // off-diagonal products
+        mpt_limb_t t0 = 0, t1 = 0, t2 = 0;
+        for (i = (k < N ? 0 : k - N + 1); i < k - i; ++i) {
+            mptl_mul(A[i], A[k - i], lohi);
+            t0 += lohi[0];
+            lohi[1] += t0 < lohi[0];
+            t1 += lohi[1];
+            t2 += t1 < lohi[1];
+        }
+
+        // double them, and add the diagonal
+        t2 = (t2 << 1) | (t1 >> (MPT_LIMB_BITS - 1));
+        t1 = (t1 << 1) | (t0 >> (MPT_LIMB_BITS - 1));
+        t0 <<= 1;
+        if (k % 2 == 0) {
+            mptl_mul(A[k / 2], A[k / 2], lohi);
+            t0 += lohi[0];
+            lohi[1] += t0 < lohi[0];
+            t1 += lohi[1];
+            t2 += t1 < lohi[1];
+        }
+
+        mpt_limb_t cy;
+        c0 += t0;
+        cy = c0 < t0;
+        t1 += cy;
+        t2 += t1 < cy;
+        c1 += t1;
+        c2 += t2 + (c1 < t1);
+
+        if (f) mpt_fold_push(f, c0);
+        else C[k] = c0;
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+
+    if (cy) {
+        cy[0] = c0;
+        cy[1] = c1;
+    } else if (f) {
+        mpt_fold_push(f, c0);
+    } else {
+        C[k1] = c0;
+    }
+#endif
+}
+
+// C = A^2, see 'k_sqr_comba'
+MPT_KERN_TGT
+static void MPT_KERN_FN(k_sqr_basecase)(int64_t N, mpt_limb_t* A, mpt_limb_t* C) {
+    MPT_KERN_FN(k_sqr_comba)(N, A, C, NULL, 0, 2 * N - 1, NULL);
+}
+
+// C[k0..k1] = columns 'k0' to 'k1' (exclusive) of A^2, and the carry out of them into 'cy', see 'k_sqr_comba'
+MPT_KERN_TGT
+static void MPT_KERN_FN(k_sqr_cols)(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t k0, int64_t k1, mpt_limb_t* cy) {
+    MPT_KERN_FN(k_sqr_comba)(N, A, C, NULL, k0, k1, cy);
+}
+
+// C = A^2 - c (mod 2^p - 1), see 'k_sqr_comba'
+MPT_KERN_TGT
+static void MPT_KERN_FN(k_sqr_mod2pm1)(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c) {
+    mpt_fold_t f;
+    mpt_fold_init(&f, p, C, c);
+    MPT_KERN_FN(k_sqr_comba)(N, A, NULL, &f, 0, 2 * N - 1, NULL);
+    mpt_fold_finish(&f);
+}
+
+
+/* SIMD squaring */
+
+// see 'mpt_simd_sqr'
+// The products are 32x32 bit, so each vector of them is a single 'pmuludq' (with MPT_KERN_VEC, one 512 bit vector
+//   or two 256 bit ones for all of the lanes, and otherwise a plain loop over the lanes, which is the same work)
+// The square is summed column by column (off the diagonal with '2x', so it isn't doubled afterwards), splitting
+//   the sum every MPT_SIMD_CHUNK products. Then the columns are carried into digits, the high half (from bit 'p'
+//   of each lane) is added onto the low half along with 2^p - 1 - c (so nothing is negative), and the part that
+//   is still above bit 'p' (at most 2) is wrapped around to the bottom twice, which leaves it in [0, 2^p - 1]
+MPT_KERN_TGT
+static void MPT_KERN_FN(k_simd_sqr)(mpt_simd_t* s, uint64_t c) {
+    const int64_t L = MPT_SIMD_LANES, D = MPT_SIMD_BITS;
+    const uint64_t M = (1ULL << MPT_SIMD_BITS) - 1;
+    int64_t n = s->n, i, j, k, ie;
+    int l;
+    uint64_t* x = s->x, *x2 = s->x2, *z = s->z, *w = s->w;
+
+    for (i = 0; i < n * L; ++i) x2[i] = 2 * x[i];
+
+    for (k = 0; k < 2 * n - 1; ++k) {
+        // (the diagonal term, which isn't doubled)
+        uint64_t* lo = &z[k * L], *hi = &w[k * L];
+        for (l = 0; l < L; ++l) {
+            uint64_t d = k % 2 == 0 ? x[k / 2 * L + l] * x[k / 2 * L + l] : 0;
+            lo[l] = d & M;
+            hi[l] = d >> D;
+        }
+
+        // the products x[i] * x[k - i], for i < k - i < n
+        int64_t i0 = k < n ? 0 : k - n + 1, i1 = (k + 1) / 2;
+#if MPT_KERN_VEC == 512 && MPT_SIMD_LANES == 8
+        const __m512i vm = _mm512_set1_epi64((long long)M);
+        __m512i vlo = _mm512_loadu_si512(lo), vhi = _mm512_loadu_si512(hi);
+        for (i = i0; i < i1; i = ie) {
+            ie = i + MPT_SIMD_CHUNK < i1 ? i + MPT_SIMD_CHUNK : i1;
+            __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+            for (j = i; j + 2 <= ie; j += 2) {
+                a0 = _mm512_add_epi64(a0, _mm512_mul_epu32(_mm512_loadu_si512(&x2[j * L]), _mm512_loadu_si512(&x[(k - j) * L])));
+                a1 = _mm512_add_epi64(a1, _mm512_mul_epu32(_mm512_loadu_si512(&x2[(j + 1) * L]), _mm512_loadu_si512(&x[(k - j - 1) * L])));
+            }
+            if (j < ie) a0 = _mm512_add_epi64(a0, _mm512_mul_epu32(_mm512_loadu_si512(&x2[j * L]), _mm512_loadu_si512(&x[(k - j) * L])));
+            a0 = _mm512_add_epi64(a0, a1);
+            vlo = _mm512_add_epi64(vlo, _mm512_and_si512(a0, vm));
+            vhi = _mm512_add_epi64(vhi, _mm512_srli_epi64(a0, D));
+        }
+        _mm512_storeu_si512(lo, vlo);
+        _mm512_storeu_si512(hi, vhi);
+#elif MPT_KERN_VEC == 256 && MPT_SIMD_LANES == 8
+        const __m256i vm = _mm256_set1_epi64x((long long)M);
+        __m256i vlo0 = _mm256_loadu_si256((const __m256i*)&lo[0]), vlo1 = _mm256_loadu_si256((const __m256i*)&lo[4]);
+        __m256i vhi0 = _mm256_loadu_si256((const __m256i*)&hi[0]), vhi1 = _mm256_loadu_si256((const __m256i*)&hi[4]);
+        for (i = i0; i < i1; i = ie) {
+            ie = i + MPT_SIMD_CHUNK < i1 ? i + MPT_SIMD_CHUNK : i1;
+            __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+            for (j = i; j < ie; ++j) {
+                const __m256i* a = (const __m256i*)&x2[j * L], *b = (const __m256i*)&x[(k - j) * L];
+                a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(_mm256_loadu_si256(&a[0]), _mm256_loadu_si256(&b[0])));
+                a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(_mm256_loadu_si256(&a[1]), _mm256_loadu_si256(&b[1])));
+            }
+            vlo0 = _mm256_add_epi64(vlo0, _mm256_and_si256(a0, vm));
+            vlo1 = _mm256_add_epi64(vlo1, _mm256_and_si256(a1, vm));
+            vhi0 = _mm256_add_epi64(vhi0, _mm256_srli_epi64(a0, D));
+            vhi1 = _mm256_add_epi64(vhi1, _mm256_srli_epi64(a1, D));
+        }
+        _mm256_storeu_si256((__m256i*)&lo[0], vlo0);
+        _mm256_storeu_si256((__m256i*)&lo[4], vlo1);
+        _mm256_storeu_si256((__m256i*)&hi[0], vhi0);
+        _mm256_storeu_si256((__m256i*)&hi[4], vhi1);
+#else
+        for (i = i0; i < i1; i = ie) {
+            ie = i + MPT_SIMD_CHUNK < i1 ? i + MPT_SIMD_CHUNK : i1;
+            uint64_t acc[MPT_SIMD_LANES] = { 0 };
+            for (j = i; j < ie; ++j) {
+                const uint64_t* a = &x2[j * L], *b = &x[(k - j) * L];
+                for (l = 0; l < L; ++l) acc[l] += (a[l] & 0xffffffffULL) * (b[l] & 0xffffffffULL);
+            }
+            for (l = 0; l < L; ++l) {
+                lo[l] += acc[l] & M;
+                hi[l] += acc[l] >> D;
+            }
+        }
+#endif
+    }
+
+    // carry the columns into digits (the square is less than 2^(2Dn), so the last one holds the rest), then
+    //   x = lo + hi + 2^p - 1 - c, where digit 'j' of hi is the 'D' bits from bit 'p + Dj' (and the digits above
+    //   the top digit 'q' of a lane are left at 0, so the carry out of it is what is above bit 'p'), and then wrap
+    //   the part above bit 'p' around, twice
+#if MPT_KERN_VEC && MPT_SIMD_LANES == 8
+    // (with every lane in one 'kern_v8_t', so each digit is a few vector operations, and the lanes that are past
+    //   their top digit are masked off)
+    kern_v8_t* Z = (kern_v8_t*)z, *Wv = (kern_v8_t*)w, *X = (kern_v8_t*)x;
+    kern_v8_t zero = { 0 }, cy, tv, qv, tm, dt, e, top = { 0 };
+    memcpy(&tv, s->t, sizeof(tv));
+    memcpy(&qv, s->q, sizeof(qv));
+    tm = ((zero + 1) << tv) - 1;
+    dt = (uint64_t)D - tv;
+
+    cy = Z[0] >> D;
+    Z[0] &= M;
+    Z[2 * n - 1] = zero;
+    for (k = 1; k < 2 * n; ++k) {
+        kern_v8_t v = Z[k] + Wv[k - 1] + cy;
+        Z[k] = v & M;
+        cy = v >> D;
+    }
+
+    cy = zero;
+    for (j = 0; j < n; ++j) {
+        kern_v8_t a, b;
+        for (l = 0; l < L; ++l) {
+            int64_t q = s->q[l], jq = j < q ? j : q;
+            a[l] = z[(q + jq) * L + l];
+            b[l] = z[(q + jq + 1) * L + l];
+        }
+        kern_v8_t in = (kern_v8_t)((uint64_t)j <= qv), lt = (kern_v8_t)((uint64_t)j < qv), eq = (kern_v8_t)((uint64_t)j == qv);
+        kern_v8_t v = (((Z[j] + M) & lt) | (((Z[j] & tm) + tm) & eq)) + (((a >> tv) | ((b << dt) & M)) & in) + cy;
+        if (j == 0) v -= c;
+        X[j] = v & M & in;
+        cy = ((v >> D) & in) | (cy & ~in);
+    }
+
+    int pass;
+    for (pass = 0; pass < 2; ++pass) {
+        for (l = 0; l < L; ++l) top[l] = x[s->q[l] * L + l];
+        e = (top >> tv) | (cy << dt);
+        for (l = 0; l < L; ++l) x[s->q[l] * L + l] = top[l] & tm[l];
+        cy = e;
+        for (j = 0; j < n; ++j) {
+            kern_v8_t in = (kern_v8_t)((uint64_t)j <= qv), v = X[j] + cy;
+            X[j] = v & M & in;
+            cy = ((v >> D) & in) | (cy & ~in);
+        }
+    }
+#else
+    uint64_t cy[MPT_SIMD_LANES], tm[MPT_SIMD_LANES], e[MPT_SIMD_LANES];
+    for (l = 0; l < L; ++l) {
+        cy[l] = z[l] >> D;
+        z[l] &= M;
+        z[(2 * n - 1) * L + l] = 0;
+    }
+    for (k = 1; k < 2 * n; ++k) {
+        for (l = 0; l < L; ++l) {
+            uint64_t v = z[k * L + l] + w[(k - 1) * L + l] + cy[l];
+            z[k * L + l] = v & M;
+            cy[l] = v >> D;
+        }
+    }
+
+    for (l = 0; l < L; ++l) {
+        int64_t q = s->q[l], j;
+        uint64_t t = s->t[l], c0 = 0;
+        tm[l] = (1ULL << t) - 1;
+        for (j = 0; j <= q; ++j) {
+            uint64_t lo = j < q ? z[j * L + l] + M : (z[j * L + l] & tm[l]) + tm[l];
+            uint64_t hi = (z[(q + j) * L + l] >> t) | ((z[(q + j + 1) * L + l] << (D - t)) & M);
+            uint64_t v = lo + hi + c0 - (j == 0 ? c : 0);
+            x[j * L + l] = v & M;
+            c0 = v >> D;
+        }
+        for (; j < n; ++j) x[j * L + l] = 0;
+        cy[l] = c0;
+    }
+
+    int pass;
+    for (pass = 0; pass < 2; ++pass) {
+        for (l = 0; l < L; ++l) {
+            int64_t q = s->q[l], j;
+            uint64_t t = s->t[l], top = x[q * L + l];
+            e[l] = (top >> t) | (cy[l] << (D - t));
+            x[q * L + l] = top & tm[l];
+            for (j = 0; j <= q; ++j) {
+                uint64_t v = x[j * L + l] + e[l];
+                x[j * L + l] = v & M;
+                e[l] = v >> D;
+            }
+            cy[l] = e[l];
+        }
+    }
+#endif
+}
+
+
+/* small squarings */
+
+#ifdef MPT_KERN_HAS_SMALL
+
+// S = S^2 - c (mod 2^p - 1), where S has N == p / 64 + 1 limbs (and is less than 2^p)
+// This is a template: each caller passes a constant 'N' (see 'k_sqr_small_tab'), so every loop is unrolled into
+//   straight-line code (with no loop counters or carry loops), and the square never leaves the registers (or the
+//   stack, for the larger ones)
+// The square (less than 2^2p) is split at bit 'p' into 'lo' and 'hi' (both less than 2^p), and their sum is
+//   folded once more at bit 'p', which leaves it at most 2^p - 1. Then 'c' is subtracted (and 2^p - 1 is added
+//   back if that borrows), and 2^p - 1 becomes 0
+MPT_KERN_TGT
+static MPT_KERN_INLINE void MPT_KERN_FN(k_sqr_small)(const int N, mpt_limb_t* S, int64_t p, mpt_limb_t c) {
+    typedef unsigned __int128 u128;
+    uint64_t a[MPT_SQR_SMALL_N], t[2 * MPT_SQR_SMALL_N];
+    int i, k, r = (int)(p % 64);
+    uint64_t mask = ((uint64_t)1 << r) - 1;
+
+    // (the pragmas are for 2 * MPT_SQR_SMALL_N, since the compiler gives up on fully unrolling before that)
+    #pragma GCC unroll 32
+    for (i = 0; i < N; ++i) a[i] = S[i];
+
+    // the square, column by column, the same as 'k_sqr_comba'
+    u128 al = 0;
+    uint64_t ah = 0;
+    #pragma GCC unroll 32
+    for (k = 0; k < 2 * N - 1; ++k) {
+        u128 tl = 0;
+        uint64_t th = 0;
+        #pragma GCC unroll 32
+        for (i = (k < N ? 0 : k - N + 1); i < k - i; ++i) {
+            u128 m = (u128)a[i] * a[k - i];
+            tl += m;
+            th += tl < m;
+        }
+        th = (th << 1) | (uint64_t)(tl >> 127);
+        tl <<= 1;
+        if (k % 2 == 0) {
+            u128 m = (u128)a[k / 2] * a[k / 2];
+            tl += m;
+            th += tl < m;
+        }
+        al += tl;
+        ah += th + (al < tl);
+        t[k] = (uint64_t)al;
+        al = (al >> 64) | ((u128)ah << 64);
+        ah = 0;
+    }
+    t[2 * N - 1] = (uint64_t)al;
+
+    // a = lo + hi, where limb 'i' of hi is bits 'p + 64i' and up (and (x << 1) << (63 - r) is x << (64 - r), but
+    //   is still defined for r == 0). It is less than 2^(p+1), so it fits in 'N' limbs
+    u128 s = 0;
+    #pragma GCC unroll 32
+    for (i = 0; i < N; ++i) {
+        uint64_t lo = i < N - 1 ? t[i] : t[i] & mask;
+        uint64_t hi = (t[N - 1 + i] >> r) | ((t[N + i] << 1) << (63 - r));
+        s += (u128)lo + hi;
+        a[i] = (uint64_t)s;
+        s >>= 64;
+    }
+
+    // fold bit 'p' back onto the bottom (which can't carry past bit 'p' again)
+    s = a[N - 1] >> r;
+    a[N - 1] &= mask;
+    #pragma GCC unroll 32
+    for (i = 0; i < N; ++i) {
+        s += a[i];
+        a[i] = (uint64_t)s;
+        s >>= 64;
+    }
+
+    // a -= c, and if it borrows, it wrapped around to a - c + 2^64N, and a - c + 2^p - 1 is wanted (which is the
+    //   low 'p' bits of that, minus 1)
+    uint64_t bw = c;
+    #pragma GCC unroll 32
+    for (i = 0; i < N; ++i) {
+        uint64_t v = a[i];
+        a[i] = v - bw;
+        bw = v < bw;
+    }
+    if (bw) {
+        a[N - 1] &= mask;
+        bw = 1;
+        #pragma GCC unroll 32
+        for (i = 0; i < N; ++i) {
+            uint64_t v = a[i];
+            a[i] = v - bw;
+            bw = v < bw;
+        }
+    }
+
+    // 2^p - 1 is 0
+    uint64_t ones = a[N - 1] ^ mask;
+    #pragma GCC unroll 32
+    for (i = 0; i < N - 1; ++i) ones |= ~a[i];
+    uint64_t keep = ones == 0 ? 0 : ~(uint64_t)0;
+
+    #pragma GCC unroll 32
+    for (i = 0; i < N; ++i) S[i] = a[i] & keep;
+}
+
+// an instance of 'k_sqr_small' for 'n' limbs
+#define MPT_KERN_SMALL_FN(n) \
+MPT_KERN_TGT \
+static void MPT_KERN_FN(k_sqr_small_##n)(mpt_limb_t* S, int64_t p, mpt_limb_t c) { \
+    MPT_KERN_FN(k_sqr_small)(n, S, p, c); \
+}
+
+MPT_KERN_SMALL_FN(1)
+MPT_KERN_SMALL_FN(2)
+MPT_KERN_SMALL_FN(3)
+MPT_KERN_SMALL_FN(4)
+MPT_KERN_SMALL_FN(5)
+MPT_KERN_SMALL_FN(6)
+MPT_KERN_SMALL_FN(7)
+MPT_KERN_SMALL_FN(8)
+MPT_KERN_SMALL_FN(9)
+MPT_KERN_SMALL_FN(10)
+MPT_KERN_SMALL_FN(11)
+MPT_KERN_SMALL_FN(12)
+MPT_KERN_SMALL_FN(13)
+MPT_KERN_SMALL_FN(14)
+MPT_KERN_SMALL_FN(15)
+MPT_KERN_SMALL_FN(16)
+
+// the instance for each 'N' (indexed by 'N'), see 'mpt_kern_t'
+// NOTE: there is one for each N up to 16, so MPT_SQR_SMALL_N can be lowered, but not raised past that
+static void (*const MPT_KERN_FN(k_sqr_small_tab)[MPT_SQR_SMALL_N + 1])(mpt_limb_t* S, int64_t p, mpt_limb_t c) = {
+    NULL,
+    MPT_KERN_FN(k_sqr_small_1), MPT_KERN_FN(k_sqr_small_2), MPT_KERN_FN(k_sqr_small_3), MPT_KERN_FN(k_sqr_small_4),
+    MPT_KERN_FN(k_sqr_small_5), MPT_KERN_FN(k_sqr_small_6), MPT_KERN_FN(k_sqr_small_7), MPT_KERN_FN(k_sqr_small_8),
+    MPT_KERN_FN(k_sqr_small_9), MPT_KERN_FN(k_sqr_small_10), MPT_KERN_FN(k_sqr_small_11), MPT_KERN_FN(k_sqr_small_12),
+    MPT_KERN_FN(k_sqr_small_13), MPT_KERN_FN(k_sqr_small_14), MPT_KERN_FN(k_sqr_small_15), MPT_KERN_FN(k_sqr_small_16),
+};
+
+#undef MPT_KERN_SMALL_FN
+
+#endif
+
+
+#undef MPT_KERN_FN
+#undef MPT_KERN_CAT
+#undef MPT_KERN_CAT2
@@ -20,12 +20,51 @@
 #include <time.h>
 #include <sys/time.h>
 
+#include <pthread.h>
+
 
 /* config options */
 
 // if defined, print out intermediate terms
 //#define MPT_TRACE_TERMS
 
+// squaring algorithm crossovers (in limbs), see 'mpt_sqr'
+// NOTE: below MPT_SQR_KARA_THRESH, the basecase ('mpt_sqr_comba') is used
+#define MPT_SQR_KARA_THRESH 80
+#define MPT_SQR_TOOM3_THRESH 200
+#define MPT_SQR_TOOM4_THRESH 800
+
+// the basecase sums each column in 3 limbs, which can overflow from this many limbs (only reachable with 8 bit
+//   limbs), so larger squares are done with 'mpt_sqr_naive' instead
+#define MPT_SQR_COMBA_MAX_N (MPT_LIMB_BITS < 32 ? ((int64_t)1 << MPT_LIMB_BITS) - 1 : INT64_MAX)
+
+// up to this many limbs (p < 1024, with 64 bit limbs), a squaring (mod 2^p - 1) is done with a kernel that is
+//   fully unrolled for its exact size (see 'mpt_kern_t'), instead of the general one
+#define MPT_SQR_SMALL_N 16
+
+// with more than 1 thread per squaring (see 'mpt_sqr_threads'), the parallel basecase ('mpt_sqr_comba_par') is
+//   used from MPT_SQR_PAR_THRESH limbs up to MPT_SQR_KARA_THRESH limbs per thread (where the serial parts of
+//   Karatsuba and Toom start to cost more than the products they save), and the reduction is done in parallel
+//   from MPT_MOD_PAR_THRESH limbs
+#define MPT_SQR_PAR_THRESH 160
+#define MPT_MOD_PAR_THRESH 4096
+
+// the alignment of the buffers from 'mpt_alloc_aligned' (and the workspace of a test context), in bytes
+#define MPT_ALIGN 64
+
+// the decimal conversions (see 'mpt_getdecstr') split numbers by powers of 10 down to blocks of this many digits,
+//   which are converted directly (in O(n^2))
+// NOTE: must be a multiple of 9
+#define MPT_DEC_BLOCK 576
+
+// the smallest block that the workspace of a test context allocates, in bytes (see 'mpt_arena_t')
+#define MPT_ARENA_MIN (1 << 16)
+
+// the 'auto' engine (the default) tests exponents below these with 'ifma0' (if the CPU has AVX-512 IFMA), or else
+//   'basic0', and the rest with 'fft0', which is only faster once the transform is long (see 'mpt_engine_auto')
+#define MPT_AUTO_IFMA_P 100000
+#define MPT_AUTO_BASIC_P 30000
+
 
 /* MPT types */
 
@@ -42,7 +81,10 @@
 //#define MPT_LIMB_U32
 
 // unsigned 64 bit
+// NOTE: this is the default, if none of them are defined (i.e. with '-DMPT_LIMB_U32' in CFLAGS)
+#if !defined(MPT_LIMB_U8) && !defined(MPT_LIMB_U16) && !defined(MPT_LIMB_U32) && !defined(MPT_LIMB_U64)
 #define MPT_LIMB_U64
+#endif
 
 
 #if   defined(MPT_LIMB_U8)
@@ -81,7 +123,11 @@ typedef uint64_t mpt_limb_t;
 
 /* MPT functions */
 
-// allocate (using malloc) a buffer large enough for 'bts' bits
+// allocate a buffer of at least 'sz' bytes, aligned to MPT_ALIGN bytes (a cache line, and an AVX-512 vector)
+// NOTE: Use 'free()' on the resulting buffer
+void* mpt_alloc_aligned(size_t sz);
+
+// allocate a buffer large enough for 'bts' bits (with 'mpt_alloc_aligned')
 // NOTE: Use 'free()' on the resulting buffer
 mpt_limb_t* mpt_alloc_bits(size_t bts);
 
@@ -98,9 +144,25 @@ void mpt_set_Mp(mpt_limb_t* Mp, int64_t p);
 // NOTE: output should hold at least (sz * MPT_HDPL + 4) bytes
 void mpt_gethexstr(mpt_limb_t* Mp, int64_t sz, char* output);
 
-// Set a given MPT bignum from a hex string
+// Set a given MPT bignum from a hex string (with an optional '0x' prefix)
+// 'N' is the number of limbs (and any digits past them are ignored)
 void mpt_sethexstr(mpt_limb_t* Mp, int64_t N, char* str);
 
+// convert a number to decimal string (without leading zeros), by splitting it in half by powers of 10, which
+//   takes O(M(n) log n) instead of O(n^2) (see 'src/radix.c')
+// 'sz' is the number of limbs
+// NOTE: output should hold at least (sz * MPT_LIMB_BITS / 3 + 2) bytes
+void mpt_getdecstr(mpt_limb_t* A, int64_t sz, char* output);
+
+// Set a given MPT bignum from a decimal string (joining the halves with powers of 10, like 'mpt_getdecstr')
+// 'N' is the number of limbs (and the value is taken modulo B^N, if it doesn't fit)
+// NOTE: it stops at the first character that isn't a digit (and is 0 if there are none)
+void mpt_setdecstr(mpt_limb_t* A, int64_t N, char* str);
+
+// free the powers of 10 (and their reciprocals) that the decimal conversions keep
+// NOTE: the first conversion of each size computes them, and the rest (in every thread) just use them, until this
+void mpt_radix_clear();
+
 // Set A <- A + b
 // Where 'A' has 'N' limbs
 void mpt_addl(int64_t N, mpt_limb_t* A, mpt_limb_t b);
@@ -109,21 +171,1026 @@ void mpt_addl(int64_t N, mpt_limb_t* A, mpt_limb_t b);
 // Where 'A' has 'N' limbs
 void mpt_subl(int64_t N, mpt_limb_t* A, mpt_limb_t b);
 
+// R = A + B, and returns the carry
+// Where 'A', 'B', and 'R' have 'N' limbs ('R' may be the same as 'A' or 'B')
+mpt_limb_t mpt_add_n(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B);
+
+// R = A - B, and returns the borrow
+// Where 'A', 'B', and 'R' have 'N' limbs ('R' may be the same as 'A' or 'B')
+mpt_limb_t mpt_sub_n(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B);
+
+// R = A + B, and returns the carry
+// Where 'A' and 'R' have 'NA' limbs, and 'B' has 'NB' limbs (NA >= NB)
+mpt_limb_t mpt_add(mpt_limb_t* R, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB);
+
+// R = A - B, and returns the borrow
+// Where 'A' and 'R' have 'NA' limbs, and 'B' has 'NB' limbs (NA >= NB)
+mpt_limb_t mpt_sub(mpt_limb_t* R, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB);
+
+// compare A and B (both 'N' limbs), returning -1 (A < B), 0 (A == B), or 1 (A > B)
+int mpt_cmp(int64_t N, mpt_limb_t* A, mpt_limb_t* B);
+
+// R = A << s, and returns the bits shifted out of the top
+// Where 'A' and 'R' have 'N' limbs, and 0 < s < MPT_LIMB_BITS
+mpt_limb_t mpt_lshift(int64_t N, mpt_limb_t* R, mpt_limb_t* A, int s);
+
+// R = A >> s, and returns the bits shifted out of the bottom (in the high bits of the result)
+// Where 'A' and 'R' have 'N' limbs, and 0 < s < MPT_LIMB_BITS
+mpt_limb_t mpt_rshift(int64_t N, mpt_limb_t* R, mpt_limb_t* A, int s);
+
+// R = A / d, where 'd' is odd, and divides 'A' exactly
+// Where 'A' and 'R' have 'N' limbs
+void mpt_divexact_1(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t d);
+
 // squares a number:
 // C = A^2
 // Where 'A' has 'N' limbs, and 'C' has '2N' limbs
 // NOTE: 'A' and 'C' must not overlap!
 void mpt_sqr_naive(int64_t N, mpt_limb_t* A, mpt_limb_t* C);
 
+// squares a number, column by column (Comba), only computing each off-diagonal product once:
+// C = A^2
+// Where 'A' has 'N' limbs, and 'C' has '2N' limbs
+// NOTE: 'A' and 'C' must not overlap! This is the basecase of 'mpt_sqr' (up to MPT_SQR_COMBA_MAX_N limbs)
+void mpt_sqr_comba(int64_t N, mpt_limb_t* A, mpt_limb_t* C);
+
+// the number of threads to use for each squaring, and each reduction (default: 1)
+// NOTE: this is used by 'mpt_sqr', 'mpt_mod2pm1', and 'mpt_sqr_mod' (and so by the basic0 and prp0 engines), and
+//   by the four-step IBDWT (see 'mpt_fft_init')
+extern int mpt_sqr_threads;
+
+// squares a number with the basecase ('mpt_sqr_comba'), on 'nthr' threads:
+// C = A^2
+// Where 'A' has 'N' limbs, and 'C' has '2N' limbs
+// NOTE: the columns of 'C' are split up so that each thread does about the same number of products (the middle
+//   ones have the most), and then the carry out of each thread's columns is added on to the next in parallel
+// NOTE: 'A' and 'C' must not overlap!
+void mpt_sqr_comba_par(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int nthr);
+
+// squares a number with Karatsuba (2 pieces, O(N^1.58)), Toom-3 (3 pieces, O(N^1.46)), or Toom-4 (4 pieces, O(N^1.40)):
+// C = A^2
+// Where 'A' has 'N' limbs, 'C' has '2N' limbs, and 'T' is scratch space of 'mpt_sqr_scratch(N)' limbs
+// NOTE: 'A', 'C', and 'T' must not overlap! That scratch space is only enough if 'N' is in the range where 'mpt_sqr'
+//   picks the same algorithm (see MPT_SQR_*_THRESH), and outside of it, they may need more
+void mpt_sqr_kara(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T);
+void mpt_sqr_toom3(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T);
+void mpt_sqr_toom4(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T);
+
+// squares a number with the fastest algorithm for 'N' (and the pieces are squared recursively with this too):
+// C = A^2
+// Where 'A' has 'N' limbs, 'C' has '2N' limbs, and 'T' is scratch space of 'mpt_sqr_scratch(N)' limbs
+// NOTE: 'A', 'C', and 'T' must not overlap!
+void mpt_sqr(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T);
+
+// return the number of limbs of scratch space needed by 'mpt_sqr' for 'N' limbs
+int64_t mpt_sqr_scratch(int64_t N);
+
+// multiplies two numbers (with two squarings by 'mpt_sqr', since 4AB = (A + B)^2 - (A - B)^2, or the schoolbook
+//   product, if 'B' is below MPT_SQR_KARA_THRESH limbs, or in pieces the size of 'B', if 'A' is much larger):
+// C = A * B
+// Where 'A' has 'NA' limbs, 'B' has 'NB' limbs (NA >= NB > 0), 'C' has 'NA + NB' limbs, and 'T' is scratch space of
+//   'mpt_mul_scratch(NA, NB)' limbs
+// NOTE: 'A', 'B', 'C', and 'T' must not overlap ('A' and 'B' may be the same)!
+void mpt_mul(mpt_limb_t* C, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB, mpt_limb_t* T);
+
+// return the number of limbs of scratch space needed by 'mpt_mul' for 'NA' and 'NB' limbs
+int64_t mpt_mul_scratch(int64_t NA, int64_t NB);
+
+
+// state for reducing a number (mod 2^p - 1) one limb at a time, starting from the least significant, in a
+//   single pass: the part above bit 'p' is added onto the part below it as the limbs come in (since 2^p == 1)
+// NOTE: use 'mpt_fold_init', then 'mpt_fold_push' for each limb (in 'MPT-impl.h'), then 'mpt_fold_finish'
+// NOTE: 'p' must not be a multiple of MPT_LIMB_BITS (which no odd 'p' is), and this holds for everything that
+//   reduces (mod 2^p - 1) with it (i.e. 'mpt_mod2pm1', 'mpt_sqr_mod2pm1', and 'mpt_sqr_mod')
+typedef struct mpt_fold_s {
+
+    // the exponent, and it split into limbs and bits (p == q * MPT_LIMB_BITS + r)
+    int64_t p, q;
+    int r;
+
+    // mask for the bits below 'p' in the top limb of the result
+    mpt_limb_t mask;
+
+    // the result, which has 'q + 1' limbs
+    mpt_limb_t* C;
+
+    // number of limbs pushed so far, and the last one
+    int64_t k;
+    mpt_limb_t prev;
+
+    // the carry into the next limb of the high part, and the part of the high part that is past 'C'
+    mpt_limb_t cy, top;
+
+    // the borrow out of the low part (which starts out as the 'c' to subtract)
+    mpt_limb_t bw;
+
+} mpt_fold_t;
+
+// start reducing a number minus 'c' (mod 2^p - 1) into 'C', which has (p / MPT_LIMB_BITS + 1) limbs
+// NOTE: at most 2 * (p / MPT_LIMB_BITS + 1) limbs may be pushed, and 'c' must be less than 2^p - 1
+void mpt_fold_init(mpt_fold_t* f, int64_t p, mpt_limb_t* C, mpt_limb_t c);
+
+// finish the reduction (the limbs that were not pushed are 0), and fully reduce 'C' (so 2^p - 1 becomes 0)
+void mpt_fold_finish(mpt_fold_t* f);
 
 // calculates:
 // C = A (mod 2^p - 1)
-// NOTE: does this in place
-void mpt_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t* Mp);
+// Where 'A' has 'N' limbs (at most 2 * (p / MPT_LIMB_BITS + 1)), and 'C' has (p / MPT_LIMB_BITS + 1) limbs
+// NOTE: this makes a single pass over 'A', and 'C' may be the same as 'A'
+void mpt_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p);
+
+// calculates:
+// C = A - c (mod 2^p - 1)
+// Where 'A' and 'C' are the same as 'mpt_mod2pm1', and 'c' is less than 2^p - 1
+// NOTE: the 'c' is subtracted as the first limbs are folded (see 'mpt_fold_t'), so it costs nothing extra, and
+//   with more than 1 thread (see 'mpt_sqr_threads'), it is done with 'mpt_mod2pm1_par'
+void mpt_mod2pm1_c(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c);
+
+// calculates, on 'nthr' threads:
+// C = A - c (mod 2^p - 1)
+// Where 'A' has 'N' limbs (at most 2 * (p / MPT_LIMB_BITS + 1)), 'C' has (p / MPT_LIMB_BITS + 1) limbs, and 'c'
+//   is less than 2^p - 1
+// NOTE: each thread adds the high part onto the low part for its own limbs of 'C', and then the carries between
+//   them are added on in parallel, and it is finished like 'mpt_fold_finish'
+// NOTE: 'A' and 'C' must not overlap!
+void mpt_mod2pm1_par(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c, int nthr);
+
+// squares a number (mod 2^p - 1), with the basecase ('mpt_sqr_comba'), which reduces each limb of the square as
+//   soon as it is computed, so the double width square is never stored:
+// C = A^2 - c (mod 2^p - 1)
+// Where 'A' and 'C' have 'N' limbs, N == p / MPT_LIMB_BITS + 1, and 'c' is less than 2^p - 1
+// NOTE: 'A' and 'C' must not overlap, and 'N' must be less than MPT_SQR_COMBA_MAX_N!
+void mpt_sqr_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c);
+
+// squares a number (mod 2^p - 1), in place, with the '- c' as the carry-in of the reduction:
+// S = S^2 - c (mod 2^p - 1)
+// Where 'S' has (p / MPT_LIMB_BITS + 1) limbs, 'c' is less than 2^p - 1, and 'T' is scratch space of
+//   'mpt_ll_scratch(p)' limbs
+// NOTE: 'S' does not have to be reduced (but the result is), and 'S' and 'T' must not overlap!
+void mpt_sqr_mod(int64_t p, mpt_limb_t* S, mpt_limb_t c, mpt_limb_t* T);
+
+// does a single step of the Lucas-Lehmer test, in place, with the '- 2' as the carry-in of the reduction
+//   (so 'Mp' is never needed as a number):
+// S = S^2 - 2 (mod 2^p - 1)
+// Where 'S' has (p / MPT_LIMB_BITS + 1) limbs, and 'T' is scratch space of 'mpt_ll_scratch(p)' limbs
+// NOTE: 'S' and 'T' must not overlap!
+void mpt_ll_step(int64_t p, mpt_limb_t* S, mpt_limb_t* T);
+
+// the same as 'mpt_sqr_mod', but the cycles of the square and of the reduction (with the '- c') are added to
+//   'cyc' (see 'MPT_PHASE_*')
+void mpt_sqr_mod_timed(int64_t p, mpt_limb_t* S, mpt_limb_t c, mpt_limb_t* T, uint64_t* cyc);
+
+// return the number of limbs of scratch space needed by 'mpt_ll_step' and 'mpt_sqr_mod' for 'p'
+int64_t mpt_ll_scratch(int64_t p);
+
+// calculates:
+// C = A - B (mod 2^p - 1)
+// Where 'A', 'B', and 'C' have (p / MPT_LIMB_BITS + 1) limbs, and 'A' and 'B' are reduced ('C' may be either)
+void mpt_sub_mod(int64_t p, mpt_limb_t* A, mpt_limb_t* B, mpt_limb_t* C);
+
+// multiplies 2 numbers (mod 2^p - 1), with 2 squarings:
+// C = A * B (mod 2^p - 1)
+// Where 'A', 'B', and 'C' have (p / MPT_LIMB_BITS + 1) limbs, 'A' and 'B' are reduced, and 'T' is scratch space of
+//   'mpt_mod_scratch(p)' limbs
+// NOTE: 'C' may be the same as 'A' or 'B', but none of them may overlap 'T'
+void mpt_mul_mod(int64_t p, mpt_limb_t* A, mpt_limb_t* B, mpt_limb_t* C, mpt_limb_t* T);
+
+// return the number of limbs of scratch space needed by 'mpt_mul_mod' for 'p'
+int64_t mpt_mod_scratch(int64_t p);
+
+// calculates:
+// G = gcd(A, B)
+// Where 'A', 'B', and 'G' have 'N' limbs, and 'B' is odd ('G' may be either of them)
+void mpt_gcd_n(int64_t N, mpt_limb_t* A, mpt_limb_t* B, mpt_limb_t* G);
+
+
+/* CPU dispatch */
+
+// CPU features (from 'mpt_cpu_features')
+#define MPT_CPU_BMI2        0x01
+#define MPT_CPU_ADX         0x02
+#define MPT_CPU_AVX2        0x04
+#define MPT_CPU_AVX512F     0x08
+#define MPT_CPU_AVX512IFMA  0x10
+
+// (see below)
+struct mpt_simd_s;
+
+// a version of the hot arithmetic kernels, for a given instruction set
+// NOTE: use the 'mpt_' functions (i.e. 'mpt_add_n'), which call the current kernels in 'mpt_kern'
+typedef struct mpt_kern_s {
+
+    // name of the version (i.e. "generic", "adx", "avx2", "avx512")
+    const char* name;
+
+    // the CPU features it requires (MPT_CPU_*)
+    int req;
+
+    // see 'mpt_sqr_comba'
+    void (*sqr_basecase)(int64_t N, mpt_limb_t* A, mpt_limb_t* C);
+
+    // columns 'k0' to 'k1' (exclusive) of the basecase, and the carry out of them (see 'mpt_sqr_comba_par')
+    void (*sqr_cols)(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t k0, int64_t k1, mpt_limb_t* cy);
+
+    // see 'mpt_sqr_mod2pm1'
+    void (*sqr_mod2pm1)(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c);
+
+    // S = S^2 - c (mod 2^p - 1) in place, fully unrolled for each 'N' (where N == p / MPT_LIMB_BITS + 1), indexed
+    //   by 'N' up to MPT_SQR_SMALL_N, and 'S' must be less than 2^p (see 'mpt_sqr_mod')
+    // NOTE: this is NULL if the limbs aren't 64 bits (or there are no 128 bit products)
+    void (*const* sqr_small)(mpt_limb_t* S, int64_t p, mpt_limb_t c);
+
+    // see 'mpt_simd_sqr'
+    void (*simd_sqr)(struct mpt_simd_s* s, uint64_t c);
+
+    // see 'mpt_add_n' and 'mpt_sub_n'
+    mpt_limb_t (*add_n)(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B);
+    mpt_limb_t (*sub_n)(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B);
+
+} mpt_kern_t;
+
+// the kernels currently in use (the generic ones, until 'mpt_kern_init' is called)
+extern mpt_kern_t mpt_kern;
+
+// return the features of the CPU that are usable (MPT_CPU_* flags)
+int mpt_cpu_features();
+
+// select the kernels for this CPU, or the ones called 'name' (if it is not NULL or empty)
+// Returns whether 'name' was found and supported (if it wasn't, then the best ones are used)
+bool mpt_kern_init(const char* name);
+
+
+/* plan cache */
+
+// the version of the plan file format (and of the tables in them), which must match to use a file
+#define MPT_PLAN_VERSION 1
+
+// the kinds of tables
+#define MPT_PLAN_NTT 1
+#define MPT_PLAN_FFT 2
+
+// the directory the plan files are kept in (or NULL to only keep the tables in memory)
+extern const char* mpt_plan_dir;
+
+// fills 'data' with the tables of a transform of length 'len'
+typedef void (*mpt_plan_fill_t)(void* data, int64_t len);
+
+// return the read-only tables (i.e. the roots of unity, and the bit reversal permutations) of the 'kind' of
+//   transform of length 'len', which take 'size' bytes (and start at a multiple of MPT_ALIGN)
+// The first call for a length computes them with 'fill' (or maps them from the file 'kind-len.plan' in
+//   'mpt_plan_dir', if it is there, and writes that file if it isn't), and the rest just return the same tables,
+//   so they are shared by every plan (and every thread) that needs them, and a file is shared by every process
+//   that maps it (see 'src/plan.c')
+// NOTE: this is thread safe, and the tables stay until 'mpt_plan_clear'
+const void* mpt_plan_get(int kind, int64_t len, size_t size, mpt_plan_fill_t fill);
+
+// free all of the tables
+// NOTE: no plan may use them after this
+void mpt_plan_clear();
+
+
+/* NTT (Number Theoretic Transform) */
+
+// number of primes the NTT is done over
+// NOTE: the results are recombined with the CRT, and 3 primes (each ~2^62) is enough
+//   to hold any coefficient of the square of a number with less than 2^54 limbs
+#define MPT_NTT_NP 3
+
+// a precomputed plan for squaring numbers of a given size with the NTT
+typedef struct mpt_ntt_s {
+
+    // number of limbs in the input
+    int64_t N;
+
+    // transform length (a power of 2, at least 2N)
+    int64_t L;
+
+    // roots of unity for each prime, in Montgomery form (from 'mpt_plan_get', so they are shared)
+    // 'rt[k][len + j]' is w^j, where 'w' is a primitive '2*len'th root of unity (and 0 <= j < len)
+    const uint64_t* rt[MPT_NTT_NP];
+
+    // inverse roots, in the same layout as 'rt'
+    const uint64_t* irt[MPT_NTT_NP];
+
+    // 1/L (mod each prime), which is not in Montgomery form, so scaling the pointwise square by it also takes the
+    //   result out of Montgomery form
+    uint64_t iL[MPT_NTT_NP];
+
+    // work buffer for each prime ('L' entries each)
+    uint64_t* W[MPT_NTT_NP];
+
+} mpt_ntt_t;
+
+// initialize 'ntt' for squaring numbers of 'N' limbs
+void mpt_ntt_init(mpt_ntt_t* ntt, int64_t N);
+
+// free the resources held by 'ntt'
+void mpt_ntt_free(mpt_ntt_t* ntt);
+
+// squares a number with the NTT:
+// C = A^2
+// Where 'A' has 'ntt->N' limbs, and 'C' has '2 * ntt->N' limbs
+// NOTE: 'A' and 'C' must not overlap!
+void mpt_ntt_sqr(mpt_ntt_t* ntt, mpt_limb_t* A, mpt_limb_t* C);
+
+
+/* IBDWT (Irrational Base Discrete Weighted Transform) */
+
+// maximum roundoff error (from the nearest integer) allowed in the IBDWT before it is considered broken
+#define MPT_FFT_MAXERR 0.4
+
+// the complex transform is done in four steps (rows and columns, see 'src/fft.c') from this many points (where
+//   it no longer fits in the L2 cache), and the columns are done MPT_FFT_BLOCK at a time (so each row of them
+//   is a couple of cache lines)
+#define MPT_FFT_4STEP_THRESH 32768
+#define MPT_FFT_BLOCK 8
+
+// a number (mod 2^p - 1), stored as variable-width balanced digits, which is squared with a
+//   weighted double precision real FFT, so that the cyclic convolution does the 'mod 2^p - 1' for free
+typedef struct mpt_fft_s {
+
+    // the exponent
+    int64_t p;
+
+    // number of digits (and the length of the real transform, a power of 2)
+    int64_t n;
+
+    // the digits, in the range [-2^(b[j]-1), 2^(b[j]-1))
+    double* x;
+
+    // bits in each digit (either floor(p/n) or ceil(p/n))
+    int8_t* b;
+
+    // weight of each digit, and the inverse weight (which also includes the scaling of the inverse transform)
+    double* a;
+    double* ia;
+
+    // work buffer for the complex transform of length 'n/2' (interleaved real/imaginary)
+    double* W;
+
+    // roots of unity for the complex transform, and for the real transform (interleaved real/imaginary)
+    // 'tw[len + j]' is exp(-2*pi*i*j/(2*len)), and 'rw[k]' is exp(-2*pi*i*k/n)
+    // NOTE: these (and the rest of the roots and permutations) are from 'mpt_plan_get', so they are shared
+    const double* tw;
+    const double* rw;
+
+    // bit reversal permutation of the complex transform
+    const int64_t* rev;
+
+    // scratch space for the digits as integers (while carrying)
+    int64_t* v;
+
+    // the maximum roundoff error seen so far
+    double maxerr;
+
+    // for the four-step transform, the complex transform is 'n2' rows of 'n1' (both powers of 2, which are
+    //   'lg1' and 'lg2' bits), or 0 if it isn't used (in which case, the rest of these are NULL)
+    int64_t n1, n2;
+    int lg1, lg2;
+
+    // bit reversal permutations of the rows and the columns
+    const int64_t* rev1;
+    const int64_t* rev2;
+
+    // the twiddles between the passes, exp(-2*pi*i*e/(n/2)) == tl[e % n1] * th[e / n1], and the roots of the
+    //   real transform, exp(-2*pi*i*k/n) == ra[k % n2] * rb[k / n2] (interleaved real/imaginary)
+    const double* tl;
+    const double* th;
+    const double* ra;
+    const double* rb;
+
+    // the number of threads to use (from 'mpt_sqr_threads'), and the scratch space for each (MPT_FFT_BLOCK
+    //   columns)
+    int nthr;
+    double* buf;
+
+} mpt_fft_t;
+
+// initialize 'fft' for the exponent 'p', using 'n' digits
+// If 'n' is 0, then the smallest safe power of 2 is chosen automatically
+// NOTE: the number is initialized to 0, and long transforms use 'mpt_sqr_threads' threads (as of now)
+void mpt_fft_init(mpt_fft_t* fft, int64_t p, int64_t n);
+
+// return the number of digits that 'mpt_fft_init' uses for the exponent 'p', given 'n' (which may be 0)
+int64_t mpt_fft_length(int64_t p, int64_t n);
+
+// reuse 'fft' for the exponent 'p' (with the same number of digits, and so the same roots), which only recomputes
+//   the digit sizes and the weights
+// NOTE: the number is initialized to 0
+void mpt_fft_reinit(mpt_fft_t* fft, int64_t p);
+
+// free the resources held by 'fft'
+void mpt_fft_free(mpt_fft_t* fft);
+
+// set the number held by 'fft' from 'S', which has (p / MPT_LIMB_BITS + 1) limbs
+// NOTE: 'S' must be less than 2^p
+void mpt_fft_set(mpt_fft_t* fft, mpt_limb_t* S);
+
+// get the number held by 'fft', fully reduced (mod 2^p - 1), into 'S', which has (p / MPT_LIMB_BITS + 1) limbs
+void mpt_fft_get(mpt_fft_t* fft, mpt_limb_t* S);
+
+// calculate:
+// X = X^2 - c (mod 2^p - 1)
+// Where 'X' is the number held in 'fft'. Returns the maximum roundoff error from this squaring
+double mpt_fft_sqr(mpt_fft_t* fft, int64_t c);
+
+
+/* R52 (redundant 52 bit digits, for AVX-512 IFMA) */
+
+// bits in each digit
+#define MPT_R52_BITS 52
+
+// number of products that are summed into a column of the square before it is split (so it can't overflow)
+// NOTE: each product adds less than 2^52 to a column, so this must be at most 2^11
+#define MPT_R52_BLOCK 1024
+
+// a number (mod 2^p - 1), stored as 52 bit digits in 64 bit words, which is squared with vpmadd52luq/vpmadd52huq
+//   (when the CPU has AVX-512 IFMA, otherwise, with scalar code). The extra 12 bits of each word hold the carries,
+//   which are only resolved once per squaring
+typedef struct mpt_r52_s {
+
+    // the exponent
+    int64_t p;
+
+    // number of digits (ceil(p / 52)), and the number of bits in the top digit
+    int64_t n, t;
+
+    // the digits (normalized, so each is less than 2^52), with zero padding after them
+    uint64_t* x;
+
+    // the column sums of the low and high halves of each product (2n entries, with zero padding)
+    uint64_t* zl;
+    uint64_t* zh;
+
+    // whether to use AVX-512 IFMA
+    bool ifma;
+
+} mpt_r52_t;
+
+// initialize 'r' for the exponent 'p'
+// NOTE: the number is initialized to 0
+void mpt_r52_init(mpt_r52_t* r, int64_t p);
+
+// free the resources held by 'r'
+void mpt_r52_free(mpt_r52_t* r);
+
+// set the number held by 'r' from 'S', which has (p / MPT_LIMB_BITS + 1) limbs
+// NOTE: 'S' must be less than 2^p
+void mpt_r52_set(mpt_r52_t* r, mpt_limb_t* S);
+
+// get the number held by 'r', fully reduced (mod 2^p - 1), into 'S', which has (p / MPT_LIMB_BITS + 1) limbs
+void mpt_r52_get(mpt_r52_t* r, mpt_limb_t* S);
+
+// calculate:
+// X = X^2 - c (mod 2^p - 1)
+// Where 'X' is the number held in 'r', and 0 <= c < min(2^52, 2^p - 1)
+void mpt_r52_sqr(mpt_r52_t* r, int64_t c);
+
+
+/* SIMD (several exponents at once, one in each lane) */
+
+// the number of exponents that are squared at once (one 512 bit vector of 64 bit lanes, or two 256 bit ones)
+#define MPT_SIMD_LANES 8
+
+// bits in each digit (so each product is a single 32x32 bit 'vpmuludq', and is less than 2^57 when doubled)
+#define MPT_SIMD_BITS 28
+
+// number of products that are summed into a column of the square before it is split (so it can't overflow)
+// NOTE: each product adds less than 2^57 to a column, so this must be less than 2^7
+#define MPT_SIMD_CHUNK 64
+
+// up to MPT_SIMD_LANES numbers, each (mod 2^p - 1) for its own 'p', which are stored as structure-of-arrays (the
+//   same digit of every lane is together), so every step of the squaring is the same for every lane, and is done
+//   for all of them with one vector instruction
+// Every lane has as many digits as the largest one needs (the ones above its own top digit are 0), so the
+//   exponents should be close together (i.e. the next few from a sorted list), or most of the work is wasted
+typedef struct mpt_simd_s {
+
+    // number of digits (of the largest lane), and the number of lanes in use
+    int64_t n;
+    int np;
+
+    // the exponent of each lane, the index of its top digit, and the number of bits in its top digit
+    // NOTE: the lanes that aren't in use copy the first one
+    int64_t p[MPT_SIMD_LANES];
+    int64_t q[MPT_SIMD_LANES];
+    uint64_t t[MPT_SIMD_LANES];
+
+    // the digits (digit 'j' of lane 'l' is 'x[j * MPT_SIMD_LANES + l]'), each less than 2^MPT_SIMD_BITS, and
+    //   twice them (for the products off the diagonal)
+    uint64_t* x;
+    uint64_t* x2;
+
+    // the column sums of the square, as a low part (the same weight as the column), and a high part (worth
+    //   2^MPT_SIMD_BITS more), with '2n' columns
+    uint64_t* z;
+    uint64_t* w;
+
+} mpt_simd_t;
+
+// return the number of digits of the exponent 'p'
+int64_t mpt_simd_digits(int64_t p);
+
+// return the number of 64 bit words of workspace that 'mpt_simd_init' needs for 'n' digits
+int64_t mpt_simd_words(int64_t n);
+
+// initialize 's' for the 'np' exponents 'p' (at most MPT_SIMD_LANES), with the workspace 'W' (of 'mpt_simd_words'
+//   words for the digits of the largest one, aligned to MPT_ALIGN), so there is nothing to free
+// NOTE: every lane is initialized to 'x0'
+void mpt_simd_init(mpt_simd_t* s, int np, const int64_t* p, uint64_t* W, uint64_t x0);
+
+// return whether the number in lane 'l' is 0 (mod 2^p - 1)
+bool mpt_simd_iszero(mpt_simd_t* s, int l);
+
+// calculate, in every lane:
+// X = X^2 - c (mod 2^p - 1)
+// Where 'X' is the number held in the lane, and 0 <= c < min(2^MPT_SIMD_BITS, 2^p - 1)
+void mpt_simd_sqr(mpt_simd_t* s, uint64_t c);
+
+
+/* TF (trial factoring) */
+
+// the largest factors that can be searched for (in bits)
+#define MPT_TF_MAXBITS 127
+
+// number of primes the candidates are sieved with (after 3, 5, 7, 11)
+#define MPT_TF_SIEVE_PRIMES 2500
+
+// the cost of a LL test (per p^2 * log2(p)) over the cost of trial factoring (per 'k', including the ones which
+//   are sieved out), which decides how deep 'mpt_tf_bits' goes: searching the next bit level 'b' is worth it if it
+//   costs less than the LL test times the chance of finding a factor there (about 1/b)
+#define MPT_TF_COST_RATIO 0.03
+
+// the result of trial factoring 2^p - 1
+typedef struct mpt_tf_s {
+
+    // the exponent, and the number of bits that was searched up to (all factors less than 2^bits)
+    int64_t p;
+    int bits;
+
+    // whether a factor was found, and if so, the factor (as q[1]:q[0]), which is 2kp + 1
+    bool found;
+    uint64_t k;
+    uint64_t q[2];
+
+    // number of candidates that were left after sieving (and were tested)
+    uint64_t ntested;
+
+} mpt_tf_t;
+
+// return the default number of bits to trial factor 2^p - 1 to, before a LL test (see 'MPT_TF_COST_RATIO')
+int mpt_tf_bits(int64_t p);
+
+// search for a factor of 2^p - 1 that is less than 2^bits (or less than its square root, if that is smaller),
+//   and return whether one was found (the result is stored in 'tf')
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_tf(mpt_tf_t* tf, int64_t p, int bits);
+
+
+/* P-1 (Pollard's P-1 factoring) */
+
+// the cost of P-1 over the cost of a LL test (both in squarings mod 2^p - 1), which decides the bounds that
+//   'mpt_pm1_bounds' picks
+#define MPT_PM1_COST 0.03
+
+// the stage 2 bound over the stage 1 bound, for 'mpt_pm1_bounds'
+#define MPT_PM1_B2 20
+
+// the largest stage 2 bound (the giant step exponents must fit in 64 bits)
+#define MPT_PM1_MAXB2 ((int64_t)1 << 31)
+
+// the result of P-1 on 2^p - 1
+typedef struct mpt_pm1_s {
+
+    // the exponent, and the bounds that were used
+    int64_t p;
+    int64_t B1, B2;
+
+    // whether a factor was found, and in which stage (1 or 2)
+    bool found;
+    int stage;
+
+    // the factor, with (p / MPT_LIMB_BITS + 1) limbs (or NULL if none was found)
+    // NOTE: this may be the product of more than one prime factor
+    mpt_limb_t* f;
+
+} mpt_pm1_t;
+
+// pick the bounds for P-1 on 2^p - 1, before a LL test (see 'MPT_PM1_COST'), which are both 0 if it isn't worth it
+void mpt_pm1_bounds(int64_t p, int64_t* B1, int64_t* B2);
+
+// search for a factor 'q' of 2^p - 1 such that q - 1 is B1-smooth, except for at most one prime up to B2, and return
+//   whether one was found (the result is stored in 'pm1', which must be freed with 'mpt_pm1_free')
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_pm1(mpt_pm1_t* pm1, int64_t p, int64_t B1, int64_t B2);
+
+// free the factor in 'pm1'
+void mpt_pm1_free(mpt_pm1_t* pm1);
+
+
+/* prime sieve */
+
+// the size (in bytes) of each segment of 'mpt_sieve_t', which covers 30 numbers per byte
+#define MPT_SIEVE_SEGMENT 32768
+
+// an iterator over the primes in [lo, hi), which are sieved a batch of segments at a time (one per thread), so it
+//   takes O(sqrt(hi)) time and memory to start, and then O(threads * MPT_SIEVE_SEGMENT) memory
+typedef struct mpt_sieve_s {
+
+    // the range
+    int64_t lo, hi;
+
+    // the sieving primes (from 7 up to sqrt(hi))
+    int64_t nbp;
+    uint32_t* bp;
+
+    // the current batch of segments ('nseg' segments, starting at the number 'base', with 'nbyte' bytes used),
+    //   and the start of the next batch
+    int nseg;
+    uint8_t* seg;
+    int64_t base, nbyte, next;
+
+    // the byte that is being handed out, and its bits that are left, and how many of 2, 3, 5 have been checked
+    int64_t pos;
+    unsigned int cur;
+    int small;
+
+} mpt_sieve_t;
+
+// start iterating over the primes in [lo, hi)
+void mpt_sieve_init(mpt_sieve_t* s, int64_t lo, int64_t hi);
+
+// return the next prime (in increasing order), or -1 if there are none left
+int64_t mpt_sieve_next(mpt_sieve_t* s);
+
+// free the buffers of 's'
+void mpt_sieve_free(mpt_sieve_t* s);
+
+
+/* checkpoints */
+
+// the version of the checkpoint format, which must match to resume from a file
+#define MPT_CKPT_VERSION 1
+
+// the default time between checkpoints (in seconds)
+#define MPT_CKPT_INTERVAL 600.0
+
+// the directory the checkpoints are kept in (or NULL to not write any), and the time between them (in seconds)
+extern const char* mpt_ckpt_dir;
+extern double mpt_ckpt_interval;
+
+// the checkpoints of a single test (see 'src/ckpt.c')
+typedef struct mpt_ckpt_s {
+
+    // whether checkpoints are being written
+    bool active;
+
+    // the exponent, and the engine that is writing them
+    int64_t p;
+    const char* engine;
+
+    // the file, and the temporary file that is written and then renamed over it
+    char* path;
+    char* tmp;
+
+    // the time between them, and the time of the last one
+    double interval, last;
+
+    // the snapshot of the term (as 'n' 64 bit words), and the iteration it is from
+    int64_t n;
+    uint64_t* snap;
+    int64_t iter;
+
+    // the writer thread, which writes 'snap' when 'busy' is set (and clears it once it is on disk)
+    pthread_t thr;
+    pthread_mutex_t mx;
+    pthread_cond_t cv;
+    bool busy, quit;
+
+} mpt_ckpt_t;
+
+// start checkpointing the 'kind' of test (i.e. "ll" or "prp", which is part of the file name, since their terms
+//   can't be mixed up) of 2^p - 1 with 'engine', and return whether it is enabled (see 'mpt_ckpt_dir')
+// NOTE: if it isn't, the rest of the 'mpt_ckpt_' functions do nothing
+bool mpt_ckpt_init(mpt_ckpt_t* c, int64_t p, const char* kind, const char* engine);
+
+// if there is a valid checkpoint for 'p', set 'S' (with (p / MPT_LIMB_BITS + 1) limbs) to the term in it, and
+//   return the iteration it is from (otherwise, return 0, and leave 'S' alone)
+// NOTE: the term doesn't depend on the engine, so a test can be resumed with a different one (of the same kind)
+int64_t mpt_ckpt_load(mpt_ckpt_t* c, mpt_limb_t* S);
+
+// return whether a checkpoint is due (which just checks the time)
+bool mpt_ckpt_due(mpt_ckpt_t* c);
+
+// checkpoint 'S' (with (p / MPT_LIMB_BITS + 1) limbs), which is the term after 'iter' iterations
+// NOTE: this only copies 'S' (it is written by the writer thread), and skips it if the last one is still
+//   being written
+void mpt_ckpt_save(mpt_ckpt_t* c, mpt_limb_t* S, int64_t iter);
+
+// stop checkpointing (after any write that is in progress), and remove the checkpoint if the test is 'done'
+void mpt_ckpt_free(mpt_ckpt_t* c, bool done);
+
+
+/* progress */
+
+// the time between progress lines (in seconds, or 0 for none), whether the cycles of each phase of an iteration
+//   are counted, and whether the hardware counters are read (all of them are off by default)
+extern double mpt_prog_interval;
+extern bool mpt_prog_cycles;
+extern bool mpt_prog_perf;
+
+// the phases of an iteration (every reduction subtracts the 'c' as it folds, so that's part of the reduction)
+// NOTE: the transforms (and the fused kernels) also reduce as part of the square, so for those, it is all counted
+//   as the square
+#define MPT_PHASE_SQR 0
+#define MPT_PHASE_RED 1
+#define MPT_PHASE_N   2
+
+// the hardware counters
+#define MPT_PERF_CYCLES   0
+#define MPT_PERF_INSNS    1
+#define MPT_PERF_LLC_MISS 2
+#define MPT_PERF_L1D_MISS 3
+#define MPT_PROG_NPERF    4
+
+// the progress of a single test (see 'src/prog.c')
+typedef struct mpt_prog_s {
+
+    // whether any of it is on, and whether the phases are counted
+    bool active;
+    bool cycles;
+
+    // the exponent, the total number of iterations, and the engine
+    int64_t p, niter;
+    const char* engine;
+
+    // the iteration and time it started at, and of the last progress line
+    int64_t i0, ilast;
+    double start, last;
+
+    // the next iteration to look at the clock, and the number of iterations until the one after that
+    int64_t next, step;
+
+    // the cycles spent in each phase, and the time stamp counter at the start
+    uint64_t cyc[MPT_PHASE_N];
+    uint64_t tsc0;
+
+    // the hardware counters (file descriptors, or -1), and their values at the start and at the last line
+    int fd[MPT_PROG_NPERF];
+    uint64_t perf0[MPT_PROG_NPERF], perf1[MPT_PROG_NPERF];
+
+} mpt_prog_t;
+
+// start the progress of the test of 2^p - 1, which takes 'niter' iterations, with 'engine', from iteration 'i0'
+// NOTE: if none of it is on, the rest of the 'mpt_prog_' functions do nothing
+void mpt_prog_init(mpt_prog_t* pr, int64_t p, int64_t niter, const char* engine, int64_t i0);
+
+// restart the progress from iteration 'i0' (i.e. after going back to a checkpoint)
+void mpt_prog_start(mpt_prog_t* pr, int64_t i0);
+
+// return whether a progress line is due at iteration 'i' (see 'mpt_prog_due', which only calls this every so often)
+bool mpt_prog_poll(mpt_prog_t* pr, int64_t i);
+
+// print a progress line, where 'S' (with (p / MPT_LIMB_BITS + 1) limbs) is the term after 'i' iterations
+void mpt_prog_report(mpt_prog_t* pr, int64_t i, mpt_limb_t* S);
+
+// stop, and print where the cycles went (if they were counted) and the hardware counters (if they were read),
+//   after 'i' iterations
+void mpt_prog_free(mpt_prog_t* pr, int64_t i);
+
+
+/* test contexts */
+
+// a bump allocator for the workspace of a test: everything it hands out is aligned to MPT_ALIGN bytes, and it is
+//   all freed at once (by 'mpt_arena_reset'), so there is no allocator churn between the tests of a batch
+// If a block fills up, another (twice as large) is started, and on the next reset, they are all replaced by a
+//   single block big enough for all of them, so after the first test, a batch of similar exponents never
+//   allocates again
+typedef struct mpt_arena_s {
+
+    // the current block (which starts with a pointer to the block before it), its size, and how much of it is used
+    char* base;
+    size_t size, used;
+
+    // the total size of all the blocks
+    size_t total;
+
+} mpt_arena_t;
+
+// initialize 'ar' (empty)
+void mpt_arena_init(mpt_arena_t* ar);
+
+// free the resources held by 'ar'
+void mpt_arena_free(mpt_arena_t* ar);
+
+// return 'sz' bytes from 'ar', aligned to MPT_ALIGN bytes
+// NOTE: this is valid until 'ar' is reset, and the memory is not initialized
+void* mpt_arena_alloc(mpt_arena_t* ar, size_t sz);
+
+// free everything allocated from 'ar' (but keep the memory for the next time)
+void mpt_arena_reset(mpt_arena_t* ar);
+
+// the state that a thread keeps between the tests it runs: the workspace of the current test, and the transform
+//   plans, which are reused as long as the next exponent needs the same transform length (so a batch of
+//   similar exponents computes the roots of unity once)
+// NOTE: each thread needs its own
+typedef struct mpt_ctx_s {
+
+    // the workspace of the current test (see 'mpt_ctx_begin')
+    mpt_arena_t ar;
+
+    // the plans, and whether each one is set up
+    bool has_ntt, has_fft, has_r52;
+    mpt_ntt_t ntt;
+    mpt_fft_t fft;
+    mpt_r52_t r52;
+
+} mpt_ctx_t;
+
+// initialize 'ctx' (with no plans)
+void mpt_ctx_init(mpt_ctx_t* ctx);
+
+// free the resources held by 'ctx'
+void mpt_ctx_free(mpt_ctx_t* ctx);
+
+// start a new test with 'ctx', which frees the workspace of the last one
+void mpt_ctx_begin(mpt_ctx_t* ctx);
+
+// return 'N' limbs of workspace (aligned to MPT_ALIGN bytes), which are valid until the next 'mpt_ctx_begin'
+mpt_limb_t* mpt_ctx_limbs(mpt_ctx_t* ctx, int64_t N);
+
+// return the plan for squaring 'N' limbs with the NTT (see 'mpt_ntt_init'), reusing the last one if it has the
+//   same transform length
+mpt_ntt_t* mpt_ctx_ntt(mpt_ctx_t* ctx, int64_t N);
+
+// return the IBDWT for the exponent 'p' with 'n' digits (see 'mpt_fft_init'), reusing the roots of the last one
+//   if it has the same number of digits
+// NOTE: the number is initialized to 0
+mpt_fft_t* mpt_ctx_fft(mpt_ctx_t* ctx, int64_t p, int64_t n);
+
+// return the R52 number for the exponent 'p' (see 'mpt_r52_init'), reusing the buffers of the last one if it has
+//   the same number of digits
+// NOTE: the number is not initialized (use 'mpt_r52_set')
+mpt_r52_t* mpt_ctx_r52(mpt_ctx_t* ctx, int64_t p);
+
+
+/* PRP (probable prime test) */
+
+// the number of Gerbicz-Li checks per test, which decides the block size (see 'mpt_prp_block')
+#define MPT_PRP_CHECKS 25
+
+// if nonzero, a bit of the term is flipped (once) in the block with this iteration, to test the error checking
+extern int64_t mpt_prp_inject;
+
+// the result of the PRP test of 2^p - 1
+typedef struct mpt_prp_s {
+
+    // the exponent, and the block size of the checks
+    int64_t p;
+    int64_t L;
+
+    // whether it is a probable prime, and the low 64 bits of 3^(2^p) (mod 2^p - 1), which is 9 if it is
+    bool prp;
+    uint64_t res64;
+
+    // the number of checks that were done, and how many of them found an error (and went back)
+    int64_t nchecks, nerrors;
+
+    // whether a proof was written (see 'mpt_proof_dir')
+    bool proof;
+
+} mpt_prp_t;
+
+// return the block size 'L' of the checks for 2^p - 1, so that there is a check every L^2 iterations
+int64_t mpt_prp_block(int64_t p);
+
+// the base 3 Fermat test of 2^p - 1, with Gerbicz-Li error checking (see 'src/prp.c'), and return whether it is
+//   a probable prime (the result is stored in 'prp')
+// NOTE: this returns false if 'p' isn't prime, and the workspace comes from 'ctx' (see 'mpt_ctx_begin')
+bool mpt_prp(mpt_prp_t* prp, int64_t p, mpt_ctx_t* ctx);
+
+
+/* PRP proofs */
+
+// the version of the proof format
+#define MPT_PROOF_VERSION 1
+
+// the most levels a proof may have (the PRP test keeps 2^k terms on disk to build it)
+#define MPT_PROOF_MAXPOWER 10
+
+// the directory the PRP test writes proofs to (or NULL to not write any)
+extern const char* mpt_proof_dir;
+
+// the proof of a single PRP test, which is being built (see 'src/proof.c')
+typedef struct mpt_proof_s {
+
+    // whether a proof is being built
+    bool active;
+
+    // the exponent, and the number of levels, so the proof is of 3^(2^T), with T = s * 2^k
+    int64_t p;
+    int k;
+    int64_t s;
+
+    // the proof, and the file the terms are kept in until it is built (with 'n' 64 bit words per term)
+    char* path;
+    char* res;
+    FILE* fp;
+    int64_t n;
+    uint64_t* W;
+
+} mpt_proof_t;
+
+// the result of verifying a proof
+typedef struct mpt_verify_s {
+
+    // the exponent, and the number of levels
+    int64_t p;
+    int k;
+
+    // whether the proof is valid, and if so, whether 2^p - 1 is a probable prime, and the low 64 bits of
+    //   3^(2^p) (mod 2^p - 1)
+    bool valid;
+    bool prp;
+    uint64_t res64;
+
+    // why it isn't valid (or NULL if it is)
+    const char* why;
+
+} mpt_verify_t;
+
+// return the number of levels of the proof for 2^p - 1 (so the verifier does about p / 2^k squarings)
+int mpt_proof_power(int64_t p);
+
+// start building the proof of the PRP test of 2^p - 1 (which is 'resumed' from a checkpoint, in which case the
+//   terms from before it must already be there), and return whether it is enabled (see 'mpt_proof_dir')
+// NOTE: if it isn't, the rest of the 'mpt_proof_' functions do nothing
+bool mpt_proof_init(mpt_proof_t* pf, int64_t p, bool resumed);
+
+// 'X' is the term after 'i' iterations, which is kept if the proof needs it
+// NOTE: after going back to an earlier iteration, the terms after it are just written again
+void mpt_proof_step(mpt_proof_t* pf, int64_t i, mpt_limb_t* X);
+
+// stop building the proof, and if the test is 'done', write it, and return whether it was written
+bool mpt_proof_free(mpt_proof_t* pf, bool done);
+
+// verify the proof in the file 'fname', and return whether it is valid (the result is stored in 'v')
+bool mpt_proof_verify(mpt_verify_t* v, const char* fname);
+
+
+/* tests */
+
+// the Lucas-Lehmer test of 2^p - 1, with different engines for the squaring (see 'src/engine.c')
+// Each returns whether 2^p - 1 is prime (so it returns false if 'p' isn't prime), and takes its workspace and
+//   plans from 'ctx' (so a thread can reuse them for the next test)
+bool mpt_T_basic0(mpt_ctx_t* ctx, int64_t p);
+bool mpt_T_ntt0(mpt_ctx_t* ctx, int64_t p);
+bool mpt_T_fft0(mpt_ctx_t* ctx, int64_t p);
+bool mpt_T_ifma0(mpt_ctx_t* ctx, int64_t p);
+bool mpt_T_simd0(mpt_ctx_t* ctx, int64_t p);
+
+// the Lucas-Lehmer test of the 'n' (at most MPT_SIMD_LANES) exponents 'p' at once (which should be close together,
+//   see 'mpt_simd_t'), and the result of each is stored in 'res'
+void mpt_T_simd0_n(mpt_ctx_t* ctx, int n, const int64_t* p, bool* res);
+
+// the PRP test of 2^p - 1 (see 'mpt_prp'), which returns whether it is a probable prime
+bool mpt_T_prp0(mpt_ctx_t* ctx, int64_t p);
+
+// the Lucas-Lehmer test of 2^p - 1, with whichever engine is fastest for its size (see 'mpt_engine_auto')
+bool mpt_T_auto(mpt_ctx_t* ctx, int64_t p);
+
+// an engine, which can be selected by name (i.e. on the command line)
+typedef struct mpt_engine_s {
+
+    // name of the engine (i.e. "fft0" for 'mpt_T_fft0')
+    const char* name;
+
+    // the test itself
+    bool (*test)(mpt_ctx_t* ctx, int64_t p);
+
+    // the most exponents it can test at once, and the test of 'n' of them (or 1 and NULL, if it only tests one)
+    int lanes;
+    void (*test_n)(mpt_ctx_t* ctx, int n, const int64_t* p, bool* res);
+
+} mpt_engine_t;
+
+// all of the engines, ending with one that has a NULL name
+extern const mpt_engine_t mpt_engines[];
+
+// return the engine called 'name', or NULL if there is none
+const mpt_engine_t* mpt_engine_find(const char* name);
+
+// return the engine that 'mpt_T_auto' uses for 2^p - 1 (see 'MPT_AUTO_IFMA_P')
+const mpt_engine_t* mpt_engine_auto(int64_t p);
 
 
 /* general utils */
 
+// start the clock of 'mpt_time' (at the start of 'main')
+void mpt_time_init();
+
 // return the time since it started
 double mpt_time();
 
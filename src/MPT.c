@@ -4,160 +4,427 @@
 
 #include "MPT-impl.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-// test 2^p - 1
-// This method uses Lucas-Lehmer test (LL) and the Number Theoretic Transform (NTT) to do the squaring at each step,
-//   and some modular division tricks for 'mod Mp'
-// ASSUMPTIONS:
-//   'p' is prime
-bool mpt_T_ntt0(int64_t p) {
-    return false;
+
+/* batch driver */
+
+// list of exponents to test
+typedef struct {
+    int64_t* p;
+    int64_t n, cap;
+} h_plist_t;
+
+// add 'p' to the list
+static void h_plist_push(h_plist_t* l, int64_t p) {
+    if (l->n >= l->cap) {
+        l->cap = l->cap < 64 ? 64 : 2 * l->cap;
+        l->p = realloc(l->p, l->cap * sizeof(*l->p));
+    }
+    l->p[l->n++] = p;
 }
 
+// add 'p' to the list, if it is prime (otherwise, 2^p - 1 can't be)
+static void h_plist_add(h_plist_t* l, int64_t p) {
+    if (mpt_isprime(p)) h_plist_push(l, p);
+}
 
-bool mpt_T_basic0(int64_t p) {
-    // special case
-    if (p == 2) return true;
-    
-    // p must be prime
-    if (!mpt_isprime(p)) return false;
+// add all of the primes in [lo, hi] to the list
+static void h_plist_range(h_plist_t* l, int64_t lo, int64_t hi) {
+    if (hi < lo) return;
+    mpt_sieve_t s;
+    mpt_sieve_init(&s, lo, hi + 1);
+    int64_t p;
+    while ((p = mpt_sieve_next(&s)) >= 0) h_plist_push(l, p);
+    mpt_sieve_free(&s);
+}
 
-    if (p < MPT_LIMB_BITS) fprintf(stderr, "[MPT_warn]: Exponent '%lli' is smaller than the bits per limb (%lli). This may cause problems\n", (long long int)p, (long long int)MPT_LIMB_BITS);
+// read the exponents from 'fname' (one per line, and '#' starts a comment), returns whether it could be read
+static bool h_plist_read(h_plist_t* l, const char* fname) {
+    FILE* fp = strcmp(fname, "-") == 0 ? stdin : fopen(fname, "r");
+    if (fp == NULL) return false;
 
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char* c = strchr(line, '#');
+        if (c != NULL) *c = '\0';
 
-    // number of limbs in the main sequence
-    int64_t N = p / MPT_LIMB_BITS + 1;
+        char* end;
+        long long p = strtoll(line, &end, 10);
+        if (end != line) h_plist_add(l, p);
+    }
 
-    mpt_limb_t* Mp = mpt_alloc_bits(p);
-    mpt_set_Mp(Mp, p);
+    if (fp != stdin) fclose(fp);
+    return true;
+}
 
-    // allocate 'S_i', the current term in the sequence
-    // NOTE: allocate twice as many bits as are required, so we can do in place modular arithmetic
-    mpt_limb_t* S_i = mpt_alloc_bits((2 * N) * MPT_LIMB_BITS);
-    mpt_limb_t* S_it = mpt_alloc_bits((2 * N) * MPT_LIMB_BITS);
+// write 'q' (as q[1]:q[0]) in decimal to 'out' (which must hold at least 44 bytes)
+static void h_u128_str(const uint64_t* q, char* out) {
+    mpt_limb_t A[16 / MPT_LIMB_SIZE];
+    int64_t i;
+    for (i = 0; i < 16 / (int64_t)MPT_LIMB_SIZE; ++i) {
+        A[i] = (mpt_limb_t)(q[i * MPT_LIMB_SIZE / 8] >> (8 * (i * MPT_LIMB_SIZE % 8)));
+    }
+    mpt_getdecstr(A, 16 / MPT_LIMB_SIZE, out);
+}
 
-    // set S_i = 4 to begin
-    mpt_set_0(S_i, 2 * N);
-    S_i[0] = 4;
+// return a decimal string of 'A' (which has 'N' limbs), which should be freed with 'free()'
+static char* h_limbs_str(int64_t N, mpt_limb_t* A) {
+    char* res = malloc(N * MPT_LIMB_BITS / 3 + 2);
+    mpt_getdecstr(A, N, res);
+    return res;
+}
 
-    // only allocate if its a trace build
-    #ifdef MPT_TRACE_TERMS
-        char* tmp = malloc(2 * N * MPT_HDPL + 4);
+// the directory that the decimal expansion of each prime is written to (see '-d'), or NULL
+static const char* h_dec_dir = NULL;
 
-        mpt_gethexstr(Mp, N, tmp);
-        printf("M%i: 0x%s\n", p, tmp);
-    #endif
+// write the decimal expansion of 2^p - 1 to the file 'M<p>.txt' in 'h_dec_dir'
+static void h_write_dec(int64_t p) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    mpt_limb_t* Mp = mpt_alloc_bits(N * MPT_LIMB_BITS);
+    mpt_set_Mp(Mp, p);
+    char* str = h_limbs_str(N, Mp);
 
+    size_t sz = strlen(h_dec_dir) + 32;
+    char* path = malloc(sz);
+    snprintf(path, sz, "%s/M%lli.txt", h_dec_dir, (long long int)p);
 
-    // current trial (beginning at 0)
-    int64_t i;
-    for (i = 0; i < p - 2; ++i) {
+    bool ok = false;
+    FILE* fp = fopen(path, "w");
+    if (fp != NULL) {
+        ok = fputs(str, fp) >= 0 && fputc('\n', fp) != EOF;
+        ok = (fclose(fp) == 0) && ok;
+    }
+    if (!ok) fprintf(stderr, "[MPT_warn]: Couldn't write '%s'\n", path);
 
-        #ifdef MPT_TRACE_TERMS
-            mpt_gethexstr(S_i, N, tmp);
-            printf("S%i: 0x%s\n", i, tmp);
-        #endif
+    free(path);
+    free(str);
+    free(Mp);
+}
 
-        // calculate the next term in the sequence:
-        // S_i <- S_i ^ 2 - 2 (mod Mp)
-        mpt_sqr_naive(N, S_i, S_it);
+// one exponent of a batch, and what is known about it so far
+typedef struct {
+    int64_t p;
 
-        #ifdef MPT_TRACE_TERMS
-            mpt_gethexstr(S_it, 2 * N, tmp);
-            printf("  s^2    : 0x%s\n", tmp);
-        #endif
+    // the bits it was trial factored to, and the P-1 bounds (0 if they weren't run)
+    int tfbits;
+    int64_t B1, B2;
 
-        mpt_subl(2 * N, S_it, 2);
+    // the time spent on it so far
+    double time;
+} h_job_t;
 
-        #ifdef MPT_TRACE_TERMS
-            mpt_gethexstr(S_it, 2 * N, tmp);
-            printf("  s^2-2  : 0x%s\n", tmp);
-        #endif
-        
-        mpt_mod2pm1(2 * N, S_it, S_i, p, Mp);
+// trial factor 2^p - 1 to 'tfbits' bits (or the default depth, if it is negative), and then run P-1 (with 'B1' and
+//   'B2', or the default bounds, if they are negative), and return whether it still needs to be tested. If a
+//   factor was found, the result is printed as a line of JSON
+static bool h_factor(h_job_t* j, int64_t p, int tfbits, int64_t B1, int64_t B2) {
+    double st = mpt_time();
+    bool pp = p > 2 && mpt_isprime(p);
+
+    mpt_tf_t tf;
+    tf.found = false;
+    tf.bits = 0;
+    if (tfbits != 0 && pp) mpt_tf(&tf, p, tfbits < 0 ? mpt_tf_bits(p) : tfbits);
+
+    mpt_pm1_t pm1;
+    pm1.found = false;
+    pm1.B1 = pm1.B2 = 0;
+    pm1.f = NULL;
+    if (!tf.found && B1 != 0 && pp) {
+        if (B1 < 0) mpt_pm1_bounds(p, &B1, &B2);
+        else if (B2 < 0) B2 = MPT_PM1_B2 * B1;
+        if (B1 > 0) mpt_pm1(&pm1, p, B1, B2);
+    }
 
-        #ifdef MPT_TRACE_TERMS
-            mpt_gethexstr(S_i, 2 * N, tmp);
-            printf("  s^2-2mM: 0x%s\n", tmp);
-        #endif
+    j->p = p;
+    j->tfbits = tf.bits;
+    j->B1 = pm1.B1;
+    j->B2 = pm1.B2;
+    j->time = mpt_time() - st;
+
+    if (tf.found || pm1.found) {
+        #pragma omp critical (mpt_batch_out)
+        {
+            if (tf.found) {
+                char tmp[44];
+                h_u128_str(tf.q, tmp);
+                printf("{\"p\": %lli, \"prime\": false, \"engine\": \"tf\", \"factor\": \"%s\", \"tf_bits\": %i, \"time\": %.6lf}\n", (long long int)p, tmp, tf.bits, j->time);
+            } else {
+                char* tmp = h_limbs_str(p / MPT_LIMB_BITS + 1, pm1.f);
+                printf("{\"p\": %lli, \"prime\": false, \"engine\": \"pm1\", \"factor\": \"%s\", \"stage\": %i, \"tf_bits\": %i, \"B1\": %lli, \"B2\": %lli, \"time\": %.6lf}\n", (long long int)p, tmp, pm1.stage, tf.bits, (long long int)pm1.B1, (long long int)pm1.B2, j->time);
+                free(tmp);
+            }
+            fflush(stdout);
+        }
+    }
 
+    mpt_pm1_free(&pm1);
+    return !tf.found && !pm1.found;
+}
 
+// print the result of testing 'j' with 'eng' as a line of JSON
+static void h_result(h_job_t* j, const mpt_engine_t* eng, bool isp) {
+    #pragma omp critical (mpt_batch_out)
+    {
+        printf("{\"p\": %lli, \"prime\": %s, \"engine\": \"%s\", \"tf_bits\": %i, \"B1\": %lli, \"B2\": %lli, \"time\": %.6lf}\n", (long long int)j->p, isp ? "true" : "false", eng->name, j->tfbits, (long long int)j->B1, (long long int)j->B2, j->time);
+        fflush(stdout);
     }
+    if (isp && h_dec_dir != NULL) h_write_dec(j->p);
+}
 
-    #ifdef MPT_TRACE_TERMS
-        mpt_gethexstr(S_i, N, tmp);
-        printf("S(final): 0x%s\n", tmp);
-    #endif
+// test 2^p - 1, by factoring it first (see 'h_factor'), and then running the engine if no factor was found. The
+//   result is printed as a line of JSON
+static void h_test(mpt_ctx_t* ctx, int64_t p, const mpt_engine_t* eng, int tfbits, int64_t B1, int64_t B2) {
+    h_job_t j;
+    if (!h_factor(&j, p, tfbits, B1, B2)) return;
 
+    // (so the result names the engine that was actually used)
+    if (eng->test == mpt_T_auto) eng = mpt_engine_auto(p);
 
-    bool hasNZ = false;
+    double st = mpt_time();
+    bool isp = eng->test(ctx, p);
+    j.time += mpt_time() - st;
+    h_result(&j, eng, isp);
+}
 
-    // ensure all are zero
-    for (i = 0; i < N; ++i) {
-        if (S_i[i] != 0) {
-            hasNZ  = true;
-            break;
-        }
+// verify the proof in 'fname', and print the result as a line of JSON, and return whether it is valid
+static bool h_verify(const char* fname) {
+    double st = mpt_time();
+    mpt_verify_t v;
+    bool valid = mpt_proof_verify(&v, fname);
+    st = mpt_time() - st;
+
+    if (valid) {
+        printf("{\"p\": %lli, \"prime\": %s, \"engine\": \"verify\", \"res64\": \"%016llx\", \"power\": %i, \"valid\": true, \"time\": %.6lf}\n", (long long int)v.p, v.prp ? "true" : "false", (unsigned long long int)v.res64, v.k, st);
+    } else {
+        fprintf(stderr, "[MPT_error]: The proof '%s' isn't valid (%s)\n", fname, v.why);
+        printf("{\"p\": %lli, \"engine\": \"verify\", \"valid\": false, \"time\": %.6lf}\n", (long long int)v.p, st);
     }
+    return valid;
+}
 
-    // free resources
-    free(S_i);
-    free(S_it);
-    free(Mp);
+// sorts largest first
+static int h_cmp_desc(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x < y) - (x > y);
+}
 
-    #ifdef MPT_TRACE_TERMS
-    free(tmp);
-    #endif
+// the same as 'h_batch' (after it is sorted), for an engine that tests several exponents at once
+// All of the exponents are factored first, and the ones that are left are put in groups of 'eng->lanes' (from the
+//   largest down, so the exponents in a group are close together). The time of each result is its factoring, plus
+//   the test of its whole group
+static void h_batch_n(h_plist_t* l, const mpt_engine_t* eng, int tfbits, int64_t B1, int64_t B2) {
+    h_job_t* jobs = malloc((l->n + 1) * sizeof(*jobs));
+    bool* need = malloc((l->n + 1) * sizeof(*need));
+
+    int64_t i;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (i = 0; i < l->n; ++i) {
+        need[i] = h_factor(&jobs[i], l->p[i], tfbits, B1, B2);
+    }
+
+    // (the ones that don't need a test are removed, and the rest stay in order)
+    int64_t n = 0, ng;
+    for (i = 0; i < l->n; ++i) {
+        if (need[i]) jobs[n++] = jobs[i];
+    }
+    ng = (n + eng->lanes - 1) / eng->lanes;
+
+    #pragma omp parallel
+    {
+        mpt_ctx_t ctx;
+        mpt_ctx_init(&ctx);
+        int64_t* p = malloc(eng->lanes * sizeof(*p));
+        bool* res = malloc(eng->lanes * sizeof(*res));
+
+        int64_t g;
+        #pragma omp for schedule(dynamic, 1)
+        for (g = 0; g < ng; ++g) {
+            h_job_t* jg = &jobs[g * eng->lanes];
+            int k = (int)(n - g * eng->lanes < eng->lanes ? n - g * eng->lanes : eng->lanes), j;
+            for (j = 0; j < k; ++j) p[j] = jg[j].p;
+
+            double st = mpt_time();
+            eng->test_n(&ctx, k, p, res);
+            st = mpt_time() - st;
+
+            for (j = 0; j < k; ++j) {
+                jg[j].time += st;
+                h_result(&jg[j], eng, res[j]);
+            }
+        }
 
-    // all were, thus it is prime
-    return !hasNZ;
+        free(res);
+        free(p);
+        mpt_ctx_free(&ctx);
+    }
 
+    free(need);
+    free(jobs);
 }
 
-// get the start time (initialize it in 'ks_init')
-static struct timeval mpt_start_time = (struct timeval){ .tv_sec = 0, .tv_usec = 0 };
+// test all of the exponents in 'l', in parallel, and print each result as a line of JSON as soon as it is done
+// The largest exponents are started first, and each thread takes the next one when it is done, so a large
+//   exponent doesn't end up running alone at the end while the other threads sit idle. Each thread keeps its own
+//   context, so consecutive exponents reuse its workspace and transform plans
+static void h_batch(h_plist_t* l, const mpt_engine_t* eng, int tfbits, int64_t B1, int64_t B2) {
+    qsort(l->p, l->n, sizeof(*l->p), h_cmp_desc);
 
-// return the time since it started
-double mpt_time() {
-    struct timeval curtime;
-    gettimeofday(&curtime, NULL);
-    return (curtime.tv_sec - mpt_start_time.tv_sec) + 1.0e-6 * (curtime.tv_usec - mpt_start_time.tv_usec);
-}
+    if (eng->lanes > 1) {
+        h_batch_n(l, eng, tfbits, B1, B2);
+        return;
+    }
 
+    #pragma omp parallel
+    {
+        mpt_ctx_t ctx;
+        mpt_ctx_init(&ctx);
 
-int main(int argc, char** argv) {
-    gettimeofday(&mpt_start_time, NULL);
+        int64_t i;
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < l->n; ++i) {
+            h_test(&ctx, l->p[i], eng, tfbits, B1, B2);
+        }
+
+        mpt_ctx_free(&ctx);
+    }
+}
 
-/*
-    mpt_limb_t* x = malloc(10000), *y = malloc(10000);
-    int64_t N = 32;
+static void h_usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-e engine] [-j threads] [-T threads] [-t bits] [-B B1[,B2]] [-c dir] [-s secs] [-i secs] [-C] [-H] [-P dir] [-w dir] [-d dir] [p | lo hi | -f file | -V file]\n", prog);
+    fprintf(stderr, "  -e engine   the engine to use (default: auto, which picks one by size), one of:");
+    int i;
+    for (i = 0; mpt_engines[i].name != NULL; ++i) fprintf(stderr, " %s", mpt_engines[i].name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -j threads  number of exponents to test at once (default: all cores, divided by '-T')\n");
+    fprintf(stderr, "  -T threads  number of threads for each squaring, with '-e basic0', '-e fft0', or '-e prp0' (default: 1)\n");
+    fprintf(stderr, "  -t bits     trial factor up to 'bits' bits before the test (default: depends on the exponent, 0 to skip)\n");
+    fprintf(stderr, "  -B B1[,B2]  run P-1 with these bounds before the test (default: depends on the exponent, 0 to skip, and B2 defaults to %i * B1)\n", MPT_PM1_B2);
+    fprintf(stderr, "  -c dir      keep checkpoints in 'dir', and resume from any that are there (default: none, and not with '-e simd0')\n");
+    fprintf(stderr, "  -s secs     time between checkpoints (default: %.0lf)\n", MPT_CKPT_INTERVAL);
+    fprintf(stderr, "  -i secs     print a progress line for each test every 'secs' seconds (default: 0, for none)\n");
+    fprintf(stderr, "  -C          count the cycles of each phase of an iteration (and print them at the end of each test)\n");
+    fprintf(stderr, "  -H          read the hardware counters (IPC and cache misses) of each test\n");
+    fprintf(stderr, "  -P dir      write a proof of each PRP test (with '-e prp0') to 'dir' (default: none)\n");
+    fprintf(stderr, "  -w dir      keep the tables of each transform length in 'dir', and map them from there (default: none)\n");
+    fprintf(stderr, "  -d dir      write the decimal expansion of each prime to 'dir/M<p>.txt' (default: none)\n");
+    fprintf(stderr, "  -V file     verify the proof in 'file' (instead of testing anything)\n");
+    fprintf(stderr, "  -f file     test the exponents in 'file' (one per line, '-' is stdin)\n");
+    fprintf(stderr, "  lo hi       test the exponents from 'lo' to 'hi' (inclusive)\n");
+    fprintf(stderr, "The exponents that aren't prime are skipped, and each result is printed as a line of JSON\n");
+}
 
-    mpt_sethexstr(x, N, "0x01eead7d8cc884082d709944");
-    char* tmp = malloc(MPT_HDPL * N + 4);
 
-    // mine:    0x3bbe2061e43b75b3f496d941e2b18d7687ba85f425a10
-    //          0x3bbe2061e43b75f1ca468adaf332a3249ae305f425a10
-    mpt_gethexstr(x, N, tmp);
-    printf("x: 0x%s\n", tmp);
+int main(int argc, char** argv) {
+    mpt_time_init();
+
+    // pick the kernels for this CPU ('MPT_KERN' may name a specific version)
+    mpt_kern_init(getenv("MPT_KERN"));
+
+    // flip a bit of the PRP test at this iteration, to test that the checks catch it (see 'mpt_prp_inject')
+    const char* inj = getenv("MPT_PRP_INJECT");
+    if (inj) mpt_prp_inject = strtoll(inj, NULL, 10);
+
+    const mpt_engine_t* eng = mpt_engine_find("auto");
+    const char* fname = NULL, *vname = NULL;
+    int64_t nthr = 0, args[2];
+    int tfbits = -1;
+    int64_t B1 = -1, B2 = -1;
+    int nargs = 0;
+
+    int i;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            eng = mpt_engine_find(argv[++i]);
+            if (eng == NULL) {
+                fprintf(stderr, "[MPT_error]: Unknown engine '%s'\n", argv[i]);
+                h_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nthr = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            mpt_sqr_threads = (int)strtol(argv[++i], NULL, 10);
+            if (mpt_sqr_threads < 1) mpt_sqr_threads = 1;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tfbits = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            char* end;
+            B1 = strtoll(argv[++i], &end, 10);
+            B2 = *end == ',' ? strtoll(end + 1, NULL, 10) : -1;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            mpt_ckpt_dir = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            mpt_ckpt_interval = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            mpt_prog_interval = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "-C") == 0) {
+            mpt_prog_cycles = true;
+        } else if (strcmp(argv[i], "-H") == 0) {
+            mpt_prog_perf = true;
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            mpt_proof_dir = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            mpt_plan_dir = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            h_dec_dir = argv[++i];
+        } else if (strcmp(argv[i], "-V") == 0 && i + 1 < argc) {
+            vname = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            fname = argv[++i];
+        } else if (argv[i][0] != '-' && nargs < 2) {
+            args[nargs++] = strtoll(argv[i], NULL, 10);
+        } else {
+            h_usage(argv[0]);
+            return 1;
+        }
+    }
 
-    mpt_sqr_naive(N / 2, x, y);
+    if (vname != NULL) return h_verify(vname) ? 0 : 1;
+
+    if (fname == NULL && nargs == 0) {
+        // just test a single one
+        int64_t p = 21701;
+        mpt_ctx_t ctx;
+        mpt_ctx_init(&ctx);
+        double st = mpt_time();
+        bool isp = eng->test(&ctx, p);
+        st = mpt_time() - st;
+        mpt_ctx_free(&ctx);
+        mpt_plan_clear();
+        if (isp) {
+            printf("M%lli is prime! (%.3lfms/iter)\n", (long long int)p, 1000.0 * st / (p - 2));
+            if (h_dec_dir != NULL) h_write_dec(p);
+        }
+        mpt_radix_clear();
+        return 0;
+    }
 
-    mpt_gethexstr(y, N, tmp);
-    printf("y: 0x%s\n", tmp);
-*/
+    #ifdef _OPENMP
+    // each exponent's squarings run in a team of their own, inside the one that tests the exponents
+    if (mpt_sqr_threads > 1) {
+        omp_set_max_active_levels(2);
+        if (nthr <= 0) nthr = omp_get_num_procs() / mpt_sqr_threads;
+        if (nthr <= 0) nthr = 1;
+    }
+    if (nthr > 0) omp_set_num_threads(nthr);
+    #endif
 
-    /*int64_t i;
-    for (i = 3; i < 1e9; ++i) {
-    */
-    int64_t p = 21701;
-    double st = mpt_time();
-    bool isp = mpt_T_basic0(p);
-    st = mpt_time() - st;
-    if (isp) {
-        printf("M%i is prime! (%.3lfms/iter)\n", p, 1000.0 * st / (p - 2));
+    h_plist_t l = (h_plist_t){ .p = NULL, .n = 0, .cap = 0 };
+    if (fname != NULL && !h_plist_read(&l, fname)) {
+        fprintf(stderr, "[MPT_error]: Couldn't read '%s'\n", fname);
+        return 1;
     }
-    //}
 
-}
+    if (nargs == 1) h_plist_add(&l, args[0]);
+    else if (nargs == 2) h_plist_range(&l, args[0], args[1]);
 
+    h_batch(&l, eng, tfbits, B1, B2);
 
+    free(l.p);
+    mpt_plan_clear();
+    mpt_radix_clear();
+    return 0;
+}
@@ -5,6 +5,35 @@
 
 #include "MPT-impl.h"
 
+#include <omp.h>
+
+
+int mpt_sqr_threads = 1;
+
+
+/* helpers */
+
+// C += X, where 'C' has 'n' limbs, and 'X' has 'nx' limbs (nx <= n), and returns the carry out of 'C'
+static mpt_limb_t h_add_cy(mpt_limb_t* C, int64_t n, mpt_limb_t* X, int64_t nx) {
+    mpt_limb_t c = 0, s, c1;
+    int64_t i;
+    for (i = 0; i < nx; ++i) {
+        s = C[i] + X[i];
+        c1 = s < X[i];
+        s += c;
+        c = c1 | (s < c);
+        C[i] = s;
+    }
+    for (; c && i < n; ++i) c = ++C[i] == 0;
+    return c;
+}
+
+// return the number of products in column 'k' of the square of 'N' limbs (see 'k_sqr_comba')
+static int64_t h_sqr_colwork(int64_t N, int64_t k) {
+    int64_t lo = k < N ? 0 : k - N + 1;
+    return (k - 2 * lo) / 2 + 1;
+}
+
 // Set A <- A + b
 void mpt_addl(int64_t N, mpt_limb_t* A, mpt_limb_t b) {
 
@@ -52,6 +81,96 @@ void mpt_subl(int64_t N, mpt_limb_t* A, mpt_limb_t b) {
     }
 }
 
+// R = A + B, returns the carry
+mpt_limb_t mpt_add_n(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B) {
+    return mpt_kern.add_n(N, R, A, B);
+}
+
+// R = A - B, returns the borrow
+mpt_limb_t mpt_sub_n(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t* B) {
+    return mpt_kern.sub_n(N, R, A, B);
+}
+
+// R = A + B, where 'A' has 'NA' limbs and 'B' has 'NB' limbs (NA >= NB), returns the carry
+mpt_limb_t mpt_add(mpt_limb_t* R, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB) {
+    mpt_limb_t c = mpt_add_n(NB, R, A, B);
+    int64_t i;
+    for (i = NB; i < NA; ++i) {
+        R[i] = A[i] + c;
+        c = R[i] < c;
+    }
+    return c;
+}
+
+// R = A - B, where 'A' has 'NA' limbs and 'B' has 'NB' limbs (NA >= NB), returns the borrow
+mpt_limb_t mpt_sub(mpt_limb_t* R, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB) {
+    mpt_limb_t c = mpt_sub_n(NB, R, A, B);
+    int64_t i;
+    for (i = NB; i < NA; ++i) {
+        mpt_limb_t a = A[i];
+        R[i] = a - c;
+        c = a < c;
+    }
+    return c;
+}
+
+// compare A and B, returning -1, 0, or 1
+int mpt_cmp(int64_t N, mpt_limb_t* A, mpt_limb_t* B) {
+    int64_t i;
+    for (i = N - 1; i >= 0; --i) {
+        if (A[i] != B[i]) return A[i] < B[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// R = A << s (for 0 < s < MPT_LIMB_BITS), returns the bits shifted out of the top
+mpt_limb_t mpt_lshift(int64_t N, mpt_limb_t* R, mpt_limb_t* A, int s) {
+    int64_t i;
+    mpt_limb_t out = A[N - 1] >> (MPT_LIMB_BITS - s);
+    for (i = N - 1; i > 0; --i) {
+        R[i] = (A[i] << s) | (A[i - 1] >> (MPT_LIMB_BITS - s));
+    }
+    R[0] = A[0] << s;
+    return out;
+}
+
+// R = A >> s (for 0 < s < MPT_LIMB_BITS), returns the bits shifted out of the bottom (in the top of the limb)
+mpt_limb_t mpt_rshift(int64_t N, mpt_limb_t* R, mpt_limb_t* A, int s) {
+    int64_t i;
+    mpt_limb_t out = A[0] << (MPT_LIMB_BITS - s);
+    for (i = 0; i < N - 1; ++i) {
+        R[i] = (A[i] >> s) | (A[i + 1] << (MPT_LIMB_BITS - s));
+    }
+    R[N - 1] = A[N - 1] >> s;
+    return out;
+}
+
+// R = A / d, when 'd' is odd and known to divide 'A' exactly
+// Uses Hensel (right to left) division, with multiplications by d^-1 (mod 2^MPT_LIMB_BITS), instead of divisions
+void mpt_divexact_1(int64_t N, mpt_limb_t* R, mpt_limb_t* A, mpt_limb_t d) {
+    // Newton's iteration doubles the number of correct bits each time (and 'd' is its own inverse mod 8)
+    mpt_limb_t dinv = d;
+    int i;
+    for (i = 0; i < 5; ++i) dinv = (mpt_limb_t)((uint64_t)dinv * (2 - (uint64_t)d * dinv));
+
+    int64_t j;
+    mpt_limb_t c = 0, lohi[2];
+    for (j = 0; j < N; ++j) {
+        mpt_limb_t a = A[j], t = a - c, b = a < c;
+        mpt_limb_t q = (mpt_limb_t)((uint64_t)t * dinv);
+        R[j] = q;
+        mptl_mul(q, d, lohi);
+        c = lohi[1] + b;
+    }
+}
+
+// calculate C=A^2, A[N], C[2N]
+// uses column-wise (Comba) squaring, see 'MPT-kern.h'
+void mpt_sqr_comba(int64_t N, mpt_limb_t* A, mpt_limb_t* C) {
+    if (N >= MPT_SQR_COMBA_MAX_N) mpt_sqr_naive(N, A, C);
+    else mpt_kern.sqr_basecase(N, A, C);
+}
+
 // calculate C=A^2, A[N], C[2N]
 // uses the naive algo, O(N^2)
 void mpt_sqr_naive(int64_t N, mpt_limb_t* A, mpt_limb_t* C) {
@@ -109,228 +228,471 @@ void mpt_sqr_naive(int64_t N, mpt_limb_t* A, mpt_limb_t* C) {
 
 }
 
+void mpt_sqr_comba_par(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int nthr) {
+    int64_t nc = 2 * N - 1, tot = 0, acc = 0, k;
+    if (nthr > N / 2) nthr = (int)(N / 2);
+
+    // split up the columns so each thread has about the same number of products, so thread 't' does columns
+    //   'kb[t]' to 'kb[t+1]' (exclusive), and each has at least 2 (so the carry into the next one fits in it)
+    int64_t kb[nthr > 1 ? nthr + 1 : 1];
+    int t = 1;
+    if (nthr > 1) {
+        for (k = 0; k < nc; ++k) tot += h_sqr_colwork(N, k);
+        kb[0] = 0;
+        for (k = 0; k < nc && t < nthr; ++k) {
+            acc += h_sqr_colwork(N, k);
+            if (acc * nthr >= tot * t && k + 1 >= kb[t - 1] + 2) kb[t++] = k + 1;
+        }
+        kb[nthr] = nc;
+    }
+    if (nthr < 2 || t < nthr || kb[nthr - 1] + 2 > 2 * N || N >= MPT_SQR_COMBA_MAX_N) {
+        mpt_sqr_comba(N, A, C);
+        return;
+    }
 
-// helper for the modulo
-static void mod_h0() {
+    // the carry out of each thread's columns, and the carry out of each thread's columns after the carry from the
+    //   one before it was added on
+    mpt_limb_t cy[2 * nthr], ov[nthr];
 
-}
+    #pragma omp parallel num_threads(nthr)
+    {
+        int i;
 
+        // (the last thread's carry is just the last limb)
+        #pragma omp for schedule(static, 1)
+        for (i = 0; i < nthr; ++i) mpt_kern.sqr_cols(N, A, C, kb[i], kb[i + 1], i + 1 < nthr ? &cy[2 * i] : NULL);
 
-// helper function
-static void h_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t* Mp, int64_t* cbits) {
-    // number of limbs that Mp takes up
-    int64_t Mp_N = p / MPT_LIMB_BITS + 1;
+        #pragma omp for schedule(static, 1)
+        for (i = 1; i < nthr; ++i) ov[i] = h_add_cy(&C[kb[i]], (i + 1 < nthr ? kb[i + 1] : 2 * N) - kb[i], &cy[2 * (i - 1)], 2);
+    }
 
-    // nothing neccessary but to copy it
-    if (N < Mp_N) {
-        memcpy(C, A, MPT_LIMB_SIZE * N);
-        return;
+    // those only carry out if all of the next thread's limbs were 1's, so this almost never goes far
+    mpt_limb_t one = 1;
+    for (t = 1; t + 1 < nthr; ++t) {
+        if (ov[t]) h_add_cy(&C[kb[t + 1]], 2 * N - kb[t + 1], &one, 1);
     }
+}
 
-    *cbits -= p;
 
-    // create a 'mask' for which bits of Mp exist on Mp[Mp_N - 1]
-    mpt_limb_t lmask = (1ULL << (p % MPT_LIMB_BITS)) - 1;
+/* mod 2^p - 1 */
 
-    // loop vars
-    int64_t i, j;
+void mpt_fold_init(mpt_fold_t* f, int64_t p, mpt_limb_t* C, mpt_limb_t c) {
+    f->p = p;
+    f->q = p / MPT_LIMB_BITS;
+    f->r = p % MPT_LIMB_BITS;
+    f->mask = ((mpt_limb_t)1 << f->r) - 1;
+    f->C = C;
+    f->k = 0;
+    f->prev = 0;
+    f->cy = 0;
+    f->top = 0;
+    f->bw = c;
+}
 
-    // temp vars
-    mpt_limb_t Ai, Aip, carry, lohi[2];
-
-    // offset indices
-    int64_t i_Ao = p / MPT_LIMB_BITS, i_Am = p % MPT_LIMB_BITS;
-
-    // 0 it out
-    memset(C, 0, MPT_LIMB_SIZE * N);
-    A[N] = 0;
-
-    int maxI = 0;
-
-    bool all1 = true;
-
-    for (i = 0; i < N - Mp_N; ++i) {
-        /**/ if (i > Mp_N - 1) Ai = 0;
-        else if (i == Mp_N - 1) Ai = A[i] & lmask;
-        else Ai = A[i];
-        Aip = mptl_getodd(&A[i + i_Ao], i_Am);
-
-        mptl_add(Ai, Aip, lohi);
-        carry = lohi[1];
-        mptl_add(C[i], lohi[0], lohi);
-        C[i] = lohi[0];
-        carry += lohi[1];
-        
-        all1 = all1 && ((i == Mp_N - 1) ? (C[i] & lmask == lmask) : (C[i] == MPT_LIMB_MAX));
-
-        j = i + 1;
-        while (carry > 0) {
-            mptl_add(C[j], carry, lohi);
-            C[j] = lohi[0];
-            carry = lohi[1];
-            maxI = ++j;
+void mpt_fold_finish(mpt_fold_t* f) {
+    int64_t q = f->q, j;
+    int r = f->r;
+    mpt_limb_t* C = f->C, c, c1, s;
+
+    // the rest of the limbs are 0 (which also completes the top limbs of the high part)
+    while (f->k < 2 * q + 3) mpt_fold_push(f, 0);
+
+    // now, everything at or past bit 'p' wraps around to the bottom (since 2^p == 1), which is:
+    //   the top bits of C[q] (worth 2^p), and the carry out of C[q] and the part of the high part that didn't
+    //   fit (both worth 2^(p + MPT_LIMB_BITS - r)), and they are summed into 'e1:e0'
+    mpt_limb_t v = f->cy + f->top;
+    mpt_limb_t e0 = (mpt_limb_t)(v << (MPT_LIMB_BITS - r)), e1 = v >> r, t = C[q] >> r;
+    e0 += t;
+    e1 += e0 < t;
+    C[q] &= f->mask;
+
+    // if 'c' was more than the low part, it borrowed 2^p (which is 1), so take 1 more off of that, or the rest
+    //   (which is at least 2^p - c then, so it can't go negative)
+    if (f->bw) {
+        if (e0 | e1) {
+            e1 -= e0 == 0;
+            e0--;
+        } else {
+            for (j = 0; C[j]-- == 0; ++j);
         }
     }
 
-    if (maxI < i) maxI = i;
+    // that is less than 2^(2 * MPT_LIMB_BITS), so this only matters for tiny 'p'
+    while (q < 2 && (q == 1 ? (e1 >> r) : (e1 | (e0 >> r))) != 0) {
+        mpt_limb_t h0, h1;
+        if (q == 1) {
+            h0 = e1 >> r;
+            h1 = 0;
+            e1 &= f->mask;
+        } else {
+            h0 = (mpt_limb_t)((e0 >> r) | (e1 << (MPT_LIMB_BITS - r)));
+            h1 = e1 >> r;
+            e0 &= f->mask;
+            e1 = 0;
+        }
+        e0 += h0;
+        e1 += h1 + (e0 < h0);
+    }
 
-    // now, set rest to 0
-    i = all1 ? 0 : maxI;
+    // add it on (it is less than 2^p, so this doesn't go past C[q])
+    c = 0;
+    for (j = 0; j <= q && (j < 2 || c != 0); ++j) {
+        mpt_limb_t e = j == 0 ? e0 : (j == 1 ? e1 : 0);
+        s = C[j] + e;
+        c1 = s < e;
+        s += c;
+        c = c1 | (s < c);
+        C[j] = s;
+    }
 
-    //i = maxI;
-    while (i < N) C[i++] = 0;
+    // it is less than 2^(p+1) now, so wrap the last bit around
+    while (C[q] >> r) {
+        C[q] &= f->mask;
+        for (j = 0; j <= q && ++C[j] == 0; ++j);
+    }
 
+    // check whether it is exactly 2^p - 1 (which is 0)
+    bool all1 = C[q] == f->mask;
+    for (j = 0; all1 && j < q; ++j) all1 = C[j] == MPT_LIMB_MAX;
+    if (all1) mpt_set_0(C, q + 1);
 }
 
-// calculate C = A % 2^p - 1
-// C has 'N' limbs, as does 'A'
-void mpt_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t* Mp) {
+// calculate C = A % 2^p - 1, in a single pass (see 'mpt_fold_t')
+void mpt_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p) {
+    mpt_mod2pm1_c(N, A, C, p, 0);
+}
 
-    int64_t bits = p;
-    h_mod2pm1(N, A, C, p, Mp, &bits);
-    h_mod2pm1(N, C, A, p, Mp, &bits);
-    h_mod2pm1(N, A, C, p, Mp, &bits);
-    h_mod2pm1(N, C, A, p, Mp, &bits);
+// calculate C = A - c % 2^p - 1, in a single pass (or in parallel, see 'mpt_sqr_threads')
+void mpt_mod2pm1_c(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c) {
+    if (mpt_sqr_threads > 1 && p / MPT_LIMB_BITS >= MPT_MOD_PAR_THRESH && A != C) {
+        mpt_mod2pm1_par(N, A, C, p, c, mpt_sqr_threads);
+        return;
+    }
 
+    mpt_fold_t f;
+    mpt_fold_init(&f, p, C, c);
 
-    memcpy(C, A, MPT_LIMB_SIZE * N);
+    int64_t i;
+    for (i = 0; i < N; ++i) mpt_fold_push(&f, A[i]);
 
-    /*
+    mpt_fold_finish(&f);
+}
 
-    // original N
-    int64_t oN = N;
+// the limb 'k' of 'A' (which has 'N' limbs), or 0 past the end
+#define H_LIMB(A, N, k) ((k) < (N) ? (A)[k] : 0)
+
+void mpt_mod2pm1_par(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c, int nthr) {
+    mpt_fold_t f;
+    mpt_fold_init(&f, p, C, c);
+    int64_t q = f.q, jb;
+    int r = f.r, t;
+    if (nthr > q + 1) nthr = (int)(q + 1);
+
+    // the low part minus 'c', the same as 'mpt_fold_push' (the borrow only goes on while the limbs are 0, so this
+    //   is almost always just C[0]), which leaves the borrow out of it in 'f.bw'
+    for (jb = 0; f.bw != 0 && jb <= q; ++jb) {
+        mpt_limb_t v = H_LIMB(A, N, jb);
+        if (jb == q) v &= f.mask;
+        C[jb] = jb == q ? ((v - f.bw) & f.mask) : v - f.bw;
+        f.bw = v < f.bw;
+    }
 
-    A[N] = 0;
+    // thread 't' does limbs 'lb[t]' to 'lb[t+1]' (exclusive) of 'C', and the carry out of them goes in 'cy[t]',
+    //   and the carry out of them after the carry from the one before it was added on goes in 'ov[t]'
+    int64_t lb[nthr + 1];
+    mpt_limb_t cy[nthr], ov[nthr];
+    for (t = 0; t <= nthr; ++t) lb[t] = (q + 1) * t / nthr;
+    ov[0] = 0;
+
+    #pragma omp parallel num_threads(nthr)
+    {
+        int i;
+
+        // C = low + high, where the high part is A >> p
+        #pragma omp for schedule(static, 1)
+        for (i = 0; i < nthr; ++i) {
+            mpt_limb_t cc = 0, lo, h, s, c1;
+            int64_t j;
+            for (j = lb[i]; j < lb[i + 1]; ++j) {
+                lo = j < jb ? C[j] : H_LIMB(A, N, j);
+                if (j == q) lo &= f.mask;
+                h = (mpt_limb_t)((H_LIMB(A, N, q + j) >> r) | (H_LIMB(A, N, q + j + 1) << (MPT_LIMB_BITS - r)));
+                s = lo + h;
+                c1 = s < h;
+                s += cc;
+                cc = c1 | (s < cc);
+                C[j] = s;
+            }
+            cy[i] = cc;
+        }
 
+        #pragma omp for schedule(static, 1)
+        for (i = 1; i < nthr; ++i) ov[i] = h_add_cy(&C[lb[i]], lb[i + 1] - lb[i], &cy[i - 1], 1);
+    }
 
-    // already smaller than Mp, so no need to do modulo
-    if (N < Mp_N) return;
+    // the carry out of the top (which is added to the part past 'C', like 'mpt_fold_push' does), with the carries
+    //   that went past the end of each thread's limbs (which almost never happens)
+    mpt_limb_t one = 1;
+    f.cy = cy[nthr - 1] + ov[nthr - 1];
+    for (t = 1; t + 1 < nthr; ++t) {
+        if (ov[t]) f.cy += h_add_cy(&C[lb[t + 1]], q + 1 - lb[t + 1], &one, 1);
+    }
 
+    // the part of the high part past 'C', and then finish it the same way
+    f.top = (mpt_limb_t)((H_LIMB(A, N, 2 * q + 1) >> r) | (H_LIMB(A, N, 2 * q + 2) << (MPT_LIMB_BITS - r)));
+    f.k = 2 * q + 3;
+    mpt_fold_finish(&f);
+}
 
-    // the 'offset' section of 'A' (a minor index is also required)
-    mpt_limb_t* Aoff = &A[Mp_N];
+#undef H_LIMB
 
-    // the number of bits off that 'Aoff' should be read from
-    int64_t Aoff_mr = p % MPT_LIMB_BITS;
+// calculate C = A^2 - c % 2^p - 1, A[N], C[N]
+// the basecase pushes each column into the reduction as soon as it is done, see 'MPT-kern.h'
+void mpt_sqr_mod2pm1(int64_t N, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c) {
+    mpt_kern.sqr_mod2pm1(N, A, C, p, c);
+}
 
 
-    i = 0;
-    // keep removing a word from the top
-    while (N > Mp_N+2 && A[Mp_N] > lmask) {
+/* arithmetic (mod 2^p - 1) */
 
-        Ai = A[i] & lmask;
-        Aip = mptl_getodd(&A[i_Ao], i_Am);
+int64_t mpt_ll_scratch(int64_t p) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    if (N < MPT_SQR_KARA_THRESH) {
+        return N;
+    } else {
+        return 2 * N + mpt_sqr_scratch(N);
+    }
+}
 
-        printf(" :: %x %x\n", Ai, Aip);
+int64_t mpt_mod_scratch(int64_t p) {
+    return 2 * (p / MPT_LIMB_BITS + 1) + mpt_ll_scratch(p);
+}
 
-        mptl_add(Ai, Aip, lohi);
+// return whether S (mod 2^p - 1), S[N], can be squared with the unrolled kernel for its size (which needs it to
+//   be less than 2^p, which it almost always is)
+static bool h_sqr_small(int64_t p, int64_t N, mpt_limb_t* S) {
+    return N <= MPT_SQR_SMALL_N && mpt_kern.sqr_small != NULL && (S[N - 1] >> (p % MPT_LIMB_BITS)) == 0;
+}
 
-        //A[i] = Ai + Aip;
-        A[i] = lohi[0];
+// calculate S = S^2 - c % 2^p - 1, S[N]
+// for the smallest sizes, there is a kernel for each 'N'. For the basecase, the reduction is fused into the
+//   squaring, so only a copy of 'S' is needed. Otherwise, the square is computed into 'T', and then reduced
+//   straight back into 'S' in a single pass
+void mpt_sqr_mod(int64_t p, mpt_limb_t* S, mpt_limb_t c, mpt_limb_t* T) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    if (h_sqr_small(p, N, S)) {
+        mpt_kern.sqr_small[N](S, p, c);
+    } else if (N < MPT_SQR_KARA_THRESH) {
+        memcpy(T, S, N * MPT_LIMB_SIZE);
+        mpt_kern.sqr_mod2pm1(N, T, S, p, c);
+    } else {
+        mpt_sqr(N, S, T, &T[2 * N]);
+
+        mpt_mod2pm1_c(2 * N, T, S, p, c);
+    }
+}
 
-        // ignore last digit, it has now been 'solved'
-        N--;
+// calculate S = S^2 - c % 2^p - 1, S[N], the same as 'mpt_sqr_mod', while counting the cycles of each phase
+void mpt_sqr_mod_timed(int64_t p, mpt_limb_t* S, mpt_limb_t c, mpt_limb_t* T, uint64_t* cyc) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    uint64_t t0 = mpt_rdtsc(), t1;
+    if (h_sqr_small(p, N, S)) {
+        mpt_kern.sqr_small[N](S, p, c);
+        cyc[MPT_PHASE_SQR] += mpt_rdtsc() - t0;
+    } else if (N < MPT_SQR_KARA_THRESH) {
+        // (the reduction is fused into the square)
+        memcpy(T, S, N * MPT_LIMB_SIZE);
+        mpt_kern.sqr_mod2pm1(N, T, S, p, c);
+        cyc[MPT_PHASE_SQR] += mpt_rdtsc() - t0;
+    } else {
+        mpt_sqr(N, S, T, &T[2 * N]);
+        t1 = mpt_rdtsc();
+        cyc[MPT_PHASE_SQR] += t1 - t0;
+
+        mpt_mod2pm1_c(2 * N, T, S, p, c);
+        cyc[MPT_PHASE_RED] += mpt_rdtsc() - t1;
     }
+}
 
+// calculate S = S^2 - 2 % 2^p - 1, S[N]
+void mpt_ll_step(int64_t p, mpt_limb_t* S, mpt_limb_t* T) {
+    mpt_sqr_mod(p, S, 2, T);
+}
 
-    // check if they were all 1s
-    bool hasO = (A[Mp_N - 1] & lmask) == lmask;
-    for (i = 0; hasO && i < N; ++i) {
-        hasO = hasO && A[i] == MPT_LIMB_MAX;
+// calculate C = A - B % 2^p - 1, A[N], B[N], C[N] (all less than 2^p - 1)
+void mpt_sub_mod(int64_t p, mpt_limb_t* A, mpt_limb_t* B, mpt_limb_t* C) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    if (mpt_sub_n(N, C, A, B)) {
+        // it wrapped around to A - B + 2^(N * MPT_LIMB_BITS), and A - B + 2^p - 1 is wanted (which is still
+        //   positive, so it is the low 'p' bits, minus 1)
+        C[N - 1] &= ((mpt_limb_t)1 << (p % MPT_LIMB_BITS)) - 1;
+        mpt_subl(N, C, 1);
     }
+}
 
-    for (i = (hasO) ? 0 : Mp_N; i < oN; ++i) {
-        A[i] = 0;
-    }
-    */
+// calculate C = A * B % 2^p - 1, A[N], B[N], C[N]
+// this is done with 2 squarings (which are faster than a general multiplication, and are already tuned), as:
+//   A * B == ((A + B)^2 - (A - B)^2) / 4, and dividing by 4 is just rotating right by 2 bits (since 2^p == 1)
+void mpt_mul_mod(int64_t p, mpt_limb_t* A, mpt_limb_t* B, mpt_limb_t* C, mpt_limb_t* T) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    mpt_limb_t* U = T, *V = &T[N];
+
+    // U = A + B (which is less than 2^(p+1), so it fits), and V = |A - B|
+    mpt_add_n(N, U, A, B);
+    if (mpt_cmp(N, A, B) >= 0) mpt_sub_n(N, V, A, B);
+    else mpt_sub_n(N, V, B, A);
+
+    mpt_sqr_mod(p, U, 0, &T[2 * N]);
+    mpt_sqr_mod(p, V, 0, &T[2 * N]);
+    mpt_sub_mod(p, U, V, U);
+
+    // rotate the low 2 bits to the top
+    mpt_limb_t lo = mpt_rshift(N, C, U, 2) >> (MPT_LIMB_BITS - 2);
+    if (lo & 1) C[(p - 2) / MPT_LIMB_BITS] |= (mpt_limb_t)1 << ((p - 2) % MPT_LIMB_BITS);
+    if (lo & 2) C[(p - 1) / MPT_LIMB_BITS] |= (mpt_limb_t)1 << ((p - 1) % MPT_LIMB_BITS);
+}
 
 
-    /*
-    int64_t pN = p / MPT_LIMB_BITS + 1;
+/* GCD */
 
-    // already smaller than 2^p - 1
-    if (N < pN - 1) return;
-    // TODO: check for when they are the same, and try and eliminate any zero values at the end of 'N'?
+// the GCD is done on 64 bit words (so the limbs are packed into them, if they are smaller)
+#define H_LPW ((int)(64 / MPT_LIMB_BITS))
 
-    // now, we can use the fact that:
-    // A = (A mod 2^p) + floor(A / 2^p), in (mod 2^p - 1)
-    // And further, that 'A mod 2^p' is just the first 'p' bits of 'A',
-    // and 'floor(A / 2^p)' is the same thing as 'A' shifted over 'p' bits
+// W = A, where 'W' has 'n' words, and 'A' has 'N' limbs
+static void h_to64(int64_t N, mpt_limb_t* A, int64_t n, uint64_t* W) {
+    int64_t i;
+    int j;
+    for (i = 0; i < n; ++i) {
+        W[i] = 0;
+        for (j = 0; j < H_LPW && i * H_LPW + j < N; ++j) W[i] |= (uint64_t)A[i * H_LPW + j] << (j * MPT_LIMB_BITS % 64);
+    }
+}
 
-    int64_t i, j;
+// A = W, where 'W' has 'n' words, and 'A' has 'N' limbs
+static void h_from64(int64_t n, uint64_t* W, int64_t N, mpt_limb_t* A) {
+    int64_t i;
+    for (i = 0; i < N; ++i) A[i] = i / H_LPW < n ? (mpt_limb_t)(W[i / H_LPW] >> (i % H_LPW * MPT_LIMB_BITS % 64)) : 0;
+}
 
-    // temp vars
-    mpt_limb_t Ai, Aip, lohi[2];
-
-    // the mask on the last word that pertains to Mp
-    mpt_limb_t lmask = (1ULL << (p % MPT_LIMB_BITS)) - 1;
-
-    A[pN] &= lmask;
-    for (i = pN + 1; i < N; ++i) A[i] = 0;
-
-    // keep track if the output was all 1s
-    bool hadOnes = true;
-
-    for (i = 0; i < pN+1; ++i) {
-        // essentially, we have:
-        // A: abcdefgh... (each letter represents 1 bit)
-        // And we know that (mod 2^p-1), the following numbers are equivalent:
-        //
-        // abcdefgh...
-        //
-        //   and
-        //
-        // abcdefgh...
-        // fgh...
-        // (if, p = 5, skip the first 5 on the second summation)
-        //
-        //
-
-        // return the 2 offsets
-        Ai = A[i];
-        Aip = mptl_getodd(&A[i + p / MPT_LIMB_BITS], p % MPT_LIMB_BITS);
-
-        //printf("Ai = %x %x\n", A[i + p / MPT_LIMB_BITS], A[i + p / MPT_LIMB_BITS + 1]);
-        //printf("sum = %x\n", A[i + p / MPT_LIMB_BITS] + A[i + p / MPT_LIMB_BITS + 1]);
-
-        // add them together
-        mptl_add(Ai, Aip, lohi);
-
-        // A = low
-        A[i] = lohi[0];
-
-        //printf("Ai = %x\n", A[i]);
-
-        // now, continue carrying the hi bit
-        if (lohi[1] > 0) {
-            j = i + 1;
-            // check while we need to carry
-            while (A[j] == MPT_LIMB_MAX) {
-                j++;
-            }
-            // add final carry bit
-            A[j]++;
-        }
+// A = (A * f0 + B * g0) / 2^31, B = (A * f1 + B * g1) / 2^31 (which are exact), where both have 'n' words, and then
+//   negate either of them if they are negative
+static void h_gcd_lin(int64_t n, uint64_t* A, uint64_t* B, int64_t f0, int64_t g0, int64_t f1, int64_t g1) {
+    int64_t i;
 
-        // ensure it was all ones
-        if (i == pN - 1) {
-            //printf("HAD_ONES: %i\n", A[i]);
-            hadOnes = hadOnes && (A[i] & lmask) == lmask;
+    // signed carries, and the previous words (before the shift)
+    int64_t ca = 0, cb = 0;
+    uint64_t pa = 0, pb = 0;
+    for (i = 0; i <= n; ++i) {
+        uint64_t ta, tb;
+        if (i < n) {
+            uint64_t a = A[i], b = B[i], h0, h1, h2, h3;
+
+            // signed products, as 128 bit two's complement
+            uint64_t l0 = mpt_mul64(a, (uint64_t)f0, &h0), l1 = mpt_mul64(b, (uint64_t)g0, &h1);
+            uint64_t l2 = mpt_mul64(a, (uint64_t)f1, &h2), l3 = mpt_mul64(b, (uint64_t)g1, &h3);
+            if (f0 < 0) h0 -= a;
+            if (g0 < 0) h1 -= b;
+            if (f1 < 0) h2 -= a;
+            if (g1 < 0) h3 -= b;
+
+            ta = l0 + l1;
+            h0 += h1 + (ta < l0);
+            ta += (uint64_t)ca;
+            h0 += (uint64_t)(ca >> 63) + (ta < (uint64_t)ca);
+            ca = (int64_t)h0;
+
+            tb = l2 + l3;
+            h2 += h3 + (tb < l2);
+            tb += (uint64_t)cb;
+            h2 += (uint64_t)(cb >> 63) + (tb < (uint64_t)cb);
+            cb = (int64_t)h2;
         } else {
-            // normal detection
-            hadOnes = hadOnes && (A[i] == MPT_LIMB_MAX);
+            // the top words are the carries
+            ta = (uint64_t)ca;
+            tb = (uint64_t)cb;
         }
-    }
 
-    A[pN - 1] &= lmask;
+        if (i > 0) {
+            A[i - 1] = (pa >> 31) | (ta << 33);
+            B[i - 1] = (pb >> 31) | (tb << 33);
+        }
+        pa = ta;
+        pb = tb;
+    }
 
-    // reset pointer back to start
-    // check for edge case where the result is Mp
-    if (hadOnes) {
-        i = 0;
-        while (i < N) A[i++] = 0;
+    // negate, if the top is negative (which is all that is left after the shift)
+    if (ca < 0) {
+        for (i = 0; i < n; ++i) A[i] = ~A[i];
+        for (i = 0; i < n && ++A[i] == 0; ++i);
     }
+    if (cb < 0) {
+        for (i = 0; i < n; ++i) B[i] = ~B[i];
+        for (i = 0; i < n && ++B[i] == 0; ++i);
+    }
+}
+
+// calculate G = gcd(A, B), where B is odd
+// This is a binary GCD, but 31 steps at a time are done on approximations of 'A' and 'B' (the low 31 bits, and the
+//   top 33 bits, which decide the parities and comparisons), and then applied to the full numbers at once as a
+//   linear combination (see Pornin, "Optimized Binary GCD for Modular Inversion"). If a comparison was wrong
+//   because of the approximation, the result just comes out negative, and is negated
+void mpt_gcd_n(int64_t N, mpt_limb_t* A, mpt_limb_t* B, mpt_limb_t* G) {
+    int64_t n = (N + H_LPW - 1) / H_LPW;
+    uint64_t* a = malloc(2 * n * sizeof(*a)), *b = &a[n];
+    h_to64(N, A, n, a);
+    h_to64(N, B, n, b);
+
+    while (true) {
+        // ignore the top words that are 0 in both
+        while (n > 1 && (a[n - 1] | b[n - 1]) == 0) n--;
+
+        int64_t i;
+        bool az = true;
+        for (i = 0; az && i < n; ++i) az = a[i] == 0;
+        if (az) break;
+
+        // approximations, which are exact if they fit in 64 bits
+        uint64_t xa, xb;
+        if (n == 1) {
+            xa = a[0];
+            xb = b[0];
+        } else {
+            // the top 33 bits of the larger one (and the same bits of the other), and the low 31 bits
+            uint64_t t = a[n - 1] | b[n - 1];
+            int s = __builtin_clzll(t);
+            uint64_t ha = s == 0 ? a[n - 1] : (a[n - 1] << s) | (a[n - 2] >> (64 - s));
+            uint64_t hb = s == 0 ? b[n - 1] : (b[n - 1] << s) | (b[n - 2] >> (64 - s));
+            xa = ((ha >> 31) << 31) | (a[0] & 0x7fffffff);
+            xb = ((hb >> 31) << 31) | (b[0] & 0x7fffffff);
+        }
+
+        // the transformation, which is applied to 'a' and 'b' afterwards
+        int64_t f0 = 1, g0 = 0, f1 = 0, g1 = 1;
+        int j;
+        for (j = 0; j < 31; ++j) {
+            if (xa & 1) {
+                if (xa < xb) {
+                    uint64_t tx = xa;
+                    xa = xb;
+                    xb = tx;
+                    int64_t tf = f0, tg = g0;
+                    f0 = f1;
+                    g0 = g1;
+                    f1 = tf;
+                    g1 = tg;
+                }
+                xa -= xb;
+                f0 -= f1;
+                g0 -= g1;
+            }
+            xa >>= 1;
+            f1 <<= 1;
+            g1 <<= 1;
+        }
 
-    */
+        h_gcd_lin(n, a, b, f0, g0, f1, g1);
+    }
 
+    h_from64(n, b, N, G);
+    free(a);
 }
@@ -0,0 +1,407 @@
+/* bench.c - microbenchmarks of the hot kernels, and of a whole iteration of each engine
+ *
+ * Each benchmark is warmed up, and then the number of calls per sample is doubled until a sample takes at least
+ *   BENCH_MINTIME, and BENCH_SAMPLES samples are taken. The min and median time per call are printed as a line of
+ *   JSON (along with the kernels in use and the limb size, so runs of different builds can be compared), and the
+ *   time per limb, for the ones that have a size in limbs
+ *
+ * The thread is pinned to a single CPU, so it isn't moved (and its caches lost) in the middle of a sample
+ *
+ */
+
+// for 'sched_setaffinity' and 'CPU_SET'
+#define _GNU_SOURCE
+
+#include "MPT-impl.h"
+
+#include <sched.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// the number of samples of each benchmark
+#define BENCH_SAMPLES 11
+
+// the least time (in seconds) that a sample takes, and the time spent warming up
+#define BENCH_MINTIME 0.002
+#define BENCH_WARMUP 0.05
+
+// the default largest size (in limbs) of the kernels, and the default largest exponent of the iterations
+#define BENCH_MAXN 2048
+#define BENCH_MAXP 250000
+
+// the largest exponent of the 'simd0' iterations (which is only meant for small exponents, see 'mpt_simd_t')
+#define BENCH_SIMD_MAXP 10000
+
+// the number of random values that 'mpt_isprime' is timed on
+#define BENCH_NPRIME 1024
+
+// the state of a benchmark
+typedef struct {
+
+    // the size in limbs (or 0), the exponent (or 0), and the bits of the values (or 0)
+    int64_t N, p;
+    int bits;
+
+    // buffers ('C' has 2N limbs, and 'T' is scratch space)
+    mpt_limb_t* A, *B, *C, *T;
+
+    // the engines
+    mpt_ntt_t ntt;
+    mpt_fft_t fft;
+    mpt_r52_t r52;
+    mpt_simd_t simd;
+
+    // the values for 'mpt_isprime'
+    uint64_t* q;
+
+    // the decimal string of 'A' (for the conversions)
+    char* str;
+
+} bench_t;
+
+// a benchmark, which does 'n' calls
+typedef void (*bench_fn)(bench_t* b, int64_t n);
+
+// the exponents for the iterations (the Mersenne prime exponents, so they are all realistic sizes)
+static const int64_t bench_P[] = {
+    521, 1279, 2203, 4423, 9689, 21701, 44497, 86243, 216091, 756839, 1257787, 3021377, 6972593, 0,
+};
+
+
+/* utils */
+
+// return the time (in seconds) from a monotonic clock
+static double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+static int bench_cmp(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// a random 64 bit number
+static uint64_t bench_rand(uint64_t* s) {
+    // splitmix64
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// fill the 'N' limbs of 'A' with random bits
+static void bench_fill(int64_t N, mpt_limb_t* A, uint64_t* s) {
+    int64_t i;
+    for (i = 0; i < N; ++i) A[i] = (mpt_limb_t)bench_rand(s);
+}
+
+// time 'fn' on 'b', and print the result as a line of JSON
+static void bench_run(const char* name, bench_fn fn, bench_t* b) {
+    // warm up (the caches, the branch predictors, and the clock speed)
+    int64_t n = 1;
+    double st = bench_now();
+    while (bench_now() - st < BENCH_WARMUP) {
+        fn(b, n);
+        if (n < ((int64_t)1 << 30)) n *= 2;
+    }
+
+    // the number of calls per sample
+    n = 1;
+    while (true) {
+        st = bench_now();
+        fn(b, n);
+        if (bench_now() - st >= BENCH_MINTIME || n >= ((int64_t)1 << 30)) break;
+        n *= 2;
+    }
+
+    double t[BENCH_SAMPLES];
+    int i;
+    for (i = 0; i < BENCH_SAMPLES; ++i) {
+        st = bench_now();
+        fn(b, n);
+        t[i] = 1.0e9 * (bench_now() - st) / n;
+    }
+    qsort(t, BENCH_SAMPLES, sizeof(*t), bench_cmp);
+
+    printf("{\"bench\": \"%s\", \"kern\": \"%s\", \"limb_bits\": %i", name, mpt_kern.name, (int)MPT_LIMB_BITS);
+    if (b->N > 0) printf(", \"N\": %lli", (long long int)b->N);
+    if (b->p > 0) printf(", \"p\": %lli", (long long int)b->p);
+    if (b->bits > 0) printf(", \"bits\": %i", b->bits);
+    printf(", \"calls\": %lli, \"min_ns\": %.1lf, \"median_ns\": %.1lf", (long long int)n, t[0], t[BENCH_SAMPLES / 2]);
+    if (b->N > 0) printf(", \"ns_per_limb\": %.3lf", t[0] / b->N);
+    printf("}\n");
+    fflush(stdout);
+}
+
+// return whether the benchmark 'name' was picked (with '-b', which is a prefix, or NULL for all of them)
+static bool bench_picked(const char* pick, const char* name) {
+    return pick == NULL || strncmp(name, pick, strlen(pick)) == 0;
+}
+
+
+/* kernels */
+
+static void bench_sqr_naive(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_sqr_naive(b->N, b->A, b->C);
+}
+
+static void bench_sqr_comba(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_sqr_comba(b->N, b->A, b->C);
+}
+
+static void bench_sqr(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_sqr(b->N, b->A, b->C, b->T);
+}
+
+static void bench_mul(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_mul(b->C, b->A, b->N, b->B, b->N, b->T);
+}
+
+static void bench_getdecstr(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_getdecstr(b->A, b->N, b->str);
+}
+
+static void bench_setdecstr(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_setdecstr(b->C, b->N, b->str);
+}
+
+static void bench_add_n(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_add_n(b->N, b->C, b->A, b->B);
+}
+
+static void bench_sub_n(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_sub_n(b->N, b->C, b->A, b->B);
+}
+
+static void bench_subl(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_subl(b->N, b->A, 1);
+}
+
+static void bench_mod2pm1(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_mod2pm1(2 * b->N, b->C, b->B, b->p);
+}
+
+static void bench_isprime(bench_t* b, int64_t n) {
+    int64_t i;
+    int k = 0;
+    for (i = 0; i < n; ++i) {
+        k += mpt_isprime_u64(b->q[i % BENCH_NPRIME]);
+    }
+    // (so it isn't optimized out)
+    if (k < 0) printf("%i\n", k);
+}
+
+// run the kernel benchmarks for each size up to 'maxN' limbs
+static void bench_kernels(const char* pick, int64_t maxN) {
+    uint64_t s = 1;
+    int64_t N;
+    bench_t b;
+    memset(&b, 0, sizeof(b));
+
+    // 1, 2, 3, 4, 6, 8, 12, 16, ... (a power of 2, and then half way to the next)
+    for (N = 1; N <= maxN; N = N < 4 ? N + 1 : ((N & (N - 1)) == 0 ? N + N / 2 : N + N / 3)) {
+        b.N = N;
+        b.p = N * MPT_LIMB_BITS - MPT_LIMB_BITS / 2;
+        b.A = malloc(N * MPT_LIMB_SIZE);
+        b.B = malloc(N * MPT_LIMB_SIZE);
+        b.C = malloc(2 * N * MPT_LIMB_SIZE);
+        b.T = malloc((mpt_mul_scratch(N, N) + 1) * MPT_LIMB_SIZE);
+        b.str = malloc(N * MPT_LIMB_BITS / 3 + 2);
+        bench_fill(N, b.A, &s);
+        bench_fill(N, b.B, &s);
+
+        if (bench_picked(pick, "sqr_naive")) bench_run("sqr_naive", bench_sqr_naive, &b);
+        if (bench_picked(pick, "sqr_comba")) bench_run("sqr_comba", bench_sqr_comba, &b);
+        if (bench_picked(pick, "sqr")) bench_run("sqr", bench_sqr, &b);
+        if (bench_picked(pick, "mul")) bench_run("mul", bench_mul, &b);
+        if (bench_picked(pick, "add_n")) bench_run("add_n", bench_add_n, &b);
+        if (bench_picked(pick, "sub_n")) bench_run("sub_n", bench_sub_n, &b);
+        if (bench_picked(pick, "subl")) bench_run("subl", bench_subl, &b);
+
+        // the reduction of a whole square
+        mpt_sqr_naive(N, b.A, b.C);
+        if (bench_picked(pick, "mod2pm1")) bench_run("mod2pm1", bench_mod2pm1, &b);
+
+        // the decimal conversions, of 'A' (and back)
+        if (bench_picked(pick, "getdecstr")) bench_run("getdecstr", bench_getdecstr, &b);
+        mpt_getdecstr(b.A, N, b.str);
+        if (bench_picked(pick, "setdecstr")) bench_run("setdecstr", bench_setdecstr, &b);
+
+        free(b.str);
+        free(b.A);
+        free(b.B);
+        free(b.C);
+        free(b.T);
+    }
+
+    // 'mpt_isprime' on random (odd) values of each size
+    b.N = b.p = 0;
+    b.q = malloc(BENCH_NPRIME * sizeof(*b.q));
+    for (b.bits = 16; b.bits <= 64; b.bits += 16) {
+        int i;
+        for (i = 0; i < BENCH_NPRIME; ++i) b.q[i] = (bench_rand(&s) >> (64 - b.bits)) | 1;
+        if (bench_picked(pick, "isprime")) bench_run("isprime", bench_isprime, &b);
+    }
+    free(b.q);
+}
+
+
+/* iterations */
+
+static void bench_ll_basic(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_ll_step(b->p, b->A, b->T);
+}
+
+static void bench_ll_ntt(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) {
+        // (the same as 'mpt_T_ntt0')
+        mpt_ntt_sqr(&b->ntt, b->A, b->C);
+        mpt_mod2pm1_c(2 * b->N, b->C, b->A, b->p, 2);
+    }
+}
+
+static void bench_ll_fft(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_fft_sqr(&b->fft, 2);
+}
+
+static void bench_ll_ifma(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_r52_sqr(&b->r52, 2);
+}
+
+// (each call is an iteration of MPT_SIMD_LANES exponents at once)
+static void bench_ll_simd(bench_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) mpt_simd_sqr(&b->simd, 2);
+}
+
+// run a whole LL iteration of each engine, for each exponent up to 'maxp'
+static void bench_iters(const char* pick, int64_t maxp) {
+    bench_t b;
+    memset(&b, 0, sizeof(b));
+
+    int k;
+    for (k = 0; bench_P[k] != 0 && bench_P[k] <= maxp; ++k) {
+        int64_t p = bench_P[k], N = p / MPT_LIMB_BITS + 1;
+        b.N = N;
+        b.p = p;
+        b.A = malloc(2 * N * MPT_LIMB_SIZE);
+        b.C = malloc(2 * N * MPT_LIMB_SIZE);
+        b.T = malloc(mpt_ll_scratch(p) * MPT_LIMB_SIZE);
+
+        // the LL sequence (from 4), so the values are realistic
+        mpt_set_0(b.A, 2 * N);
+        b.A[0] = 4;
+
+        if (bench_picked(pick, "ll_basic")) bench_run("ll_basic", bench_ll_basic, &b);
+
+        if (bench_picked(pick, "ll_ntt")) {
+            mpt_set_0(&b.A[N], N);
+            mpt_ntt_init(&b.ntt, N);
+            bench_run("ll_ntt", bench_ll_ntt, &b);
+            mpt_ntt_free(&b.ntt);
+        }
+
+        if (bench_picked(pick, "ll_fft")) {
+            mpt_fft_init(&b.fft, p, 0);
+            mpt_fft_set(&b.fft, b.A);
+            bench_run("ll_fft", bench_ll_fft, &b);
+            mpt_fft_free(&b.fft);
+        }
+
+        if (bench_picked(pick, "ll_ifma")) {
+            mpt_r52_init(&b.r52, p);
+            mpt_r52_set(&b.r52, b.A);
+            bench_run("ll_ifma", bench_ll_ifma, &b);
+            mpt_r52_free(&b.r52);
+        }
+
+        if (bench_picked(pick, "ll_simd") && p <= BENCH_SIMD_MAXP) {
+            // (every lane has the same exponent)
+            int64_t ps[MPT_SIMD_LANES];
+            int l;
+            for (l = 0; l < MPT_SIMD_LANES; ++l) ps[l] = p;
+            uint64_t* W = mpt_alloc_aligned(mpt_simd_words(mpt_simd_digits(p)) * sizeof(uint64_t));
+            mpt_simd_init(&b.simd, MPT_SIMD_LANES, ps, W, 4);
+            bench_run("ll_simd", bench_ll_simd, &b);
+            free(W);
+        }
+
+        free(b.A);
+        free(b.C);
+        free(b.T);
+    }
+}
+
+
+/* driver */
+
+static void bench_usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-b bench] [-N maxN] [-p maxp] [-c cpu]\n", prog);
+    fprintf(stderr, "  -b bench    only run the benchmarks whose name starts with 'bench' (i.e. 'sqr', 'll_fft')\n");
+    fprintf(stderr, "  -N maxN     the largest size of the kernels, in limbs (default: %i)\n", BENCH_MAXN);
+    fprintf(stderr, "  -p maxp     the largest exponent of the LL iterations (default: %i)\n", BENCH_MAXP);
+    fprintf(stderr, "  -c cpu      the CPU to pin the thread to (default: 0, -1 to not pin it)\n");
+    fprintf(stderr, "Each result is printed as a line of JSON (set 'MPT_KERN' to pick the kernels, like for MPT)\n");
+}
+
+int main(int argc, char** argv) {
+    mpt_time_init();
+    mpt_kern_init(getenv("MPT_KERN"));
+
+    const char* pick = NULL;
+    int64_t maxN = BENCH_MAXN, maxp = BENCH_MAXP;
+    int cpu = 0;
+
+    int i;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            pick = argv[++i];
+        } else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) {
+            maxN = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            maxp = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cpu = (int)strtol(argv[++i], NULL, 10);
+        } else {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // a single thread, on a single CPU
+    #ifdef _OPENMP
+    omp_set_num_threads(1);
+    #endif
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "[MPT_warn]: Couldn't pin the thread to CPU %i\n", cpu);
+        }
+    }
+
+    bench_kernels(pick, maxN);
+    bench_iters(pick, maxp);
+
+    return 0;
+}
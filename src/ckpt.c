@@ -0,0 +1,260 @@
+/* ckpt.c - checkpoints of the Lucas-Lehmer state, so a test can be resumed after it is killed
+ *
+ * The checkpoint for 2^p - 1 is the file 'M<p>.<kind>.ckpt' in 'mpt_ckpt_dir' (where the kind is "ll" or "prp"),
+ *   which holds the term after some number of iterations (as 64 bit words, so it doesn't depend on the limb size, or
+ *   on which engine wrote it), with a header that records the format version, the exponent, the iteration, the
+ *   engine, and a checksum
+ *
+ * The hot loop only copies the term into a snapshot buffer (and only when one is due, see 'mpt_ckpt_interval'),
+ *   and a background thread writes it out. The file is written to 'M<p>.<kind>.ckpt.tmp', synced, and then renamed
+ *   over the old one (and the directory is synced, so the rename is on the disk too), so there is always a
+ *   complete checkpoint on disk, even if the process is killed mid-write, or the machine crashes
+ *
+ */
+
+// for 'fileno' and 'fsync'
+#define _POSIX_C_SOURCE 200809L
+
+#include "MPT-impl.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+
+
+// the magic bytes at the start of each file
+static const char ckpt_magic[8] = { 'M', 'P', 'T', 'C', 'K', 'P', 'T', '\0' };
+
+const char* mpt_ckpt_dir = NULL;
+double mpt_ckpt_interval = MPT_CKPT_INTERVAL;
+
+
+/* file format */
+
+// the header (all integers are little endian, as written by 'ckpt_put')
+//   magic[8], version (u32), engine[16], p (i64), iter (i64), number of words (i64), checksum (u64)
+#define CKPT_ENGINE_LEN 16
+#define CKPT_HEADER_LEN (8 + 4 + CKPT_ENGINE_LEN + 8 + 8 + 8 + 8)
+
+// write 'v' as 'n' little endian bytes
+static void ckpt_put(uint8_t* b, uint64_t v, int n) {
+    int i;
+    for (i = 0; i < n; ++i) b[i] = (uint8_t)(v >> (8 * i));
+}
+
+// read 'n' little endian bytes
+static uint64_t ckpt_get(const uint8_t* b, int n) {
+    uint64_t v = 0;
+    int i;
+    for (i = 0; i < n; ++i) v |= (uint64_t)b[i] << (8 * i);
+    return v;
+}
+
+// return the checksum of a checkpoint (64 bit FNV-1a, over the exponent, the iteration, and each word)
+static uint64_t ckpt_sum(int64_t p, int64_t iter, int64_t n, const uint64_t* W) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    int64_t i;
+    h = (h ^ (uint64_t)p) * 0x100000001b3ULL;
+    h = (h ^ (uint64_t)iter) * 0x100000001b3ULL;
+    for (i = 0; i < n; ++i) h = (h ^ W[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+// write the checkpoint in 'c->snap' (for 'c->iter'), returns whether it was written
+static bool ckpt_write(mpt_ckpt_t* c) {
+    uint8_t hdr[CKPT_HEADER_LEN];
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, ckpt_magic, 8);
+    ckpt_put(&hdr[8], MPT_CKPT_VERSION, 4);
+    strncpy((char*)&hdr[12], c->engine, CKPT_ENGINE_LEN - 1);
+    ckpt_put(&hdr[12 + CKPT_ENGINE_LEN], (uint64_t)c->p, 8);
+    ckpt_put(&hdr[20 + CKPT_ENGINE_LEN], (uint64_t)c->iter, 8);
+    ckpt_put(&hdr[28 + CKPT_ENGINE_LEN], (uint64_t)c->n, 8);
+    ckpt_put(&hdr[36 + CKPT_ENGINE_LEN], ckpt_sum(c->p, c->iter, c->n, c->snap), 8);
+
+    FILE* fp = fopen(c->tmp, "wb");
+    if (fp == NULL) return false;
+
+    bool ok = fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr);
+    int64_t i;
+    uint8_t b[8];
+    for (i = 0; ok && i < c->n; ++i) {
+        ckpt_put(b, c->snap[i], 8);
+        ok = fwrite(b, 1, 8, fp) == 8;
+    }
+
+    // make sure it is on the disk before it replaces the old one
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    ok = ok && rename(c->tmp, c->path) == 0;
+    if (!ok) {
+        remove(c->tmp);
+        return false;
+    }
+
+    // the rename is only in the directory, so that must be synced too, or a crash could still lose it
+    // NOTE: some file systems can't sync a directory, but the checkpoint was still written, so that isn't an error
+    int fd = open(mpt_ckpt_dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+}
+
+
+/* writer thread */
+
+static void* ckpt_thread(void* arg) {
+    mpt_ckpt_t* c = arg;
+
+    pthread_mutex_lock(&c->mx);
+    while (true) {
+        while (!c->busy && !c->quit) pthread_cond_wait(&c->cv, &c->mx);
+        // (a pending snapshot is still written before quitting)
+        if (!c->busy) break;
+        pthread_mutex_unlock(&c->mx);
+
+        if (!ckpt_write(c)) {
+            fprintf(stderr, "[MPT_warn]: Couldn't write checkpoint '%s'\n", c->path);
+        }
+
+        pthread_mutex_lock(&c->mx);
+        c->busy = false;
+    }
+    pthread_mutex_unlock(&c->mx);
+
+    return NULL;
+}
+
+
+/* checkpoints */
+
+bool mpt_ckpt_init(mpt_ckpt_t* c, int64_t p, const char* kind, const char* engine) {
+    c->active = mpt_ckpt_dir != NULL && *mpt_ckpt_dir;
+    if (!c->active) return false;
+
+    c->p = p;
+    c->engine = engine;
+    c->n = ((p / MPT_LIMB_BITS + 1) * MPT_LIMB_BITS + 63) / 64;
+    c->iter = 0;
+    c->interval = mpt_ckpt_interval;
+    c->last = mpt_time();
+
+    size_t len = strlen(mpt_ckpt_dir) + strlen(kind) + 40;
+    c->path = malloc(len);
+    c->tmp = malloc(len + 4);
+    snprintf(c->path, len, "%s/M%lli.%s.ckpt", mpt_ckpt_dir, (long long int)p, kind);
+    snprintf(c->tmp, len + 4, "%s.tmp", c->path);
+
+    c->snap = malloc(c->n * sizeof(*c->snap));
+    c->busy = c->quit = false;
+    pthread_mutex_init(&c->mx, NULL);
+    pthread_cond_init(&c->cv, NULL);
+    if (pthread_create(&c->thr, NULL, ckpt_thread, c) != 0) {
+        fprintf(stderr, "[MPT_warn]: Couldn't start the checkpoint writer, so M%lli won't be checkpointed\n", (long long int)p);
+        pthread_mutex_destroy(&c->mx);
+        pthread_cond_destroy(&c->cv);
+        free(c->snap);
+        free(c->path);
+        free(c->tmp);
+        c->active = false;
+    }
+
+    return c->active;
+}
+
+int64_t mpt_ckpt_load(mpt_ckpt_t* c, mpt_limb_t* S) {
+    if (!c->active) return 0;
+
+    FILE* fp = fopen(c->path, "rb");
+    if (fp == NULL) return 0;
+
+    int64_t res = 0;
+    uint8_t hdr[CKPT_HEADER_LEN];
+    uint64_t* W = NULL;
+    const char* why = NULL;
+
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) || memcmp(hdr, ckpt_magic, 8) != 0) {
+        why = "not a checkpoint";
+    } else if (ckpt_get(&hdr[8], 4) != MPT_CKPT_VERSION) {
+        why = "unknown version";
+    } else if ((int64_t)ckpt_get(&hdr[12 + CKPT_ENGINE_LEN], 8) != c->p) {
+        why = "wrong exponent";
+    } else if ((int64_t)ckpt_get(&hdr[28 + CKPT_ENGINE_LEN], 8) != c->n) {
+        why = "wrong size";
+    } else {
+        int64_t iter = (int64_t)ckpt_get(&hdr[20 + CKPT_ENGINE_LEN], 8), i;
+        W = malloc(c->n * sizeof(*W));
+        uint8_t b[8];
+        bool ok = true;
+        for (i = 0; ok && i < c->n; ++i) {
+            ok = fread(b, 1, 8, fp) == 8;
+            W[i] = ckpt_get(b, 8);
+        }
+
+        if (!ok || ckpt_sum(c->p, iter, c->n, W) != ckpt_get(&hdr[36 + CKPT_ENGINE_LEN], 8)) {
+            why = "bad checksum";
+        } else if (iter < 0 || iter > c->p) {
+            why = "bad iteration";
+        } else {
+            // the term, from the 64 bit words
+            int64_t N = c->p / MPT_LIMB_BITS + 1;
+            for (i = 0; i < N; ++i) {
+                S[i] = (mpt_limb_t)(W[i * MPT_LIMB_BITS / 64] >> (i * MPT_LIMB_BITS % 64));
+            }
+
+            char eng[CKPT_ENGINE_LEN];
+            memcpy(eng, &hdr[12], CKPT_ENGINE_LEN);
+            eng[CKPT_ENGINE_LEN - 1] = '\0';
+            fprintf(stderr, "[MPT_info]: Resuming M%lli at iteration %lli (from '%s', written by %s)\n", (long long int)c->p, (long long int)iter, c->path, eng);
+            res = iter;
+        }
+    }
+
+    if (why != NULL) fprintf(stderr, "[MPT_warn]: Ignoring checkpoint '%s' (%s)\n", c->path, why);
+
+    free(W);
+    fclose(fp);
+    return res;
+}
+
+bool mpt_ckpt_due(mpt_ckpt_t* c) {
+    return c->active && mpt_time() - c->last >= c->interval;
+}
+
+void mpt_ckpt_save(mpt_ckpt_t* c, mpt_limb_t* S, int64_t iter) {
+    if (!c->active) return;
+    c->last = mpt_time();
+
+    // if the last one is still being written, skip this one (instead of waiting on it)
+    pthread_mutex_lock(&c->mx);
+    if (!c->busy) {
+        int64_t N = c->p / MPT_LIMB_BITS + 1, i;
+        memset(c->snap, 0, c->n * sizeof(*c->snap));
+        for (i = 0; i < N; ++i) c->snap[i * MPT_LIMB_BITS / 64] |= (uint64_t)S[i] << (i * MPT_LIMB_BITS % 64);
+        c->iter = iter;
+        c->busy = true;
+        pthread_cond_signal(&c->cv);
+    }
+    pthread_mutex_unlock(&c->mx);
+}
+
+void mpt_ckpt_free(mpt_ckpt_t* c, bool done) {
+    if (!c->active) return;
+
+    pthread_mutex_lock(&c->mx);
+    c->quit = true;
+    pthread_cond_signal(&c->cv);
+    pthread_mutex_unlock(&c->mx);
+    pthread_join(c->thr, NULL);
+
+    // a finished test doesn't need its checkpoint anymore
+    if (done) remove(c->path);
+
+    pthread_mutex_destroy(&c->mx);
+    pthread_cond_destroy(&c->cv);
+    free(c->snap);
+    free(c->path);
+    free(c->tmp);
+    c->active = false;
+}
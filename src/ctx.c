@@ -0,0 +1,142 @@
+/* ctx.c - test contexts, which keep the workspace and the transform plans between tests
+ *
+ * In a batch of many small exponents, setting up each test (allocating its buffers, and computing the roots of
+ *   unity for its transform) can take as long as the test itself, and many threads allocating and freeing buffers
+ *   of different sizes fragments the heap. So, each thread keeps a context, and each test takes its buffers from
+ *   the context's arena (which is just bumped, and reset before the next test), and its plan from the context
+ *   (which is only set up again if the next exponent needs a different transform length)
+ *
+ */
+
+#include "MPT-impl.h"
+
+
+/* arena */
+
+// the start of each block holds the pointer to the block before it (in a whole cache line, to keep the alignment)
+#define CTX_HDR MPT_ALIGN
+
+void mpt_arena_init(mpt_arena_t* ar) {
+    ar->base = NULL;
+    ar->size = ar->used = ar->total = 0;
+}
+
+// free all of the blocks of 'ar'
+static void ctx_arena_release(mpt_arena_t* ar) {
+    while (ar->base != NULL) {
+        char* prev = *(char**)ar->base;
+        free(ar->base);
+        ar->base = prev;
+    }
+    ar->size = ar->used = ar->total = 0;
+}
+
+// start a new block of 'ar', of at least 'sz' bytes (after the header)
+static void ctx_arena_grow(mpt_arena_t* ar, size_t sz) {
+    size_t bsz = 2 * ar->size;
+    if (bsz < sz + CTX_HDR) bsz = sz + CTX_HDR;
+    if (bsz < MPT_ARENA_MIN) bsz = MPT_ARENA_MIN;
+
+    char* blk = mpt_alloc_aligned(bsz);
+    if (blk == NULL) {
+        fprintf(stderr, "[MPT_error]: Couldn't allocate %llu bytes of workspace\n", (unsigned long long int)bsz);
+        exit(1);
+    }
+    *(char**)blk = ar->base;
+    ar->base = blk;
+    ar->size = bsz;
+    ar->used = CTX_HDR;
+    ar->total += bsz;
+}
+
+void mpt_arena_free(mpt_arena_t* ar) {
+    ctx_arena_release(ar);
+}
+
+void* mpt_arena_alloc(mpt_arena_t* ar, size_t sz) {
+    sz = (sz + MPT_ALIGN - 1) / MPT_ALIGN * MPT_ALIGN;
+    if (ar->base == NULL || ar->used + sz > ar->size) ctx_arena_grow(ar, sz);
+
+    void* res = ar->base + ar->used;
+    ar->used += sz;
+    return res;
+}
+
+void mpt_arena_reset(mpt_arena_t* ar) {
+    // if it took more than 1 block, replace them with a single one that holds all of them
+    if (ar->base != NULL && *(char**)ar->base != NULL) {
+        size_t total = ar->total;
+        ctx_arena_release(ar);
+        ctx_arena_grow(ar, total);
+    }
+    ar->used = CTX_HDR;
+}
+
+
+/* contexts */
+
+void mpt_ctx_init(mpt_ctx_t* ctx) {
+    mpt_arena_init(&ctx->ar);
+    ctx->has_ntt = ctx->has_fft = ctx->has_r52 = false;
+}
+
+void mpt_ctx_free(mpt_ctx_t* ctx) {
+    mpt_arena_free(&ctx->ar);
+    if (ctx->has_ntt) mpt_ntt_free(&ctx->ntt);
+    if (ctx->has_fft) mpt_fft_free(&ctx->fft);
+    if (ctx->has_r52) mpt_r52_free(&ctx->r52);
+    ctx->has_ntt = ctx->has_fft = ctx->has_r52 = false;
+}
+
+void mpt_ctx_begin(mpt_ctx_t* ctx) {
+    mpt_arena_reset(&ctx->ar);
+}
+
+mpt_limb_t* mpt_ctx_limbs(mpt_ctx_t* ctx, int64_t N) {
+    return mpt_arena_alloc(&ctx->ar, N * MPT_LIMB_SIZE);
+}
+
+mpt_ntt_t* mpt_ctx_ntt(mpt_ctx_t* ctx, int64_t N) {
+    // the roots only depend on the transform length
+    int64_t L = 1;
+    while (L < 2 * N) L *= 2;
+
+    if (ctx->has_ntt && ctx->ntt.L == L) {
+        ctx->ntt.N = N;
+    } else {
+        if (ctx->has_ntt) mpt_ntt_free(&ctx->ntt);
+        mpt_ntt_init(&ctx->ntt, N);
+        ctx->has_ntt = true;
+    }
+    return &ctx->ntt;
+}
+
+mpt_fft_t* mpt_ctx_fft(mpt_ctx_t* ctx, int64_t p, int64_t n) {
+    // the roots only depend on the number of digits (and the threads, for the four-step transform)
+    n = mpt_fft_length(p, n);
+    int nthr = mpt_sqr_threads > 1 ? mpt_sqr_threads : 1;
+
+    if (ctx->has_fft && ctx->fft.n == n && ctx->fft.nthr == nthr) {
+        mpt_fft_reinit(&ctx->fft, p);
+    } else {
+        if (ctx->has_fft) mpt_fft_free(&ctx->fft);
+        mpt_fft_init(&ctx->fft, p, n);
+        ctx->has_fft = true;
+    }
+    return &ctx->fft;
+}
+
+mpt_r52_t* mpt_ctx_r52(mpt_ctx_t* ctx, int64_t p) {
+    // the buffers only depend on the number of digits
+    int64_t n = (p + MPT_R52_BITS - 1) / MPT_R52_BITS;
+
+    if (ctx->has_r52 && ctx->r52.n == n) {
+        ctx->r52.p = p;
+        ctx->r52.t = p - MPT_R52_BITS * (n - 1);
+    } else {
+        if (ctx->has_r52) mpt_r52_free(&ctx->r52);
+        mpt_r52_init(&ctx->r52, p);
+        ctx->has_r52 = true;
+    }
+    return &ctx->r52;
+}
@@ -0,0 +1,388 @@
+/* engine.c - the engines, which test 2^p - 1 (see 'mpt_engine_t')
+ *
+ * They are in the library (rather than in 'src/MPT.c', the batch driver), so the tests can run them
+ *
+ */
+
+#include "MPT-impl.h"
+
+
+// test 2^p - 1
+// This method uses Lucas-Lehmer test (LL) and the Number Theoretic Transform (NTT) to do the squaring at each step,
+//   and some modular division tricks for 'mod Mp'
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_ntt0(mpt_ctx_t* ctx, int64_t p) {
+    // special case
+    if (p == 2) return true;
+
+    // p must be prime
+    if (!mpt_isprime(p)) return false;
+
+    // number of limbs in the main sequence
+    int64_t N = p / MPT_LIMB_BITS + 1;
+
+    // 'S_i' is the current term, and 'S_it' holds the (unreduced) square
+    mpt_ctx_begin(ctx);
+    mpt_limb_t* S_i = mpt_ctx_limbs(ctx, 2 * N);
+    mpt_limb_t* S_it = mpt_ctx_limbs(ctx, 2 * N);
+
+    // set S_i = 4 to begin (or resume from a checkpoint)
+    mpt_set_0(S_i, 2 * N);
+    S_i[0] = 4;
+    mpt_ckpt_t ck;
+    mpt_ckpt_init(&ck, p, "ll", "ntt0");
+    int64_t i0 = mpt_ckpt_load(&ck, S_i);
+
+    // the roots of unity are only computed once, for the whole test (or reused from the last one)
+    mpt_ntt_t* ntt = mpt_ctx_ntt(ctx, N);
+
+    mpt_prog_t pr;
+    mpt_prog_init(&pr, p, p - 2, "ntt0", i0);
+
+    int64_t i;
+    for (i = i0; i < p - 2; ++i) {
+        // S_i <- S_i ^ 2 - 2 (mod Mp)
+        // (the 2 is subtracted by the reduction, as it folds the square, see 'mpt_mod2pm1_c')
+        MPT_PROG_PHASE(&pr, MPT_PHASE_SQR, mpt_ntt_sqr(ntt, S_i, S_it));
+        MPT_PROG_PHASE(&pr, MPT_PHASE_RED, mpt_mod2pm1_c(2 * N, S_it, S_i, p, 2));
+
+        if (mpt_ckpt_due(&ck)) mpt_ckpt_save(&ck, S_i, i + 1);
+        if (mpt_prog_due(&pr, i + 1)) mpt_prog_report(&pr, i + 1, S_i);
+    }
+    mpt_ckpt_free(&ck, true);
+    mpt_prog_free(&pr, i);
+
+    bool hasNZ = false;
+
+    // ensure all are zero
+    for (i = 0; i < N; ++i) {
+        if (S_i[i] != 0) {
+            hasNZ  = true;
+            break;
+        }
+    }
+
+    return !hasNZ;
+}
+
+
+// test 2^p - 1
+// This method uses Lucas-Lehmer test (LL) and the IBDWT (Irrational Base Discrete Weighted Transform), which
+//   does the squaring with a floating point FFT, and the 'mod Mp' implicitly (so there is no double width square)
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_fft0(mpt_ctx_t* ctx, int64_t p) {
+    // special case
+    if (p == 2) return true;
+
+    // p must be prime
+    if (!mpt_isprime(p)) return false;
+
+    // number of limbs in the main sequence
+    int64_t N = p / MPT_LIMB_BITS + 1;
+
+    mpt_ctx_begin(ctx);
+    mpt_limb_t* S_i = mpt_ctx_limbs(ctx, N);
+
+    // transform length (0 means automatic)
+    int64_t n = 0;
+
+    mpt_fft_t* fft;
+    mpt_ckpt_t ck;
+    mpt_ckpt_init(&ck, p, "ll", "fft0");
+    mpt_prog_t pr;
+    mpt_prog_init(&pr, p, p - 2, "fft0", 0);
+
+    while (true) {
+        fft = mpt_ctx_fft(ctx, p, n);
+
+        // set S_i = 4 to begin (or resume from a checkpoint, which is also where a retry starts from)
+        mpt_set_0(S_i, N);
+        S_i[0] = 4;
+        int64_t i0 = mpt_ckpt_load(&ck, S_i);
+        mpt_fft_set(fft, S_i);
+        mpt_prog_start(&pr, i0);
+
+        int64_t i;
+        for (i = i0; i < p - 2; ++i) {
+            // S_i <- S_i ^ 2 - 2 (mod Mp)
+            double err;
+            MPT_PROG_PHASE(&pr, MPT_PHASE_SQR, err = mpt_fft_sqr(fft, 2));
+            if (err > MPT_FFT_MAXERR) break;
+
+            if (mpt_ckpt_due(&ck)) {
+                mpt_fft_get(fft, S_i);
+                mpt_ckpt_save(&ck, S_i, i + 1);
+            }
+            if (mpt_prog_due(&pr, i + 1)) {
+                mpt_fft_get(fft, S_i);
+                mpt_prog_report(&pr, i + 1, S_i);
+            }
+        }
+
+        if (i == p - 2) break;
+
+        // the roundoff error was too large, so restart with a larger transform
+        fprintf(stderr, "[MPT_warn]: Roundoff error of %lf in M%lli (with %lli digits), retrying with more digits\n", fft->maxerr, (long long int)p, (long long int)fft->n);
+        n = 2 * fft->n;
+    }
+
+    mpt_ckpt_free(&ck, true);
+    mpt_prog_free(&pr, p - 2);
+    mpt_fft_get(fft, S_i);
+
+    bool hasNZ = false;
+
+    // ensure all are zero
+    int64_t i;
+    for (i = 0; i < N; ++i) {
+        if (S_i[i] != 0) {
+            hasNZ  = true;
+            break;
+        }
+    }
+
+    return !hasNZ;
+}
+
+// test 2^p - 1
+// This method uses Lucas-Lehmer test (LL), with redundant 52 bit digits, which are squared with AVX-512 IFMA
+//   (if the CPU has it), and the carries are only resolved once per iteration
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_ifma0(mpt_ctx_t* ctx, int64_t p) {
+    // special case
+    if (p == 2) return true;
+
+    // p must be prime
+    if (!mpt_isprime(p)) return false;
+
+    // number of limbs in the main sequence
+    int64_t N = p / MPT_LIMB_BITS + 1;
+
+    mpt_ctx_begin(ctx);
+    mpt_limb_t* S_i = mpt_ctx_limbs(ctx, N);
+    mpt_r52_t* r = mpt_ctx_r52(ctx, p);
+
+    // set S_i = 4 to begin (or resume from a checkpoint)
+    mpt_set_0(S_i, N);
+    S_i[0] = 4;
+    mpt_ckpt_t ck;
+    mpt_ckpt_init(&ck, p, "ll", "ifma0");
+    int64_t i0 = mpt_ckpt_load(&ck, S_i);
+    mpt_r52_set(r, S_i);
+    mpt_prog_t pr;
+    mpt_prog_init(&pr, p, p - 2, "ifma0", i0);
+
+    int64_t i;
+    for (i = i0; i < p - 2; ++i) {
+        // S_i <- S_i ^ 2 - 2 (mod Mp)
+        MPT_PROG_PHASE(&pr, MPT_PHASE_SQR, mpt_r52_sqr(r, 2));
+
+        if (mpt_ckpt_due(&ck)) {
+            mpt_r52_get(r, S_i);
+            mpt_ckpt_save(&ck, S_i, i + 1);
+        }
+        if (mpt_prog_due(&pr, i + 1)) {
+            mpt_r52_get(r, S_i);
+            mpt_prog_report(&pr, i + 1, S_i);
+        }
+    }
+    mpt_ckpt_free(&ck, true);
+    mpt_prog_free(&pr, i);
+
+    mpt_r52_get(r, S_i);
+
+    bool hasNZ = false;
+
+    // ensure all are zero
+    for (i = 0; i < N; ++i) {
+        if (S_i[i] != 0) {
+            hasNZ  = true;
+            break;
+        }
+    }
+
+    return !hasNZ;
+}
+
+// test 2^p - 1
+// This method uses Lucas-Lehmer test (LL), with the squaring done directly on the limbs (see 'mpt_sqr'), and
+//   each step fused into 'mpt_ll_step', so the only state is the current term (and the scratch space)
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_basic0(mpt_ctx_t* ctx, int64_t p) {
+    // special case
+    if (p == 2) return true;
+    
+    // p must be prime
+    if (!mpt_isprime(p)) return false;
+
+    // number of limbs in the main sequence
+    int64_t N = p / MPT_LIMB_BITS + 1;
+
+    // 'S_i', the current term in the sequence, and the scratch space for each step (for the whole test)
+    mpt_ctx_begin(ctx);
+    mpt_limb_t* S_i = mpt_ctx_limbs(ctx, N);
+    mpt_limb_t* T = mpt_ctx_limbs(ctx, mpt_ll_scratch(p));
+
+    // set S_i = 4 to begin (or resume from a checkpoint)
+    mpt_set_0(S_i, N);
+    S_i[0] = 4;
+    mpt_ckpt_t ck;
+    mpt_ckpt_init(&ck, p, "ll", "basic0");
+    int64_t i0 = mpt_ckpt_load(&ck, S_i);
+    mpt_prog_t pr;
+    mpt_prog_init(&pr, p, p - 2, "basic0", i0);
+
+    // only allocate if its a trace build
+    #ifdef MPT_TRACE_TERMS
+        char* tmp = malloc(N * MPT_HDPL + 4);
+
+        mpt_limb_t* Mp = mpt_alloc_bits(N * MPT_LIMB_BITS);
+        mpt_set_Mp(Mp, p);
+        mpt_gethexstr(Mp, N, tmp);
+        printf("M%i: 0x%s\n", (int)p, tmp);
+        free(Mp);
+    #endif
+
+
+    // current trial (beginning at 0)
+    int64_t i;
+    for (i = i0; i < p - 2; ++i) {
+
+        #ifdef MPT_TRACE_TERMS
+            mpt_gethexstr(S_i, N, tmp);
+            printf("S%i: 0x%s\n", (int)i, tmp);
+        #endif
+
+        // calculate the next term in the sequence:
+        // S_i <- S_i ^ 2 - 2 (mod Mp)
+        if (pr.cycles) mpt_sqr_mod_timed(p, S_i, 2, T, pr.cyc);
+        else mpt_ll_step(p, S_i, T);
+
+        if (mpt_ckpt_due(&ck)) mpt_ckpt_save(&ck, S_i, i + 1);
+        if (mpt_prog_due(&pr, i + 1)) mpt_prog_report(&pr, i + 1, S_i);
+    }
+    mpt_ckpt_free(&ck, true);
+    mpt_prog_free(&pr, i);
+
+    #ifdef MPT_TRACE_TERMS
+        mpt_gethexstr(S_i, N, tmp);
+        printf("S(final): 0x%s\n", tmp);
+    #endif
+
+
+    bool hasNZ = false;
+
+    // ensure all are zero
+    for (i = 0; i < N; ++i) {
+        if (S_i[i] != 0) {
+            hasNZ  = true;
+            break;
+        }
+    }
+
+    #ifdef MPT_TRACE_TERMS
+    free(tmp);
+    #endif
+
+    // all were, thus it is prime
+    return !hasNZ;
+
+}
+
+// test 2^p - 1
+// This method uses Lucas-Lehmer test (LL), with the squaring done on 28 bit digits, in one lane of a vector for
+//   each exponent (see 'mpt_simd_sqr'), so up to MPT_SIMD_LANES exponents are tested at once (see
+//   'mpt_T_simd0_n', which the batch driver uses). On its own, only one lane is used
+// NOTE: there are no checkpoints or progress lines, since it is only meant for small exponents
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_simd0(mpt_ctx_t* ctx, int64_t p) {
+    bool res;
+    mpt_T_simd0_n(ctx, 1, &p, &res);
+    return res;
+}
+
+void mpt_T_simd0_n(mpt_ctx_t* ctx, int n, const int64_t* p, bool* res) {
+    // the special cases are decided right away, and the rest go in the lanes
+    int64_t q[MPT_SIMD_LANES], end = 0;
+    int idx[MPT_SIMD_LANES], m = 0, l;
+    for (l = 0; l < n; ++l) {
+        res[l] = p[l] == 2;
+        if (p[l] == 2 || !mpt_isprime(p[l])) continue;
+        idx[m] = l;
+        q[m++] = p[l];
+        if (p[l] - 2 > end) end = p[l] - 2;
+    }
+    if (m == 0) return;
+
+    mpt_ctx_begin(ctx);
+    mpt_simd_t s;
+    uint64_t* W = mpt_arena_alloc(&ctx->ar, mpt_simd_words(mpt_simd_digits(end + 2)) * sizeof(uint64_t));
+
+    // set S_i = 4 to begin (in every lane)
+    mpt_simd_init(&s, m, q, W, 4);
+
+    // each lane is done after 'p - 2' iterations, so its result is taken then (and it just keeps going after that)
+    int64_t i;
+    for (i = 0; i < end; ++i) {
+        // S_i <- S_i ^ 2 - 2 (mod Mp)
+        mpt_simd_sqr(&s, 2);
+
+        for (l = 0; l < m; ++l) {
+            if (q[l] - 2 == i + 1) res[idx[l]] = mpt_simd_iszero(&s, l);
+        }
+    }
+}
+
+// test 2^p - 1
+// This method uses the base 3 Fermat PRP test, with Gerbicz-Li error checking (see 'mpt_prp'), instead of the LL
+//   test, so an error in the hardware is caught (and redone) instead of silently giving the wrong answer
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_prp0(mpt_ctx_t* ctx, int64_t p) {
+    mpt_prp_t prp;
+    mpt_prp(&prp, p, ctx);
+    if (prp.nerrors > 0) {
+        fprintf(stderr, "[MPT_warn]: The PRP test of M%lli recovered from %lli errors (in %lli checks)\n", (long long int)p, (long long int)prp.nerrors, (long long int)prp.nchecks);
+    }
+    return prp.prp;
+}
+
+// test 2^p - 1
+// This method picks the engine for the size of 'p' (see 'mpt_engine_auto')
+// ASSUMPTIONS:
+//   'p' is prime
+bool mpt_T_auto(mpt_ctx_t* ctx, int64_t p) {
+    return mpt_engine_auto(p)->test(ctx, p);
+}
+
+// all of the engines (see 'mpt_engine_t')
+const mpt_engine_t mpt_engines[] = {
+    { "auto", mpt_T_auto, 1, NULL },
+    { "basic0", mpt_T_basic0, 1, NULL },
+    { "ntt0", mpt_T_ntt0, 1, NULL },
+    { "fft0", mpt_T_fft0, 1, NULL },
+    { "ifma0", mpt_T_ifma0, 1, NULL },
+    { "prp0", mpt_T_prp0, 1, NULL },
+    { "simd0", mpt_T_simd0, MPT_SIMD_LANES, mpt_T_simd0_n },
+    { NULL, NULL, 0, NULL },
+};
+
+const mpt_engine_t* mpt_engine_find(const char* name) {
+    int i;
+    for (i = 0; mpt_engines[i].name != NULL; ++i) {
+        if (strcmp(name, mpt_engines[i].name) == 0) return &mpt_engines[i];
+    }
+    return NULL;
+}
+
+const mpt_engine_t* mpt_engine_auto(int64_t p) {
+    // (the same check as 'mpt_r52_init', since without IFMA, 'ifma0' is no faster than 'basic0')
+    bool ifma = (mpt_cpu_features() & MPT_CPU_AVX512IFMA) && (mpt_kern.req & MPT_CPU_AVX512F);
+    if (p < (ifma ? MPT_AUTO_IFMA_P : MPT_AUTO_BASIC_P)) return mpt_engine_find(ifma ? "ifma0" : "basic0");
+    return mpt_engine_find("fft0");
+}
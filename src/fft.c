@@ -0,0 +1,587 @@
+/* fft.c - IBDWT (Irrational Base Discrete Weighted Transform) squaring (mod 2^p - 1)
+ *
+ * The number is split into 'n' digits, where digit 'j' starts at bit ceil(p*j/n), so each digit has
+ *   either floor(p/n) or ceil(p/n) bits. Multiplying digit 'j' by the weight 2^(ceil(p*j/n) - p*j/n) turns
+ *   multiplication (mod 2^p - 1) into a plain cyclic convolution, which is done with a real FFT.
+ *
+ * The real FFT of length 'n' is done with a complex FFT of length 'n/2' on the even/odd digits,
+ *   and the digits are kept balanced (i.e. they may be negative), which keeps the roundoff error small
+ *
+ * For long transforms (see MPT_FFT_4STEP_THRESH), a single pass over the whole array misses the cache (and the
+ *   TLB) at every level, so the complex transform of length m == n1 * n2 is done in four steps instead, on the
+ *   array as 'n2' rows of 'n1':
+ *   1. a transform of length 'n2' down each column (a few columns at a time, copied into a small buffer)
+ *   2. multiply entry (k2, j1) by exp(-2*pi*i*j1*k2/m)
+ *   3. a transform of length 'n1' along each row
+ *   which leaves entry 'k2 + n2*k1' of the result in row 'k2', column 'k1' (transposed), and the squaring is
+ *   done there, and the inverse does the steps backwards (so it ends up in the natural order again). Each of
+ *   those fits in the cache, and the weighting, and the rounding, are done as the columns are loaded and stored.
+ *   The passes (and the carries) are split over 'mpt_sqr_threads' threads, always with the same rows for each
+ *   thread, and each thread touches its rows first (in 'mpt_fft_init'), so they are in its own NUMA node's memory
+ *
+ */
+
+#include "MPT-impl.h"
+
+#include <omp.h>
+#include <math.h>
+#include <complex.h>
+
+typedef double complex cplx;
+
+// M_PI is not in strict C99
+static const double fft_pi = 3.14159265358979323846;
+
+// return the maximum (average) number of bits per digit which is safe for a transform of length 2^lgn
+// NOTE: the products of 2 digits need 2*b bits, and the sum of 'n' of them (with balanced digits) grows like sqrt(n),
+//   and there must be a few bits left over in the 53 bit mantissa for the roundoff error
+static double fft_maxbits(int lgn) {
+    return (53.0 - 5.0 - 0.6 * lgn) / 2.0;
+}
+
+// return the starting bit of digit 'j'
+static int64_t fft_pos(mpt_fft_t* fft, int64_t j) {
+    return (fft->p * j + fft->n - 1) / fft->n;
+}
+
+
+/* transform */
+
+// complex transform of length 'm' (in place, with bit reversed input and natural output)
+// If 'inv', then the conjugate roots are used (and the result is not scaled)
+static void fft_dit(int64_t m, cplx* X, const cplx* tw, bool inv) {
+    int64_t len, s, j;
+    for (len = 1; len < m; len *= 2) {
+        const cplx* R = &tw[len];
+        for (s = 0; s < m; s += 2 * len) {
+            cplx* U = &X[s], *V = &X[s + len];
+            for (j = 0; j < len; ++j) {
+                cplx w = inv ? conj(R[j]) : R[j];
+                cplx u = U[j], v = V[j] * w;
+                U[j] = u + v;
+                V[j] = u - v;
+            }
+        }
+    }
+}
+
+// given the complex transform 'Ck' and 'Cj' (where j == m - k), of the even/odd packed real sequence,
+//   return the entry 'k' of the complex transform of the even/odd packed square of that sequence
+// 'w' is exp(-2*pi*i*k/n)
+static cplx fft_sqr_k(cplx Ck, cplx Cj, cplx w) {
+    // transforms of the even and odd entries
+    cplx E = 0.5 * (Ck + conj(Cj));
+    cplx O = -0.5 * I * (Ck - conj(Cj));
+
+    // entries 'k' and 'k+m' of the real transform, squared
+    cplx Y0 = E + w * O, Y1 = E - w * O;
+    Y0 *= Y0;
+    Y1 *= Y1;
+
+    // back to the even/odd transforms
+    return 0.5 * (Y0 + Y1) + 0.5 * I * (Y0 - Y1) * conj(w);
+}
+
+
+/* carrying */
+
+// propagate carries (with an initial carry in of 'c') through all the digits, which are stored as integers in 'v'
+// If 'bal', the digits are balanced, otherwise, they are made non-negative
+static void fft_carry(mpt_fft_t* fft, int64_t* v, int64_t c, bool bal) {
+    int64_t n = fft->n, j;
+
+    for (j = 0; c != 0 || j < n; ++j) {
+        // the top carry has weight 2^p, which is equal to 1 (mod 2^p - 1), so it wraps around to the bottom
+        int64_t k = j % n;
+        int b = fft->b[k];
+
+        int64_t t = v[k] + c;
+        int64_t d = t & ((1LL << b) - 1);
+        if (bal && d >= (1LL << (b - 1))) d -= 1LL << b;
+
+        v[k] = d;
+        c = (t - d) >> b;
+    }
+}
+
+
+// propagate carries (with a carry in of 'c') through the digits 'j0' to 'j1' (exclusive), which are stored as
+//   integers in 'v', and balance them, and return the carry out of the top one
+static int64_t fft_carry_part(mpt_fft_t* fft, int64_t* v, int64_t j0, int64_t j1, int64_t c) {
+    int64_t j;
+    for (j = j0; j < j1; ++j) {
+        int b = fft->b[j];
+        int64_t t = v[j] + c;
+        int64_t d = t & ((1LL << b) - 1);
+        if (d >= (1LL << (b - 1))) d -= 1LL << b;
+
+        v[j] = d;
+        c = (t - d) >> b;
+    }
+    return c;
+}
+
+
+/* plan */
+
+// set 'rev' to the bit reversal permutation of length 'm' (a power of 2)
+static void fft_bitrev(int64_t m, int64_t* rev) {
+    int lgm = 0;
+    int64_t j, k;
+    while ((1LL << lgm) < m) lgm++;
+    for (k = 0; k < m; ++k) {
+        int64_t r = 0;
+        for (j = 0; j < lgm; ++j) if (k & (1LL << j)) r |= 1LL << (lgm - 1 - j);
+        rev[k] = r;
+    }
+}
+
+int64_t mpt_fft_length(int64_t p, int64_t n) {
+    if (n <= 0) {
+        // smallest power of 2 which doesn't have too many bits per digit
+        int lgn = 1;
+        while ((double)p / (1LL << lgn) > fft_maxbits(lgn)) lgn++;
+        n = 1LL << lgn;
+    }
+
+    // every digit needs at least 1 bit
+    while (n > 2 && n > p) n /= 2;
+    return n;
+}
+
+// set the length of 'fft' to 'n' digits, and the layout of the four-step transform (which is 'n2' rows of 'n1',
+//   where the rows are the longer ones, since they are contiguous), or n1 == 0 if it isn't used
+static void fft_layout(mpt_fft_t* fft, int64_t n) {
+    int64_t m = n / 2;
+    fft->n = n;
+    fft->n1 = fft->n2 = 0;
+    fft->lg1 = fft->lg2 = 0;
+    fft->rev1 = fft->rev2 = fft->rev = NULL;
+    fft->tl = fft->th = fft->ra = fft->rb = fft->rw = NULL;
+    if (m >= MPT_FFT_4STEP_THRESH) {
+        while ((1LL << (2 * fft->lg2 + 2)) <= m) fft->lg2++;
+        fft->n2 = 1LL << fft->lg2;
+        fft->n1 = m / fft->n2;
+        while ((1LL << fft->lg1) < fft->n1) fft->lg1++;
+    }
+}
+
+// return the next table (of 'sz' bytes) from 'data' (or NULL, if it is NULL), at 'off', and move 'off' past it
+static const void* fft_tab(const char* data, size_t* off, size_t sz) {
+    const void* res = data == NULL ? NULL : data + *off;
+    *off += (sz + MPT_ALIGN - 1) / MPT_ALIGN * MPT_ALIGN;
+    return res;
+}
+
+// point the roots and permutations of 'fft' (after 'fft_layout') into 'data', and return the size of all of them
+static size_t fft_tabs(mpt_fft_t* fft, const char* data) {
+    int64_t m = fft->n / 2, n1 = fft->n1, n2 = fft->n2;
+    size_t off = 0;
+
+    // (the roots for the complex transforms only go up to the longest one)
+    fft->tw = fft_tab(data, &off, sizeof(cplx) * (n1 > 0 ? n1 : m));
+    if (n1 > 0) {
+        fft->tl = fft_tab(data, &off, sizeof(cplx) * n1);
+        fft->th = fft_tab(data, &off, sizeof(cplx) * n2);
+        fft->ra = fft_tab(data, &off, sizeof(cplx) * n2);
+        fft->rb = fft_tab(data, &off, sizeof(cplx) * n1);
+        fft->rev1 = fft_tab(data, &off, sizeof(int64_t) * n1);
+        fft->rev2 = fft_tab(data, &off, sizeof(int64_t) * n2);
+    } else {
+        fft->rw = fft_tab(data, &off, sizeof(cplx) * m);
+        fft->rev = fft_tab(data, &off, sizeof(int64_t) * m);
+    }
+    return off;
+}
+
+// fill 'data' with the roots and permutations for 'n' digits (see 'fft_tabs')
+static void fft_fill(void* data, int64_t n) {
+    mpt_fft_t f;
+    fft_layout(&f, n);
+    fft_tabs(&f, data);
+
+    int64_t m = n / 2, n1 = f.n1, n2 = f.n2, mt = n1 > 0 ? n1 : m, j, k, len;
+    cplx* tw = (cplx*)f.tw;
+
+    // compute the roots directly (instead of with a recurrence), to keep them accurate
+    tw[0] = 0.0;
+    for (len = 1; len < mt; len *= 2) {
+        for (j = 0; j < len; ++j) {
+            double t = -fft_pi * j / len;
+            tw[len + j] = cos(t) + I * sin(t);
+        }
+    }
+
+    if (n1 > 0) {
+        cplx* tl = (cplx*)f.tl, *th = (cplx*)f.th, *ra = (cplx*)f.ra, *rb = (cplx*)f.rb;
+        for (k = 0; k < n1; ++k) {
+            double t = -2.0 * fft_pi * k / m;
+            tl[k] = cos(t) + I * sin(t);
+            t = -2.0 * fft_pi * (k * n2) / n;
+            rb[k] = cos(t) + I * sin(t);
+        }
+        for (k = 0; k < n2; ++k) {
+            double t = -2.0 * fft_pi * (k * n1) / m;
+            th[k] = cos(t) + I * sin(t);
+            t = -2.0 * fft_pi * k / n;
+            ra[k] = cos(t) + I * sin(t);
+        }
+        fft_bitrev(n1, (int64_t*)f.rev1);
+        fft_bitrev(n2, (int64_t*)f.rev2);
+    } else {
+        cplx* rw = (cplx*)f.rw;
+        for (k = 0; k < m; ++k) {
+            double t = -2.0 * fft_pi * k / n;
+            rw[k] = cos(t) + I * sin(t);
+        }
+        fft_bitrev(m, (int64_t*)f.rev);
+    }
+}
+
+void mpt_fft_init(mpt_fft_t* fft, int64_t p, int64_t n) {
+    n = mpt_fft_length(p, n);
+    fft_layout(fft, n);
+
+    int64_t m = n / 2, n1 = fft->n1, n2 = fft->n2, k;
+
+    fft->buf = NULL;
+    fft->nthr = mpt_sqr_threads > 1 ? mpt_sqr_threads : 1;
+
+    fft->x = malloc(sizeof(double) * n);
+    fft->b = malloc(sizeof(int8_t) * n);
+    fft->a = malloc(sizeof(double) * n);
+    fft->ia = malloc(sizeof(double) * n);
+    fft->W = malloc(sizeof(cplx) * m);
+    fft->v = malloc(sizeof(int64_t) * n);
+
+    if (n1 > 0) {
+        fft->buf = malloc(sizeof(cplx) * fft->nthr * MPT_FFT_BLOCK * n2);
+
+        // each thread touches the rows it does (and the digits in them) first, so that (with a NUMA policy of
+        //   first touch, the default on Linux) they are in its own node's memory
+        #pragma omp parallel for schedule(static) num_threads(fft->nthr)
+        for (k = 0; k < n2; ++k) {
+            memset(&fft->x[2 * n1 * k], 0, sizeof(double) * 2 * n1);
+            memset(&fft->b[2 * n1 * k], 0, sizeof(int8_t) * 2 * n1);
+            memset(&fft->a[2 * n1 * k], 0, sizeof(double) * 2 * n1);
+            memset(&fft->ia[2 * n1 * k], 0, sizeof(double) * 2 * n1);
+            memset(&fft->v[2 * n1 * k], 0, sizeof(int64_t) * 2 * n1);
+            memset(&fft->W[2 * n1 * k], 0, sizeof(cplx) * n1);
+        }
+    }
+
+    mpt_fft_reinit(fft, p);
+
+    // the roots (and permutations) are shared by every plan of this length (and they are small for the four-step
+    //   transform, so they can be anywhere)
+    size_t sz = fft_tabs(fft, NULL);
+    fft_tabs(fft, mpt_plan_get(MPT_PLAN_FFT, n, sz, fft_fill));
+}
+
+void mpt_fft_reinit(mpt_fft_t* fft, int64_t p) {
+    int64_t n = fft->n, m = n / 2, j;
+    fft->p = p;
+    fft->maxerr = 0.0;
+
+    for (j = 0; j < n; ++j) {
+        fft->x[j] = 0.0;
+        fft->b[j] = (int8_t)(fft_pos(fft, j + 1) - fft_pos(fft, j));
+
+        // weight is 2^(ceil(p*j/n) - p*j/n), and the exponent is computed exactly as a fraction
+        double e = (double)(fft_pos(fft, j) * n - p * j) / n;
+        fft->a[j] = exp2(e);
+
+        // the unscaled inverse of the half length transform is 'm' times too large
+        fft->ia[j] = exp2(-e) / m;
+    }
+}
+
+void mpt_fft_free(mpt_fft_t* fft) {
+    free(fft->x);
+    free(fft->b);
+    free(fft->a);
+    free(fft->ia);
+    free(fft->W);
+    free(fft->v);
+    free(fft->buf);
+}
+
+
+/* conversion */
+
+void mpt_fft_set(mpt_fft_t* fft, mpt_limb_t* S) {
+    int64_t n = fft->n, j, k = 0;
+    int used = 0;
+
+    int64_t* v = fft->v;
+
+    // read digits out of the bits of 'S'
+    for (j = 0; j < n; ++j) {
+        int b = fft->b[j], got = 0;
+        uint64_t d = 0;
+        while (got < b) {
+            int t = MPT_LIMB_BITS - used;
+            if (t > b - got) t = b - got;
+            uint64_t bits = (uint64_t)(S[k] >> used) & (t == 64 ? ~0ULL : (1ULL << t) - 1);
+            d |= bits << got;
+            got += t;
+            used += t;
+            if (used == MPT_LIMB_BITS) {
+                k++;
+                used = 0;
+            }
+        }
+        v[j] = (int64_t)d;
+    }
+
+    // balance the digits
+    fft_carry(fft, v, 0, true);
+    for (j = 0; j < n; ++j) fft->x[j] = (double)v[j];
+}
+
+void mpt_fft_get(mpt_fft_t* fft, mpt_limb_t* S) {
+    int64_t n = fft->n, N = fft->p / MPT_LIMB_BITS + 1, j, k = 0;
+    int used = 0;
+
+    int64_t* v = fft->v;
+    for (j = 0; j < n; ++j) v[j] = (int64_t)fft->x[j];
+
+    // make all the digits non-negative (but leave 'fft' unchanged)
+    fft_carry(fft, v, 0, false);
+
+    // the value is now in [0, 2^p - 1], so check for 2^p - 1, which is really 0
+    bool all1 = true;
+    for (j = 0; all1 && j < n; ++j) all1 = v[j] == (1LL << fft->b[j]) - 1;
+
+    mpt_set_0(S, N);
+    if (all1) return;
+
+    // write the digits into the bits of 'S'
+    for (j = 0; j < n; ++j) {
+        int b = fft->b[j];
+        uint64_t d = (uint64_t)v[j];
+        while (b > 0) {
+            int t = MPT_LIMB_BITS - used;
+            if (t > b) t = b;
+            S[k] |= (mpt_limb_t)((d & (t == 64 ? ~0ULL : (1ULL << t) - 1)) << used);
+            d = t == 64 ? 0 : d >> t;
+            b -= t;
+            used += t;
+            if (used == MPT_LIMB_BITS) {
+                k++;
+                used = 0;
+            }
+        }
+    }
+}
+
+
+/* four-step */
+
+// return the scratch space of the calling thread
+static cplx* fft4_buf(mpt_fft_t* fft) {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+    return (cplx*)fft->buf + (int64_t)t * MPT_FFT_BLOCK * fft->n2;
+}
+
+// return exp(-2*pi*i*e/m), the twiddle between the passes
+static cplx fft4_tw(mpt_fft_t* fft, int64_t e) {
+    e &= fft->n1 * fft->n2 - 1;
+    return ((const cplx*)fft->tl)[e & (fft->n1 - 1)] * ((const cplx*)fft->th)[e >> fft->lg1];
+}
+
+// bit reverse 'X' (of length 'm'), in place, with the permutation 'rev'
+static void fft4_bitrev(int64_t m, cplx* X, const int64_t* rev) {
+    int64_t k;
+    for (k = 0; k < m; ++k) {
+        if (k < rev[k]) {
+            cplx t = X[k];
+            X[k] = X[rev[k]];
+            X[rev[k]] = t;
+        }
+    }
+}
+
+// the same as 'mpt_fft_sqr', with the four-step transform (see the top of this file)
+static double fft4_sqr(mpt_fft_t* fft, int64_t c) {
+    int64_t n = fft->n, m = n / 2, n1 = fft->n1, n2 = fft->n2, nb = n1 / MPT_FFT_BLOCK, nthr = fft->nthr;
+    int lg2 = fft->lg2;
+
+    cplx* W = (cplx*)fft->W;
+    const cplx* tw = (const cplx*)fft->tw, *ra = (const cplx*)fft->ra, *rb = (const cplx*)fft->rb;
+    double* x = fft->x, *a = fft->a, *ia = fft->ia;
+    const int64_t* rev1 = fft->rev1, *rev2 = fft->rev2;
+    int64_t* v = fft->v;
+
+    // the carry out of each thread's digits
+    int64_t cy[nthr];
+    double err = 0.0;
+
+    #pragma omp parallel num_threads(nthr) if (nthr > 1)
+    {
+        int64_t b, j, k, j1, j2, k1, k2, t;
+        int e;
+
+        // 1, 2: weight and pack the digits of each column (into bit reversed order), transform them, and twiddle
+        #pragma omp for schedule(static)
+        for (b = 0; b < nb; ++b) {
+            cplx* Z = fft4_buf(fft);
+            for (j2 = 0; j2 < n2; ++j2) {
+                for (e = 0; e < MPT_FFT_BLOCK; ++e) {
+                    j = j2 * n1 + b * MPT_FFT_BLOCK + e;
+                    Z[e * n2 + rev2[j2]] = x[2 * j] * a[2 * j] + I * (x[2 * j + 1] * a[2 * j + 1]);
+                }
+            }
+            for (e = 0; e < MPT_FFT_BLOCK; ++e) {
+                cplx* Zc = &Z[e * n2];
+                j1 = b * MPT_FFT_BLOCK + e;
+                fft_dit(n2, Zc, tw, false);
+                for (k2 = 1; k2 < n2; ++k2) Zc[k2] *= fft4_tw(fft, j1 * k2);
+            }
+            for (k2 = 0; k2 < n2; ++k2) {
+                for (e = 0; e < MPT_FFT_BLOCK; ++e) W[k2 * n1 + b * MPT_FFT_BLOCK + e] = Z[e * n2 + k2];
+            }
+        }
+
+        // 3: transform the rows
+        #pragma omp for schedule(static)
+        for (k2 = 0; k2 < n2; ++k2) {
+            fft4_bitrev(n1, &W[k2 * n1], rev1);
+            fft_dit(n1, &W[k2 * n1], tw, false);
+        }
+
+        // square pointwise, in the transposed order: entry 'k' is in row 'k % n2', column 'k / n2', and its
+        //   pair (m - k) is in the mirrored row, so both rows are done together
+        #pragma omp for schedule(static)
+        for (k2 = 0; k2 <= n2 / 2; ++k2) {
+            int64_t r2 = (n2 - k2) & (n2 - 1);
+            for (k1 = 0; k1 < n1; ++k1) {
+                k = k2 + n2 * k1;
+                j = (m - k) & (m - 1);
+                if (r2 == k2 && j < k) continue;
+
+                // exp(-2*pi*i*k/n), and exp(-2*pi*i*j/n) is -conj() of that
+                cplx w = ra[k2] * rb[k1];
+                int64_t pk = k2 * n1 + k1, pj = r2 * n1 + (j >> lg2);
+                cplx Ck = W[pk], Cj = W[pj];
+                W[pk] = fft_sqr_k(Ck, Cj, w);
+                if (j != k) W[pj] = fft_sqr_k(Cj, Ck, -conj(w));
+            }
+        }
+
+        // 3, 2: inverse transform the rows, and twiddle
+        #pragma omp for schedule(static)
+        for (k2 = 0; k2 < n2; ++k2) {
+            cplx* R = &W[k2 * n1];
+            fft4_bitrev(n1, R, rev1);
+            fft_dit(n1, R, tw, true);
+            for (j1 = 1; j1 < n1; ++j1) R[j1] *= conj(fft4_tw(fft, j1 * k2));
+        }
+
+        // 1: inverse transform the columns, and unweight and round them (into the natural order)
+        #pragma omp for schedule(static) reduction(max: err)
+        for (b = 0; b < nb; ++b) {
+            cplx* Z = fft4_buf(fft);
+            for (k2 = 0; k2 < n2; ++k2) {
+                for (e = 0; e < MPT_FFT_BLOCK; ++e) Z[e * n2 + rev2[k2]] = W[k2 * n1 + b * MPT_FFT_BLOCK + e];
+            }
+            for (e = 0; e < MPT_FFT_BLOCK; ++e) fft_dit(n2, &Z[e * n2], tw, true);
+            for (j2 = 0; j2 < n2; ++j2) {
+                for (e = 0; e < MPT_FFT_BLOCK; ++e) {
+                    j = j2 * n1 + b * MPT_FFT_BLOCK + e;
+                    cplx z = Z[e * n2 + j2];
+                    double z0 = creal(z) * ia[2 * j], z1 = cimag(z) * ia[2 * j + 1];
+                    double r0 = rint(z0), r1 = rint(z1);
+                    if (fabs(z0 - r0) > err) err = fabs(z0 - r0);
+                    if (fabs(z1 - r1) > err) err = fabs(z1 - r1);
+                    v[2 * j] = (int64_t)r0;
+                    v[2 * j + 1] = (int64_t)r1;
+                }
+            }
+        }
+
+        // carry each thread's digits (with the '- c' into the bottom one)
+        #pragma omp for schedule(static)
+        for (t = 0; t < nthr; ++t) cy[t] = fft_carry_part(fft, v, n * t / nthr, n * (t + 1) / nthr, t == 0 ? -c : 0);
+
+        // and then the carry out of each one into the next (which is almost always absorbed by the first digit)
+        #pragma omp single
+        {
+            for (t = 0; t < nthr; ++t) {
+                int64_t cc = cy[t];
+                for (j = n * (t + 1) / nthr; cc != 0; ++j) cc = fft_carry_part(fft, v, j % n, j % n + 1, cc);
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for (j = 0; j < n; ++j) x[j] = (double)v[j];
+    }
+
+    return err;
+}
+
+
+/* squaring */
+
+double mpt_fft_sqr(mpt_fft_t* fft, int64_t c) {
+    if (fft->n1 > 0) {
+        double err = fft4_sqr(fft, c);
+        if (err > fft->maxerr) fft->maxerr = err;
+        return err;
+    }
+
+    int64_t n = fft->n, m = n / 2, j, k;
+
+    cplx* W = (cplx*)fft->W;
+    const cplx* tw = (const cplx*)fft->tw, *rw = (const cplx*)fft->rw;
+    double* x = fft->x, *a = fft->a, *ia = fft->ia;
+    const int64_t* rev = fft->rev;
+
+    // weight, and pack the even/odd digits into the (bit reversed) complex input
+    for (k = 0; k < m; ++k) {
+        W[rev[k]] = x[2 * k] * a[2 * k] + I * (x[2 * k + 1] * a[2 * k + 1]);
+    }
+
+    fft_dit(m, W, tw, false);
+
+    // square pointwise, doing the pairs of entries 'k' and 'm - k' together so it can be done in place
+    for (k = 0; 2 * k <= m; ++k) {
+        j = (m - k) % m;
+        cplx Ck = W[k], Cj = W[j];
+        W[k] = fft_sqr_k(Ck, Cj, rw[k]);
+        if (j != k) W[j] = fft_sqr_k(Cj, Ck, rw[j]);
+    }
+
+    // bit reverse, for the inverse transform
+    for (k = 0; k < m; ++k) {
+        if (k < rev[k]) {
+            cplx t = W[k];
+            W[k] = W[rev[k]];
+            W[rev[k]] = t;
+        }
+    }
+
+    fft_dit(m, W, tw, true);
+
+    // unweight, round, and find the error
+    int64_t* v = fft->v;
+    double err = 0.0;
+    for (k = 0; k < m; ++k) {
+        double z0 = creal(W[k]) * ia[2 * k], z1 = cimag(W[k]) * ia[2 * k + 1];
+        double r0 = rint(z0), r1 = rint(z1);
+        if (fabs(z0 - r0) > err) err = fabs(z0 - r0);
+        if (fabs(z1 - r1) > err) err = fabs(z1 - r1);
+        v[2 * k] = (int64_t)r0;
+        v[2 * k + 1] = (int64_t)r1;
+    }
+
+    // the '- c' is just a carry in to the bottom digit
+    fft_carry(fft, v, -c, true);
+    for (j = 0; j < n; ++j) x[j] = (double)v[j];
+
+    if (err > fft->maxerr) fft->maxerr = err;
+    return err;
+}
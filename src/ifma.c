@@ -0,0 +1,312 @@
+/* ifma.c - squaring (mod 2^p - 1) with redundant 52 bit digits, for AVX-512 IFMA
+ *
+ * The number is stored as 'n' digits of 52 bits, each in a 64 bit word. vpmadd52luq/vpmadd52huq multiply the
+ *   low 52 bits of each lane, and add the low/high 52 bits of the 104 bit product onto a 64 bit accumulator,
+ *   so all the products of the square can be summed into their columns without any carries between lanes
+ *   (the spare 12 bits of each word hold the carries, see MPT_R52_BLOCK).
+ *
+ * Then, since 2^p == 1 (mod 2^p - 1), the high half of the columns is shifted and added onto the low half,
+ *   and a single carry propagation pass makes the digits 52 bits again
+ *
+ */
+
+#include "MPT-impl.h"
+
+// whether the IFMA version can be built
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MPT_R52_X86
+#include <immintrin.h>
+#define R52_TGT __attribute__((target("avx512f,avx512ifma")))
+#endif
+
+// mask for the bits of a digit
+#define R52_MASK ((1ULL << MPT_R52_BITS) - 1)
+
+// zero padding after the digits and the column sums (enough for a full vector)
+#define R52_PAD 8
+
+
+/* bits */
+
+// return the 'len' (<= 64) bits of 'S' (which has 'N' limbs) starting at bit 'pos' (bits past the end are 0)
+static uint64_t r52_getbits(mpt_limb_t* S, int64_t N, int64_t pos, int len) {
+    uint64_t res = 0;
+    int got = 0;
+    while (got < len && (pos + got) / (int64_t)MPT_LIMB_BITS < N) {
+        int64_t k = (pos + got) / MPT_LIMB_BITS;
+        int used = (pos + got) % MPT_LIMB_BITS;
+        int t = MPT_LIMB_BITS - used;
+        if (t > len - got) t = len - got;
+        res |= ((uint64_t)(S[k] >> used) & (t == 64 ? ~0ULL : (1ULL << t) - 1)) << got;
+        got += t;
+    }
+    return res;
+}
+
+// OR the low 'len' (<= 64) bits of 'v' into 'S' (which has 'N' limbs) at bit 'pos'
+static void r52_orbits(mpt_limb_t* S, int64_t N, int64_t pos, int len, uint64_t v) {
+    while (len > 0 && pos / (int64_t)MPT_LIMB_BITS < N) {
+        int64_t k = pos / MPT_LIMB_BITS;
+        int used = pos % MPT_LIMB_BITS;
+        int t = MPT_LIMB_BITS - used;
+        if (t > len) t = len;
+        S[k] |= (mpt_limb_t)((v & (t == 64 ? ~0ULL : (1ULL << t) - 1)) << used);
+        v = t == 64 ? 0 : v >> t;
+        len -= t;
+        pos += t;
+    }
+}
+
+
+/* squaring */
+
+// add the rows 'i0 <= i < i1' of the off-diagonal products x[i]*x[j] (j > i) onto the column sums,
+//   where the low 52 bits go to 'zl[i+j]', and the high 52 bits go to 'zh[i+j]' (which is worth 2^52 more)
+static inline void r52_rows(mpt_r52_t* r, int64_t i0, int64_t i1) {
+    int64_t n = r->n, i, j;
+    uint64_t* x = r->x, *zl = r->zl, *zh = r->zh;
+    for (i = i0; i < i1; ++i) {
+        for (j = i + 1; j < n; ++j) {
+            uint64_t hi, lo = mpt_mul64(x[i], x[j], &hi);
+            zl[i + j] += lo & R52_MASK;
+            zh[i + j] += (lo >> MPT_R52_BITS) | (hi << (64 - MPT_R52_BITS));
+        }
+    }
+}
+
+// split the column sums 'z[0..m)', so each one is less than 2^52 + 2^12 (without changing the value)
+static inline void r52_split(int64_t m, uint64_t* z) {
+    int64_t k;
+    for (k = m - 1; k > 0; --k) z[k] = (z[k] & R52_MASK) + (z[k - 1] >> MPT_R52_BITS);
+    z[0] &= R52_MASK;
+}
+
+// shift 'v' left by 's' (< 52), and return the 0th, 1st, and 2nd 52 bit digit of that
+#define R52_C0(v, s) (((v) << (s)) & R52_MASK)
+#define R52_C1(v, s) (((v) >> (MPT_R52_BITS - (s))) & R52_MASK)
+#define R52_C2(v, s) (((v) >> (MPT_R52_BITS - (s))) >> MPT_R52_BITS)
+
+// return digit 'm' of the fold of the columns 'z' (see 'r52_finish'), for the edges (m < 2 or m >= n)
+static uint64_t r52_fold_at(int64_t n, int64_t s, uint64_t* z, int64_t m) {
+    uint64_t* zh = &z[n];
+    uint64_t v = (m < n ? z[m] : 0) + R52_C0(zh[m], s);
+    if (m >= 1) v += R52_C1(zh[m - 1], s);
+    if (m >= 2) v += R52_C2(zh[m - 2], s);
+    return v;
+}
+
+// finish the square (after all the rows are done, and split):
+// double the off-diagonal products and add the diagonal ones, fold the high half of the columns onto the low
+//   half, and subtract 'c' (the result is in 'x', but the digits are not normalized)
+static inline void r52_finish(mpt_r52_t* r, int64_t c) {
+    int64_t n = r->n, m, k;
+    uint64_t* x = r->x, *z = r->zl, *zh = r->zh;
+
+    // each column is less than 2^55 after this
+    for (k = 2 * n; k > 0; --k) z[k] = 2 * (z[k] + zh[k - 1]);
+    z[0] *= 2;
+    for (k = 0; k < n; ++k) {
+        uint64_t hi, lo = mpt_mul64(x[k], x[k], &hi);
+        z[2 * k] += lo & R52_MASK;
+        z[2 * k + 1] += (lo >> MPT_R52_BITS) | (hi << (64 - MPT_R52_BITS));
+    }
+
+    // column 'n + m' is worth 2^(52(n+m)) == 2^(52m + s), so it is shifted left by 's', and the 3 digits of that
+    //   are added onto digits 'm', 'm + 1', and 'm + 2'
+    int64_t s = MPT_R52_BITS * n - r->p;
+    uint64_t* zhi = &z[n];
+    for (m = 2; m < n; ++m) x[m] = z[m] + R52_C0(zhi[m], s) + R52_C1(zhi[m - 1], s) + R52_C2(zhi[m - 2], s);
+    for (m = 0; m < 2 && m < n; ++m) x[m] = r52_fold_at(n, s, z, m);
+    for (m = n; m < n + 3; ++m) x[m] = r52_fold_at(n, s, z, m);
+    x[n + 3] = 0;
+
+    // add 2^p - 1 - c, so nothing is negative
+    for (m = 0; m < n; ++m) x[m] += R52_MASK;
+    x[n - 1] -= R52_MASK - ((1ULL << r->t) - 1);
+    x[0] -= c;
+}
+
+// normalize the digits 'x[0..n+4)', and wrap everything above bit 'p' around to the bottom
+static void r52_norm(mpt_r52_t* r) {
+    int64_t n = r->n, t = r->t, m, j;
+    uint64_t* x = r->x, c = 0;
+
+    // NOTE: the value is much less than 2^(52(n+4)), so there is no carry out of the top
+    for (m = 0; m < n + 4; ++m) {
+        uint64_t v = x[m] + c;
+        x[m] = v & R52_MASK;
+        c = v >> MPT_R52_BITS;
+    }
+
+    while (true) {
+        // the bits above 'p', as 52 bit digits
+        uint64_t e[4];
+        bool any = false;
+        for (j = 0; j < 4; ++j) {
+            e[j] = (x[n - 1 + j] >> t) | ((x[n + j] << (MPT_R52_BITS - t)) & R52_MASK);
+            any = any || e[j] != 0;
+        }
+        if (!any) break;
+
+        x[n - 1] &= (1ULL << t) - 1;
+        for (j = 0; j < 4; ++j) x[n + j] = 0;
+
+        // add them to the bottom (which usually doesn't carry very far)
+        c = 0;
+        for (m = 0; m < n + 4 && (m < 4 || c != 0); ++m) {
+            uint64_t v = x[m] + (m < 4 ? e[m] : 0) + c;
+            x[m] = v & R52_MASK;
+            c = v >> MPT_R52_BITS;
+        }
+    }
+}
+
+static void r52_sqr_generic(mpt_r52_t* r, int64_t c) {
+    int64_t n = r->n, i0;
+    memset(r->zl, 0, sizeof(uint64_t) * (2 * n + 2 * R52_PAD));
+    memset(r->zh, 0, sizeof(uint64_t) * (2 * n + 2 * R52_PAD));
+
+    for (i0 = 0; i0 < n; i0 += MPT_R52_BLOCK) {
+        r52_rows(r, i0, i0 + MPT_R52_BLOCK < n ? i0 + MPT_R52_BLOCK : n);
+        r52_split(2 * n + 1, r->zl);
+        r52_split(2 * n + 1, r->zh);
+    }
+
+    r52_finish(r, c);
+}
+
+#ifdef MPT_R52_X86
+
+// same as 'r52_rows' (for all the rows), but with vpmadd52luq/vpmadd52huq, 8 columns at a time:
+// for each block of 8 columns 'k = K + l', the products x[i]*x[k-i] (i < k - i < n) are summed in registers
+//   (in 4 independent accumulators, to hide the latency), and only added to 'zl' and 'zh' at the end
+//   (or every MPT_R52_BLOCK products, so they can't overflow)
+// NOTE: 'x' is zero padded, so the products past the end are 0, and only the ones on the diagonal need to be masked
+R52_TGT
+static void r52_cols_ifma(mpt_r52_t* r) {
+    int64_t n = r->n, K, i, i0, i1;
+    uint64_t* x = r->x, *zl = r->zl, *zh = r->zh;
+    const __m512i mask = _mm512_set1_epi64((long long)R52_MASK), zero = _mm512_setzero_si512();
+
+    for (K = 0; K < 2 * n; K += 8) {
+        // the range of 'i' for any lane, and where the diagonal starts ('i >= k - i' for some lanes)
+        int64_t ilo = K - n + 1 > 0 ? K - n + 1 : 0, ihi = K / 2 + 4, idiag = K / 2;
+
+        for (i0 = ilo; i0 < ihi; i0 += MPT_R52_BLOCK) {
+            i1 = i0 + MPT_R52_BLOCK < ihi ? i0 + MPT_R52_BLOCK : ihi;
+            int64_t iu = i1 < idiag ? i1 : idiag;
+
+            __m512i l0 = zero, l1 = zero, l2 = zero, l3 = zero;
+            __m512i h0 = zero, h1 = zero, h2 = zero, h3 = zero;
+            for (i = i0; i + 4 <= iu; i += 4) {
+                __m512i a0 = _mm512_set1_epi64((long long)x[i + 0]), b0 = _mm512_loadu_si512(&x[K - i - 0]);
+                __m512i a1 = _mm512_set1_epi64((long long)x[i + 1]), b1 = _mm512_loadu_si512(&x[K - i - 1]);
+                __m512i a2 = _mm512_set1_epi64((long long)x[i + 2]), b2 = _mm512_loadu_si512(&x[K - i - 2]);
+                __m512i a3 = _mm512_set1_epi64((long long)x[i + 3]), b3 = _mm512_loadu_si512(&x[K - i - 3]);
+                l0 = _mm512_madd52lo_epu64(l0, a0, b0);
+                h0 = _mm512_madd52hi_epu64(h0, a0, b0);
+                l1 = _mm512_madd52lo_epu64(l1, a1, b1);
+                h1 = _mm512_madd52hi_epu64(h1, a1, b1);
+                l2 = _mm512_madd52lo_epu64(l2, a2, b2);
+                h2 = _mm512_madd52hi_epu64(h2, a2, b2);
+                l3 = _mm512_madd52lo_epu64(l3, a3, b3);
+                h3 = _mm512_madd52hi_epu64(h3, a3, b3);
+            }
+            for (; i < i1; ++i) {
+                // only lanes with 'i < K + l - i' (the masked out ones may be before the start of 'x')
+                int64_t d = 2 * i - K + 1;
+                __mmask8 m = d <= 0 ? 0xff : (__mmask8)(0xff << d);
+                __m512i a = _mm512_set1_epi64((long long)x[i]), b = _mm512_maskz_loadu_epi64(m, &x[K - i]);
+                l0 = _mm512_madd52lo_epu64(l0, a, b);
+                h0 = _mm512_madd52hi_epu64(h0, a, b);
+            }
+
+            // split them, and add them on
+            __m512i L = _mm512_add_epi64(_mm512_add_epi64(l0, l1), _mm512_add_epi64(l2, l3));
+            __m512i H = _mm512_add_epi64(_mm512_add_epi64(h0, h1), _mm512_add_epi64(h2, h3));
+            _mm512_storeu_si512(&zl[K], _mm512_add_epi64(_mm512_loadu_si512(&zl[K]), _mm512_and_si512(L, mask)));
+            _mm512_storeu_si512(&zh[K], _mm512_add_epi64(_mm512_loadu_si512(&zh[K]), _mm512_and_si512(H, mask)));
+            _mm512_storeu_si512(&zl[K + 1], _mm512_add_epi64(_mm512_loadu_si512(&zl[K + 1]), _mm512_srli_epi64(L, MPT_R52_BITS)));
+            _mm512_storeu_si512(&zh[K + 1], _mm512_add_epi64(_mm512_loadu_si512(&zh[K + 1]), _mm512_srli_epi64(H, MPT_R52_BITS)));
+        }
+    }
+}
+
+// same as 'r52_sqr_generic', but with the column sums done with IFMA (see 'r52_cols_ifma')
+// NOTE: the splitting and folding ('r52_split' and 'r52_finish') are the same scalar C, which is only inlined here
+//   so the compiler may vectorize it for AVX-512 (they are O(n), against the O(n^2) of the columns)
+R52_TGT
+static void r52_sqr_ifma(mpt_r52_t* r, int64_t c) {
+    int64_t n = r->n;
+    memset(r->zl, 0, sizeof(uint64_t) * (2 * n + 2 * R52_PAD));
+    memset(r->zh, 0, sizeof(uint64_t) * (2 * n + 2 * R52_PAD));
+
+    r52_cols_ifma(r);
+    r52_split(2 * n + 1, r->zl);
+    r52_split(2 * n + 1, r->zh);
+
+    r52_finish(r, c);
+}
+
+#endif
+
+
+/* plan */
+
+void mpt_r52_init(mpt_r52_t* r, int64_t p) {
+    r->p = p;
+    r->n = (p + MPT_R52_BITS - 1) / MPT_R52_BITS;
+    r->t = p - MPT_R52_BITS * (r->n - 1);
+
+    r->x = calloc(r->n + 4 + R52_PAD, sizeof(uint64_t));
+    r->zl = calloc(2 * r->n + 2 * R52_PAD, sizeof(uint64_t));
+    r->zh = calloc(2 * r->n + 2 * R52_PAD, sizeof(uint64_t));
+
+    // only use IFMA along with the AVX-512 kernels (so 'mpt_kern_init' can turn it off)
+    r->ifma = false;
+#ifdef MPT_R52_X86
+    r->ifma = (mpt_cpu_features() & MPT_CPU_AVX512IFMA) && (mpt_kern.req & MPT_CPU_AVX512F);
+#endif
+}
+
+void mpt_r52_free(mpt_r52_t* r) {
+    free(r->x);
+    free(r->zl);
+    free(r->zh);
+}
+
+
+/* conversion */
+
+void mpt_r52_set(mpt_r52_t* r, mpt_limb_t* S) {
+    int64_t N = r->p / MPT_LIMB_BITS + 1, j;
+    for (j = 0; j < r->n; ++j) r->x[j] = r52_getbits(S, N, MPT_R52_BITS * j, MPT_R52_BITS);
+    for (j = r->n; j < r->n + 4 + R52_PAD; ++j) r->x[j] = 0;
+}
+
+void mpt_r52_get(mpt_r52_t* r, mpt_limb_t* S) {
+    int64_t N = r->p / MPT_LIMB_BITS + 1, n = r->n, j;
+
+    // the value is in [0, 2^p - 1], so check for 2^p - 1, which is really 0
+    bool all1 = r->x[n - 1] == (1ULL << r->t) - 1;
+    for (j = 0; all1 && j < n - 1; ++j) all1 = r->x[j] == R52_MASK;
+
+    mpt_set_0(S, N);
+    if (all1) return;
+
+    for (j = 0; j < n; ++j) r52_orbits(S, N, MPT_R52_BITS * j, MPT_R52_BITS, r->x[j]);
+}
+
+
+/* squaring */
+
+void mpt_r52_sqr(mpt_r52_t* r, int64_t c) {
+#ifdef MPT_R52_X86
+    if (r->ifma) r52_sqr_ifma(r, c);
+    else r52_sqr_generic(r, c);
+#else
+    r52_sqr_generic(r, c);
+#endif
+
+    r52_norm(r);
+}
@@ -0,0 +1,144 @@
+/* kern.c - runtime CPU dispatch for the hot arithmetic kernels
+ *
+ * The kernels in 'MPT-kern.h' are compiled once for each instruction set (with 'target' attributes, so
+ *   no special flags are needed for the whole build), and the best one the CPU supports is picked at
+ *   startup (with CPUID), so a single binary runs well on any x86_64 machine
+ *
+ */
+
+#include "MPT-impl.h"
+
+// whether the x86_64 versions can be built
+#if defined(MPT_LIMB_U64) && defined(__x86_64__) && defined(__GNUC__) && defined(__SIZEOF_INT128__)
+#define MPT_KERN_X86
+#endif
+
+// whether the unrolled small squarings can be built (they need 128 bit products of 64 bit limbs)
+#if defined(MPT_LIMB_U64) && defined(__SIZEOF_INT128__)
+#define MPT_KERN_HAS_SMALL
+#define MPT_KERN_SMALL_TAB(_sfx) k_sqr_small_tab##_sfx
+#else
+#define MPT_KERN_SMALL_TAB(_sfx) NULL
+#endif
+
+#ifdef MPT_KERN_X86
+#include <cpuid.h>
+#include <immintrin.h>
+
+// the lanes of 'mpt_simd_t' (for the versions with MPT_KERN_VEC, which GCC splits into the target's vectors)
+typedef uint64_t kern_v8_t __attribute__((vector_size(64)));
+#endif
+
+
+/* versions */
+
+// portable C
+#define MPT_KERN_SFX _generic
+#define MPT_KERN_TGT
+#define MPT_KERN_ADX 0
+#define MPT_KERN_VEC 0
+#include "MPT-kern.h"
+#undef MPT_KERN_SFX
+#undef MPT_KERN_TGT
+#undef MPT_KERN_ADX
+#undef MPT_KERN_VEC
+
+#ifdef MPT_KERN_X86
+
+// mulx/adcx/adox carry chains
+#define MPT_KERN_SFX _adx
+#define MPT_KERN_TGT __attribute__((target("bmi2,adx")))
+#define MPT_KERN_ADX 1
+#define MPT_KERN_VEC 0
+#include "MPT-kern.h"
+#undef MPT_KERN_SFX
+#undef MPT_KERN_TGT
+#undef MPT_KERN_ADX
+#undef MPT_KERN_VEC
+
+// same carry chains, but any independent loops may use 256 bit vectors
+#define MPT_KERN_SFX _avx2
+#define MPT_KERN_TGT __attribute__((target("bmi2,adx,avx2")))
+#define MPT_KERN_ADX 1
+#define MPT_KERN_VEC 256
+#include "MPT-kern.h"
+#undef MPT_KERN_SFX
+#undef MPT_KERN_TGT
+#undef MPT_KERN_ADX
+#undef MPT_KERN_VEC
+
+// and with 512 bit vectors
+#define MPT_KERN_SFX _avx512
+#define MPT_KERN_TGT __attribute__((target("bmi2,adx,avx2,avx512f,prefer-vector-width=512")))
+#define MPT_KERN_ADX 1
+#define MPT_KERN_VEC 512
+#include "MPT-kern.h"
+#undef MPT_KERN_SFX
+#undef MPT_KERN_TGT
+#undef MPT_KERN_ADX
+#undef MPT_KERN_VEC
+
+#endif
+
+
+/* dispatch table */
+
+#define MPT_KERN_ENTRY(_name, _sfx, _req) { _name, _req, k_sqr_basecase##_sfx, k_sqr_cols##_sfx, k_sqr_mod2pm1##_sfx, MPT_KERN_SMALL_TAB(_sfx), k_simd_sqr##_sfx, k_add_n##_sfx, k_sub_n##_sfx }
+
+// all of the versions, best first
+static const mpt_kern_t kern_all[] = {
+#ifdef MPT_KERN_X86
+    MPT_KERN_ENTRY("avx512", _avx512, MPT_CPU_BMI2 | MPT_CPU_ADX | MPT_CPU_AVX2 | MPT_CPU_AVX512F),
+    MPT_KERN_ENTRY("avx2", _avx2, MPT_CPU_BMI2 | MPT_CPU_ADX | MPT_CPU_AVX2),
+    MPT_KERN_ENTRY("adx", _adx, MPT_CPU_BMI2 | MPT_CPU_ADX),
+#endif
+    MPT_KERN_ENTRY("generic", _generic, 0),
+};
+
+// start out with the generic versions, so everything works even if 'mpt_kern_init' is never called
+mpt_kern_t mpt_kern = MPT_KERN_ENTRY("generic", _generic, 0);
+
+
+int mpt_cpu_features() {
+    int res = 0;
+
+#ifdef MPT_KERN_X86
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(0, &a, &b, &c, &d) || a < 7) return res;
+
+    // the OS must save the vector registers too (XCR0), or they can't be used
+    __get_cpuid(1, &a, &b, &c, &d);
+    uint64_t xcr0 = 0;
+    if (c & (1u << 27)) {
+        unsigned int lo, hi;
+        __asm__("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+    }
+    bool os_avx = (xcr0 & 0x06) == 0x06, os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+    __get_cpuid_count(7, 0, &a, &b, &c, &d);
+    if (b & (1u << 8)) res |= MPT_CPU_BMI2;
+    if (b & (1u << 19)) res |= MPT_CPU_ADX;
+    if (os_avx && (b & (1u << 5))) res |= MPT_CPU_AVX2;
+    if (os_avx512 && (b & (1u << 16))) res |= MPT_CPU_AVX512F;
+    if (os_avx512 && (b & (1u << 21))) res |= MPT_CPU_AVX512IFMA;
+#endif
+
+    return res;
+}
+
+bool mpt_kern_init(const char* name) {
+    int feat = mpt_cpu_features();
+    int i;
+    for (i = 0; i < (int)(sizeof(kern_all) / sizeof(*kern_all)); ++i) {
+        if ((kern_all[i].req & feat) != kern_all[i].req) continue;
+        if (name != NULL && *name && strcmp(name, kern_all[i].name) != 0) continue;
+
+        mpt_kern = kern_all[i];
+        return true;
+    }
+
+    // not found (or not supported), so use the best one
+    if (name != NULL && *name) mpt_kern_init(NULL);
+    return false;
+}
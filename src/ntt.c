@@ -0,0 +1,279 @@
+/* ntt.c - Number Theoretic Transform (NTT) squaring
+ *
+ * The limbs of a number are treated as the coefficients of a polynomial, which is squared with an exact
+ *   cyclic convolution over 3 different primes. Each coefficient of the square is then recombined
+ *   with the CRT (Chinese Remainder Theorem), and the carries are propagated to get the limbs of the result
+ *
+ */
+
+#include "MPT-impl.h"
+
+
+/* prime constants */
+
+// the primes are all of the form c*2^k+1 (with k >= 54), and between 2^61 and 2^62, so 4P fits in 64 bits, and
+//   the transforms can keep their values in [0, 2P) (only reducing them fully at the end), and transforms up to
+//   length 2^54 are supported
+static const uint64_t ntt_P[MPT_NTT_NP] = {
+    0x3a00000000000001ULL, // 29 * 2^57 + 1
+    0x2c40000000000001ULL, // 177 * 2^54 + 1
+    0x2280000000000001ULL, // 69 * 2^55 + 1
+};
+
+// primitive roots for each prime
+static const uint64_t ntt_G[MPT_NTT_NP] = { 3, 7, 5 };
+
+// -P^-1 (mod 2^64), for Montgomery reduction
+static const uint64_t ntt_Pinv[MPT_NTT_NP] = {
+    0x39ffffffffffffffULL,
+    0x2c3fffffffffffffULL,
+    0x227fffffffffffffULL,
+};
+
+// 2^128 (mod P), for converting into Montgomery form
+static const uint64_t ntt_R2[MPT_NTT_NP] = {
+    0x1a11a7b9611a7baaULL,
+    0x22f5e02e4850feb0ULL,
+    0x1b67e2519f8946b6ULL,
+};
+
+// 2^64 (mod P), which is '1' in Montgomery form
+static const uint64_t ntt_R1[MPT_NTT_NP] = {
+    0x17fffffffffffffcULL,
+    0x22bffffffffffffbULL,
+    0x0e7ffffffffffff9ULL,
+};
+
+// CRT constants (all in Montgomery form):
+// P0^-1 (mod P1), P0^-1 (mod P2), and P1^-1 (mod P2)
+static const uint64_t ntt_C01 = 0x073dac37dac37dbfULL;
+static const uint64_t ntt_C02 = 0x16c15c9882b93111ULL;
+static const uint64_t ntt_C12 = 0x11b13b13b13b13ccULL;
+
+// P0 * P1, as a 128 bit number (lo, hi)
+static const uint64_t ntt_P01[2] = { 0x6640000000000001ULL, 0x0a06800000000000ULL };
+
+
+/* modular kernels */
+
+// calculate a*b*2^-64 (mod P), for a*b < P*2^64, which is in [0, 2P) (it isn't fully reduced)
+static uint64_t ntt_mmul_lazy(uint64_t a, uint64_t b, uint64_t P, uint64_t Pinv) {
+    uint64_t hi, lo = mpt_mul64(a, b, &hi);
+    uint64_t mh, m = lo * Pinv;
+    mpt_mul64(m, P, &mh);
+
+    // lo + low(m*P) is always 0 (mod 2^64), so it only carries out when 'lo' was non-zero
+    return hi + mh + (lo != 0);
+}
+
+// calculate a*b*2^-64 (mod P), for a*b < P*2^64
+static uint64_t ntt_mmul(uint64_t a, uint64_t b, uint64_t P, uint64_t Pinv) {
+    uint64_t r = ntt_mmul_lazy(a, b, P, Pinv);
+    return r >= P ? r - P : r;
+}
+
+// reduce 'a' (which is less than 2*M) to [0, M)
+static uint64_t ntt_red(uint64_t a, uint64_t M) {
+    return a >= M ? a - M : a;
+}
+
+// calculate a-b (mod P)
+static uint64_t ntt_sub(uint64_t a, uint64_t b, uint64_t P) {
+    return a >= b ? a - b : a - b + P;
+}
+
+// calculate a^b (mod P), with 'a' in Montgomery form (and the result in Montgomery form)
+static uint64_t ntt_mpow(uint64_t a, uint64_t b, int k) {
+    uint64_t res = ntt_R1[k];
+    while (b > 0) {
+        if (b & 1) res = ntt_mmul(res, a, ntt_P[k], ntt_Pinv[k]);
+        a = ntt_mmul(a, a, ntt_P[k], ntt_Pinv[k]);
+        b >>= 1;
+    }
+    return res;
+}
+
+
+/* transforms */
+
+// forward transform (decimation in frequency), in place
+// Input is in natural order, output is in bit-reversed order, and the values are in [0, 2P) (both ways)
+// NOTE: u - v + 2P is less than 4P, and the root is less than P, so the product is small enough for 'ntt_mmul_lazy'
+static void ntt_fwd(int64_t L, uint64_t* W, const uint64_t* rt, uint64_t P, uint64_t Pinv) {
+    uint64_t P2 = 2 * P;
+    int64_t len, s, j;
+    for (len = L / 2; len >= 1; len /= 2) {
+        for (s = 0; s < L; s += 2 * len) {
+            uint64_t* X = &W[s], *Y = &W[s + len];
+            const uint64_t* R = &rt[len];
+            for (j = 0; j < len; ++j) {
+                uint64_t u = X[j], v = Y[j];
+                X[j] = ntt_red(u + v, P2);
+                Y[j] = ntt_mmul_lazy(u - v + P2, R[j], P, Pinv);
+            }
+        }
+    }
+}
+
+// inverse transform (decimation in time), in place, without the 1/L scaling
+// Input is in bit-reversed order, output is in natural order, and the values are in [0, 2P) (both ways)
+static void ntt_inv(int64_t L, uint64_t* W, const uint64_t* irt, uint64_t P, uint64_t Pinv) {
+    uint64_t P2 = 2 * P;
+    int64_t len, s, j;
+    for (len = 1; len < L; len *= 2) {
+        for (s = 0; s < L; s += 2 * len) {
+            uint64_t* X = &W[s], *Y = &W[s + len];
+            const uint64_t* R = &irt[len];
+            for (j = 0; j < len; ++j) {
+                uint64_t u = X[j], v = ntt_mmul_lazy(Y[j], R[j], P, Pinv);
+                X[j] = ntt_red(u + v, P2);
+                Y[j] = ntt_red(u - v + P2, P2);
+            }
+        }
+    }
+}
+
+
+/* plan */
+
+// fill 'data' with the roots, and then the inverse roots, for each prime (see 'mpt_ntt_t')
+static void ntt_fill(void* data, int64_t L) {
+    int64_t len, j;
+    int k;
+
+    for (k = 0; k < MPT_NTT_NP; ++k) {
+        uint64_t P = ntt_P[k], Pinv = ntt_Pinv[k];
+        uint64_t* rt = (uint64_t*)data + 2 * k * L, *irt = rt + L;
+
+        // generator, in Montgomery form
+        uint64_t g = ntt_mmul(ntt_G[k], ntt_R2[k], P, Pinv);
+
+        for (len = 1; len < L; len *= 2) {
+            // primitive '2*len'th root of unity, and its inverse
+            uint64_t w = ntt_mpow(g, (P - 1) / (2 * len), k);
+            uint64_t iw = ntt_mpow(w, 2 * len - 1, k);
+
+            uint64_t wj = ntt_R1[k], iwj = ntt_R1[k];
+            for (j = 0; j < len; ++j) {
+                rt[len + j] = wj;
+                irt[len + j] = iwj;
+                wj = ntt_mmul(wj, w, P, Pinv);
+                iwj = ntt_mmul(iwj, iw, P, Pinv);
+            }
+        }
+
+        // unused slot
+        rt[0] = irt[0] = 0;
+    }
+}
+
+void mpt_ntt_init(mpt_ntt_t* ntt, int64_t N) {
+    ntt->N = N;
+
+    // the square has 2N limbs, so that is the minimum transform size to avoid wrapping around
+    ntt->L = 1;
+    while (ntt->L < 2 * N) ntt->L *= 2;
+
+    int64_t L = ntt->L;
+    int k;
+
+    // the roots are shared by every plan of this length
+    const uint64_t* tab = mpt_plan_get(MPT_PLAN_NTT, L, sizeof(uint64_t) * 2 * MPT_NTT_NP * L, ntt_fill);
+    for (k = 0; k < MPT_NTT_NP; ++k) {
+        ntt->rt[k] = &tab[2 * k * L];
+        ntt->irt[k] = &tab[(2 * k + 1) * L];
+        ntt->W[k] = malloc(sizeof(uint64_t) * L);
+
+        // (L^-1 * 2^64 is the inverse in Montgomery form, so multiplying by 1 leaves just L^-1)
+        uint64_t P = ntt_P[k], Pinv = ntt_Pinv[k];
+        ntt->iL[k] = ntt_mmul(ntt_mpow(ntt_mmul(L, ntt_R2[k], P, Pinv), P - 2, k), 1, P, Pinv);
+    }
+}
+
+void mpt_ntt_free(mpt_ntt_t* ntt) {
+    int k;
+    for (k = 0; k < MPT_NTT_NP; ++k) free(ntt->W[k]);
+}
+
+
+/* squaring */
+
+void mpt_ntt_sqr(mpt_ntt_t* ntt, mpt_limb_t* A, mpt_limb_t* C) {
+    int64_t N = ntt->N, L = ntt->L, i;
+    int k;
+
+    for (k = 0; k < MPT_NTT_NP; ++k) {
+        uint64_t P = ntt_P[k], Pinv = ntt_Pinv[k], R2 = ntt_R2[k];
+        uint64_t* W = ntt->W[k];
+
+        // load the limbs in Montgomery form (zero padded)
+        for (i = 0; i < N; ++i) W[i] = ntt_mmul(A[i], R2, P, Pinv);
+        for (i = N; i < L; ++i) W[i] = 0;
+
+        ntt_fwd(L, W, ntt->rt[k], P, Pinv);
+
+        // pointwise squaring, and scale by 1/L, which also converts out of Montgomery form (see 'mpt_ntt_t'), so
+        //   the inverse transform gives the coefficients directly
+        uint64_t iL = ntt->iL[k];
+        for (i = 0; i < L; ++i) W[i] = ntt_mmul_lazy(ntt_mmul_lazy(W[i], W[i], P, Pinv), iL, P, Pinv);
+
+        ntt_inv(L, W, ntt->irt[k], P, Pinv);
+    }
+
+    uint64_t P0 = ntt_P[0], P1 = ntt_P[1], P2 = ntt_P[2];
+
+    // running sum of the coefficients, as a 3 word number
+    uint64_t acc[3] = { 0, 0, 0 };
+
+    for (i = 0; i < 2 * N; ++i) {
+        // (the values are only fully reduced here, see 'ntt_fwd')
+        uint64_t r0 = ntt_red(ntt->W[0][i], P0), r1 = ntt_red(ntt->W[1][i], P1), r2 = ntt_red(ntt->W[2][i], P2);
+
+        // Garner's algorithm, the coefficient is 'x = v0 + v1*P0 + v2*P0*P1'
+        // NOTE: P0 < 2*P1 and P1 < 2*P2, so a single subtraction is enough to reduce between them
+        uint64_t v0 = r0;
+        uint64_t v1 = ntt_mmul(ntt_sub(r1, v0 >= P1 ? v0 - P1 : v0, P1), ntt_C01, P1, ntt_Pinv[1]);
+        uint64_t v2 = ntt_mmul(ntt_sub(r2, v0 >= P2 ? v0 - P2 : v0, P2), ntt_C02, P2, ntt_Pinv[2]);
+        v2 = ntt_mmul(ntt_sub(v2, v1 >= P2 ? v1 - P2 : v1, P2), ntt_C12, P2, ntt_Pinv[2]);
+
+        // x = v0 + v1*P0
+        uint64_t x0, x1, x2, t0, t1, c;
+        x0 = mpt_mul64(v1, P0, &x1);
+        x0 += v0;
+        x1 += x0 < v0;
+
+        // x += v2*P01
+        t0 = mpt_mul64(v2, ntt_P01[0], &t1);
+        x0 += t0;
+        c = x0 < t0;
+        x1 += c;
+        x2 = x1 < c;
+        x1 += t1;
+        x2 += x1 < t1;
+        t0 = mpt_mul64(v2, ntt_P01[1], &t1);
+        x1 += t0;
+        x2 += (x1 < t0) + t1;
+
+        // acc += x
+        acc[0] += x0;
+        c = acc[0] < x0;
+        acc[1] += c;
+        c = acc[1] < c;
+        acc[1] += x1;
+        c += acc[1] < x1;
+        acc[2] += x2 + c;
+
+        // output a limb, and shift the accumulator down
+        C[i] = (mpt_limb_t)acc[0];
+
+#ifdef MPT_LIMB_U64
+        acc[0] = acc[1];
+        acc[1] = acc[2];
+        acc[2] = 0;
+#else
+        acc[0] = (acc[0] >> MPT_LIMB_BITS) | (acc[1] << (64 - MPT_LIMB_BITS));
+        acc[1] = (acc[1] >> MPT_LIMB_BITS) | (acc[2] << (64 - MPT_LIMB_BITS));
+        acc[2] = (acc[2] >> MPT_LIMB_BITS);
+#endif
+    }
+}
@@ -0,0 +1,215 @@
+/* plan.c - the plan cache, which keeps the tables of each transform length (and can keep them in files)
+ *
+ * The roots of unity (and the bit reversal permutations) of a transform only depend on its kind and length, but
+ *   computing them takes a while for long transforms (the IBDWT takes a 'sin' and a 'cos' for each root), and
+ *   every plan used to keep its own copy. So, they are computed once for each length, and kept (read-only) for
+ *   every plan after that, in every thread
+ *
+ * With 'mpt_plan_dir', the tables are also written to the file 'kind-len.plan' there (to a temporary file, which
+ *   is renamed over it, so a file is never partial), and a process that finds the file maps it (read-only)
+ *   instead of computing them. So, the next run starts right away, and any number of processes on the same
+ *   machine all share one copy of the tables (in the page cache)
+ *
+ * The tables are stored as they are in memory (so, a file is only used by a build for the same kind of machine),
+ *   after a header that records the format version, the kind, the length, the size, and a checksum
+ *
+ */
+
+// for 'fileno', 'fsync', and 'mmap'
+#define _POSIX_C_SOURCE 200809L
+
+#include "MPT-impl.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+const char* mpt_plan_dir = NULL;
+
+// the magic number at the start of each file (which also won't match on a machine with the other byte order)
+#define PLAN_MAGIC 0x4e414c5054504d00ULL
+
+// the header, which takes up the first MPT_ALIGN bytes of the file (so the tables are aligned when mapped)
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t kind;
+    int64_t len;
+    uint64_t size;
+    uint64_t sum;
+} plan_hdr_t;
+
+// the tables of one kind and length
+typedef struct plan_s {
+    int kind;
+    int64_t len;
+
+    // the tables, and their size (and the whole mapping, if they are from a file, or NULL)
+    void* data;
+    size_t size;
+    void* map;
+
+    struct plan_s* next;
+} plan_t;
+
+// all of the tables so far (guarded by 'plan_mx')
+static plan_t* plan_list = NULL;
+static pthread_mutex_t plan_mx = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* files */
+
+// return the checksum of the tables (64 bit FNV-1a, over each word)
+static uint64_t plan_sum(const void* data, size_t size) {
+    const uint64_t* W = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i;
+    for (i = 0; i < size / 8; ++i) h = (h ^ W[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+// return the file of the tables (which the caller frees), or NULL if they aren't kept in files
+static char* plan_path(int kind, int64_t len) {
+    if (mpt_plan_dir == NULL || !*mpt_plan_dir) return NULL;
+    size_t sz = strlen(mpt_plan_dir) + 64;
+    char* path = malloc(sz);
+    snprintf(path, sz, "%s/%s-%lli.plan", mpt_plan_dir, kind == MPT_PLAN_NTT ? "ntt" : "fft", (long long int)len);
+    return path;
+}
+
+// map the tables of 'pl' from its file, and return whether they were valid
+static bool plan_map(plan_t* pl) {
+    char* path = plan_path(pl->kind, pl->len);
+    if (path == NULL) return false;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(path);
+        return false;
+    }
+
+    const char* why = NULL;
+    size_t total = MPT_ALIGN + pl->size;
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != total) {
+        why = "wrong size";
+    } else if ((map = mmap(NULL, total, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        why = "couldn't map it";
+    } else {
+        const plan_hdr_t* hdr = map;
+        if (hdr->magic != PLAN_MAGIC) {
+            why = "not a plan file";
+        } else if (hdr->version != MPT_PLAN_VERSION) {
+            why = "unknown version";
+        } else if (hdr->kind != (uint64_t)pl->kind || hdr->len != pl->len || hdr->size != pl->size) {
+            why = "wrong transform";
+        } else if (hdr->sum != plan_sum((char*)map + MPT_ALIGN, pl->size)) {
+            why = "bad checksum";
+        }
+    }
+    close(fd);
+
+    if (why != NULL) {
+        fprintf(stderr, "[MPT_warn]: Ignoring plan file '%s' (%s)\n", path, why);
+        if (map != MAP_FAILED) munmap(map, total);
+        free(path);
+        return false;
+    }
+
+    pl->map = map;
+    pl->data = (char*)map + MPT_ALIGN;
+    free(path);
+    return true;
+}
+
+// write the tables of 'pl' to its file (if they are kept in files), and return whether they were written
+static bool plan_write(plan_t* pl) {
+    char* path = plan_path(pl->kind, pl->len);
+    if (path == NULL) return false;
+    size_t tsz = strlen(path) + 32;
+    char* tmp = malloc(tsz);
+
+    // (each process has its own temporary file, since several may write the same tables at once)
+    snprintf(tmp, tsz, "%s.%lli.tmp", path, (long long int)getpid());
+
+    char hdr[MPT_ALIGN];
+    memset(hdr, 0, sizeof(hdr));
+    plan_hdr_t h = { PLAN_MAGIC, MPT_PLAN_VERSION, (uint64_t)pl->kind, pl->len, pl->size, plan_sum(pl->data, pl->size) };
+    memcpy(hdr, &h, sizeof(h));
+
+    bool ok = false;
+    FILE* fp = fopen(tmp, "wb");
+    if (fp != NULL) {
+        ok = fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr) && fwrite(pl->data, 1, pl->size, fp) == pl->size;
+        ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+        ok = (fclose(fp) == 0) && ok;
+        ok = ok && rename(tmp, path) == 0;
+        if (!ok) remove(tmp);
+    }
+    if (!ok) fprintf(stderr, "[MPT_warn]: Couldn't write plan file '%s'\n", path);
+
+    free(tmp);
+    free(path);
+    return ok;
+}
+
+
+/* cache */
+
+const void* mpt_plan_get(int kind, int64_t len, size_t size, mpt_plan_fill_t fill) {
+    // (the tables are read as 64 bit words, for the checksum)
+    size = (size + 7) / 8 * 8;
+
+    pthread_mutex_lock(&plan_mx);
+
+    plan_t* pl;
+    for (pl = plan_list; pl != NULL; pl = pl->next) {
+        if (pl->kind == kind && pl->len == len && pl->size == size) break;
+    }
+
+    if (pl == NULL) {
+        pl = malloc(sizeof(*pl));
+        pl->kind = kind;
+        pl->len = len;
+        pl->size = size;
+        pl->map = NULL;
+
+        if (!plan_map(pl)) {
+            pl->data = mpt_alloc_aligned(size);
+            if (pl->data == NULL) {
+                fprintf(stderr, "[MPT_error]: Couldn't allocate %llu bytes of tables\n", (unsigned long long int)size);
+                exit(1);
+            }
+            // (zeroed first, so any padding has a fixed checksum)
+            memset(pl->data, 0, size);
+            fill(pl->data, len);
+
+            // once it is written, use the file too, so it is shared with the other processes
+            if (plan_write(pl)) {
+                void* data = pl->data;
+                if (plan_map(pl)) free(data);
+                else pl->data = data;
+            }
+        }
+
+        pl->next = plan_list;
+        plan_list = pl;
+    }
+
+    pthread_mutex_unlock(&plan_mx);
+    return pl->data;
+}
+
+void mpt_plan_clear() {
+    pthread_mutex_lock(&plan_mx);
+    while (plan_list != NULL) {
+        plan_t* pl = plan_list;
+        plan_list = pl->next;
+        if (pl->map != NULL) munmap(pl->map, MPT_ALIGN + pl->size);
+        else free(pl->data);
+        free(pl);
+    }
+    pthread_mutex_unlock(&plan_mx);
+}
@@ -0,0 +1,278 @@
+/* pm1.c - Pollard's P-1 factoring of 2^p - 1
+ *
+ * If 'q' is a factor of 2^p - 1, then q - 1 == 2kp, and 3^(q-1) == 1 (mod q). So, if 'k' is B1-smooth, then
+ *   x = 3^(2p * E) (mod 2^p - 1), where 'E' is the product of all the prime powers up to B1, is 1 (mod q), and
+ *   gcd(x - 1, 2^p - 1) finds 'q' (stage 1)
+ *
+ * Stage 2 finds 'q' if 'k' is B1-smooth except for a single prime 's' in (B1, B2]. Each 's' is written as
+ *   kD - j or kD + j (with 0 < j < D/2, and 'j' coprime to 'D'), so x^s == 1 (mod q) means that
+ *   x^((kD)^2) - x^(j^2) == x^(j^2) * (x^((kD-j)(kD+j)) - 1) == 0 (mod q), and so the primes kD - j and kD + j
+ *   are both covered by a single multiplication (prime pairing). The x^(j^2) are the baby steps (which are all
+ *   kept), the x^((kD)^2) are the giant steps, and both are stepped with finite differences (2 multiplications
+ *   each), so nothing needs to be exponentiated in the main loop
+ *
+ * All of the arithmetic is with 'mpt_sqr_mod' and 'mpt_mul_mod', so it runs as fast as the LL test does
+ *
+ */
+
+#include "MPT-impl.h"
+
+#include <math.h>
+
+
+// the stage 2 block sizes (and how many baby steps they need, phi(D)/2)
+#define PM1_D_SMALL 210
+#define PM1_D_LARGE 2310
+
+// the most memory (in bytes) the baby steps may take for 'PM1_D_LARGE' to be used
+#define PM1_BABY_MEM ((int64_t)1 << 28)
+
+
+/* utils */
+
+// return a table of whether each number up to 'n' is prime (free it with 'free()')
+static bool* pm1_sieve(int64_t n) {
+    bool* isp = malloc(n + 1);
+    int64_t i, j;
+    for (i = 0; i <= n; ++i) isp[i] = i >= 2;
+    for (i = 2; i * i <= n; ++i) {
+        if (!isp[i]) continue;
+        for (j = i * i; j <= n; j += i) isp[j] = false;
+    }
+    return isp;
+}
+
+// approximate number of primes up to 'x'
+static double pm1_pi(double x) {
+    return x < 3 ? 1 : x / (log(x) - 1);
+}
+
+// approximate cost of P-1 with bounds 'B1' and 'B2' (in squarings mod 2^p - 1)
+static double pm1_cost(int64_t B1, int64_t B2) {
+    // stage 1 is a squaring per bit of 'E' (about 1.44 bits per number up to B1), and stage 2 is a multiplication
+    //   (2 squarings) per prime pair, and about 80% of the primes need their own pair
+    return 1.44 * B1 + 1.6 * (pm1_pi(B2) - pm1_pi(B1));
+}
+
+// R = X^e (mod 2^p - 1), where 'X' is reduced, and e > 0
+// NOTE: 'R' and 'X' must not overlap
+static void pm1_pow(int64_t p, mpt_limb_t* X, uint64_t e, mpt_limb_t* R, mpt_limb_t* T) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    memcpy(R, X, N * MPT_LIMB_SIZE);
+
+    int i;
+    for (i = 62 - __builtin_clzll(e); i >= 0; --i) {
+        mpt_sqr_mod(p, R, 0, T);
+        if ((e >> i) & 1) mpt_mul_mod(p, R, X, R, T);
+    }
+}
+
+// return whether 'X' has a nontrivial common factor with 2^p - 1, and if so, store it in 'F'
+static bool pm1_gcd(int64_t p, mpt_limb_t* X, mpt_limb_t* F) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    mpt_limb_t* A = malloc(N * MPT_LIMB_SIZE), *M = F;
+    mpt_set_0(M, N);
+    mpt_set_Mp(M, p);
+
+    mpt_gcd_n(N, X, M, F);
+
+    // 1 means no factor, and 2^p - 1 (from X == 0) means all of them at once (which shows nothing)
+    mpt_set_0(A, N);
+    A[0] = 1;
+    bool res = mpt_cmp(N, F, A) != 0;
+    mpt_set_0(A, N);
+    mpt_set_Mp(A, p);
+    res = res && mpt_cmp(N, F, A) != 0;
+
+    free(A);
+    return res;
+}
+
+
+/* stages */
+
+// X = 3^(2p * E) (mod 2^p - 1), where 'E' is the product of the largest power of each prime up to 'B1'
+static void pm1_stage1(int64_t p, int64_t B1, bool* isp, mpt_limb_t* X, mpt_limb_t* T) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+
+    // build the exponent (in 64 bit words, which is about 1.44 * B1 bits), multiplying by as many prime powers as
+    //   fit in a word at once
+    int64_t NE = (int64_t)(1.6 * B1 / 64) + 4, ne = 1;
+    uint64_t* E = malloc(NE * sizeof(*E));
+    E[0] = 2 * p;
+
+    uint64_t m = 1;
+    int64_t q;
+    for (q = 2; q <= B1 + 1; ++q) {
+        uint64_t qk = 1;
+        if (q <= B1) {
+            if (!isp[q]) continue;
+
+            // the largest power of 'q' that is at most B1
+            qk = q;
+            while (qk <= (uint64_t)(B1 / q)) qk *= q;
+            if (m <= UINT64_MAX / qk) {
+                m *= qk;
+                continue;
+            }
+        }
+
+        // E = E * m
+        uint64_t c = 0, hi;
+        int64_t i;
+        for (i = 0; i < ne; ++i) {
+            E[i] = mpt_mul64(E[i], m, &hi) + c;
+            c = hi + (E[i] < c);
+        }
+        if (c) E[ne++] = c;
+        m = qk;
+    }
+
+    // left to right, and the multiplication by 3 is just x + 2x (which is reduced without a squaring)
+    mpt_limb_t* U = malloc((N + 1) * MPT_LIMB_SIZE);
+    mpt_set_0(X, N);
+    X[0] = 1;
+
+    int64_t i;
+    int j;
+    for (i = ne - 1; i >= 0; --i) {
+        for (j = 63; j >= 0; --j) {
+            mpt_sqr_mod(p, X, 0, T);
+            if ((E[i] >> j) & 1) {
+                U[N] = mpt_lshift(N, U, X, 1);
+                U[N] += mpt_add_n(N, U, U, X);
+                mpt_mod2pm1(N + 1, U, X, p);
+            }
+        }
+    }
+
+    free(U);
+    free(E);
+}
+
+// return whether stage 2 (for the primes in (B1, B2]) finds a factor, which is stored in 'F'
+static bool pm1_stage2(int64_t p, int64_t B1, int64_t B2, bool* isp, mpt_limb_t* X, mpt_limb_t* F, mpt_limb_t* T) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    int64_t D = PM1_D_SMALL;
+    if ((B2 - B1) / PM1_D_LARGE >= 20 && 240 * N * MPT_LIMB_SIZE <= PM1_BABY_MEM) D = PM1_D_LARGE;
+
+    // the 'j' that are coprime to 'D', and their baby steps, x^(j^2)
+    int64_t nb = 0, j;
+    int64_t* J = malloc((D / 2) * sizeof(*J));
+    for (j = 1; j < D / 2; j += 2) {
+        if (j % 3 != 0 && j % 5 != 0 && j % 7 != 0 && (D == PM1_D_SMALL || j % 11 != 0)) J[nb++] = j;
+    }
+
+    mpt_limb_t* bs = malloc((nb + 5) * N * MPT_LIMB_SIZE);
+    mpt_limb_t* Y = &bs[nb * N], *dY = &bs[(nb + 1) * N], *d2 = &bs[(nb + 2) * N];
+    mpt_limb_t* G = &bs[(nb + 3) * N], *acc = &bs[(nb + 4) * N];
+
+    // x^(j^2) for each odd 'j', with (j+2)^2 - j^2 == 4j + 4, which steps by 8
+    memcpy(Y, X, N * MPT_LIMB_SIZE);
+    pm1_pow(p, X, 8, dY, T);
+    memcpy(d2, dY, N * MPT_LIMB_SIZE);
+    int64_t b = 0;
+    for (j = 1; b < nb; j += 2) {
+        if (j == J[b]) memcpy(&bs[(b++) * N], Y, N * MPT_LIMB_SIZE);
+        mpt_mul_mod(p, Y, dY, Y, T);
+        mpt_mul_mod(p, dY, d2, dY, T);
+    }
+
+    // the giant steps, x^((kD)^2), with ((k+1)D)^2 - (kD)^2 == (2k + 1)D^2, which steps by 2D^2
+    int64_t k = B1 / D, k1 = (B2 + D / 2) / D;
+    if (k == 0) {
+        mpt_set_0(G, N);
+        G[0] = 1;
+    } else {
+        pm1_pow(p, X, (uint64_t)(k * D) * (uint64_t)(k * D), G, T);
+    }
+    pm1_pow(p, X, (uint64_t)(2 * k + 1) * D * D, dY, T);
+    pm1_pow(p, X, (uint64_t)2 * D * D, d2, T);
+
+    mpt_set_0(acc, N);
+    acc[0] = 1;
+    for (; k <= k1; ++k) {
+        for (b = 0; b < nb; ++b) {
+            int64_t s0 = k * D - J[b], s1 = k * D + J[b];
+            bool u0 = s0 > B1 && s0 <= B2 && isp[s0], u1 = s1 > B1 && s1 <= B2 && isp[s1];
+            if (!u0 && !u1) continue;
+
+            mpt_sub_mod(p, G, &bs[b * N], Y);
+            mpt_mul_mod(p, acc, Y, acc, T);
+        }
+
+        mpt_mul_mod(p, G, dY, G, T);
+        mpt_mul_mod(p, dY, d2, dY, T);
+    }
+
+    bool res = pm1_gcd(p, acc, F);
+
+    free(bs);
+    free(J);
+    return res;
+}
+
+
+/* P-1 */
+
+void mpt_pm1_bounds(int64_t p, int64_t* B1, int64_t* B2) {
+    // the largest B1 that fits in the budget
+    double budget = MPT_PM1_COST * p;
+    int64_t b1 = 0;
+    while (b1 < MPT_PM1_MAXB2 / MPT_PM1_B2 && pm1_cost(b1 + 1000, MPT_PM1_B2 * (b1 + 1000)) <= budget) b1 += 1000;
+    while (b1 < MPT_PM1_MAXB2 / MPT_PM1_B2 && pm1_cost(b1 + 1, MPT_PM1_B2 * (b1 + 1)) <= budget) b1 += 1;
+
+    // too small to be worth it
+    if (b1 < 11) b1 = 0;
+
+    *B1 = b1;
+    *B2 = MPT_PM1_B2 * b1;
+}
+
+bool mpt_pm1(mpt_pm1_t* pm1, int64_t p, int64_t B1, int64_t B2) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    if (B2 > MPT_PM1_MAXB2) B2 = MPT_PM1_MAXB2;
+    if (B2 < B1) B2 = B1;
+
+    pm1->p = p;
+    pm1->B1 = B1;
+    pm1->B2 = B2;
+    pm1->found = false;
+    pm1->stage = 0;
+    pm1->f = NULL;
+    if (p < 3 || B1 < 2) return false;
+
+    bool* isp = pm1_sieve(B2);
+    mpt_limb_t* X = malloc(2 * N * MPT_LIMB_SIZE), *F = &X[N];
+    mpt_limb_t* T = malloc(mpt_mod_scratch(p) * MPT_LIMB_SIZE);
+
+    pm1_stage1(p, B1, isp, X, T);
+
+    // gcd(x - 1, 2^p - 1), where 'x' is never 0 (since 3 is coprime to 2^p - 1)
+    mpt_subl(N, X, 1);
+    bool f1 = pm1_gcd(p, X, F);
+    mpt_addl(N, X, 1);
+    if (f1) {
+        pm1->found = true;
+        pm1->stage = 1;
+    } else if (B1 >= 11 && B2 > B1 && pm1_stage2(p, B1, B2, isp, X, F, T)) {
+        // (below 11, there are primes that share a factor with 'D', so stage 2 is skipped)
+        pm1->found = true;
+        pm1->stage = 2;
+    }
+
+    if (pm1->found) {
+        pm1->f = malloc(N * MPT_LIMB_SIZE);
+        memcpy(pm1->f, F, N * MPT_LIMB_SIZE);
+    }
+
+    free(T);
+    free(X);
+    free(isp);
+    return pm1->found;
+}
+
+void mpt_pm1_free(mpt_pm1_t* pm1) {
+    free(pm1->f);
+    pm1->f = NULL;
+}
@@ -0,0 +1,182 @@
+/* prog.c - progress lines, and per-phase timing, of a long test
+ *
+ * Everything here is off by default, and an engine only checks a flag (in 'mpt_prog_due' and 'MPT_PROG_PHASE')
+ *   each iteration when it is. When progress lines are on, the clock is only read every so often (at about when
+ *   the next line is due, from the rate so far), so it costs nothing next to an iteration
+ *
+ * The phases are counted with the time stamp counter (in cycles), and the hardware counters (if they are on)
+ *   are read with 'perf_event_open', for just the thread that runs the test
+ *
+ */
+
+// for 'syscall'
+#define _GNU_SOURCE
+
+#include "MPT-impl.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+double mpt_prog_interval = 0.0;
+bool mpt_prog_cycles = false;
+bool mpt_prog_perf = false;
+
+// the names of the phases
+static const char* prog_phase_names[MPT_PHASE_N] = { "square", "reduce+subtract" };
+
+
+/* hardware counters */
+
+#ifdef __linux__
+
+// open a counter (of 'type' and 'config') for this thread, and return its file descriptor (or -1)
+static int prog_perf_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = type;
+    a.config = config;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+#endif
+
+// read the hardware counters of 'pr' into 'v'
+static void prog_perf_read(mpt_prog_t* pr, uint64_t* v) {
+    int k;
+    for (k = 0; k < MPT_PROG_NPERF; ++k) {
+        v[k] = 0;
+#ifdef __linux__
+        if (pr->fd[k] >= 0 && read(pr->fd[k], &v[k], sizeof(v[k])) != sizeof(v[k])) v[k] = 0;
+#endif
+    }
+}
+
+// start the hardware counters of 'pr' (if they are on, and the kernel allows it)
+static void prog_perf_init(mpt_prog_t* pr) {
+    int k;
+    for (k = 0; k < MPT_PROG_NPERF; ++k) pr->fd[k] = -1;
+    if (!mpt_prog_perf) return;
+
+#ifdef __linux__
+    pr->fd[MPT_PERF_CYCLES] = prog_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pr->fd[MPT_PERF_INSNS] = prog_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pr->fd[MPT_PERF_LLC_MISS] = prog_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    pr->fd[MPT_PERF_L1D_MISS] = prog_perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+
+    if (pr->fd[MPT_PERF_CYCLES] < 0) {
+        fprintf(stderr, "[MPT_warn]: Couldn't open the hardware counters (see '/proc/sys/kernel/perf_event_paranoid'), so they won't be shown\n");
+    }
+    prog_perf_read(pr, pr->perf0);
+    memcpy(pr->perf1, pr->perf0, sizeof(pr->perf0));
+}
+
+
+/* progress */
+
+void mpt_prog_init(mpt_prog_t* pr, int64_t p, int64_t niter, const char* engine, int64_t i0) {
+    pr->cycles = mpt_prog_cycles;
+    pr->active = mpt_prog_interval > 0 || mpt_prog_cycles || mpt_prog_perf;
+    pr->p = p;
+    pr->niter = niter;
+    pr->engine = engine;
+    memset(pr->cyc, 0, sizeof(pr->cyc));
+    if (!pr->active) return;
+
+    prog_perf_init(pr);
+    mpt_prog_start(pr, i0);
+}
+
+void mpt_prog_start(mpt_prog_t* pr, int64_t i0) {
+    if (!pr->active) return;
+
+    pr->i0 = pr->ilast = i0;
+    pr->start = pr->last = mpt_time();
+    pr->tsc0 = mpt_rdtsc();
+    pr->step = 1;
+    pr->next = mpt_prog_interval > 0 ? i0 + 1 : INT64_MAX;
+}
+
+bool mpt_prog_poll(mpt_prog_t* pr, int64_t i) {
+    double dt = mpt_time() - pr->last;
+    if (dt >= mpt_prog_interval) return true;
+
+    // not yet, so look again at about when it will be (at the rate so far), but at most twice as far as last time
+    int64_t est = dt > 0 ? (int64_t)((i - pr->ilast) / dt * (mpt_prog_interval - dt)) : 0;
+    pr->step = est < 2 * pr->step ? est : 2 * pr->step;
+    if (pr->step < 1) pr->step = 1;
+    pr->next = i + pr->step;
+    return false;
+}
+
+void mpt_prog_report(mpt_prog_t* pr, int64_t i, mpt_limb_t* S) {
+    double now = mpt_time();
+    int64_t N = pr->p / MPT_LIMB_BITS + 1, j;
+
+    // the rate since the last line, and the time left at the rate since the start
+    double rate = (i - pr->ilast) / (now - pr->last + 1.0e-9);
+    double avg = (i - pr->i0) / (now - pr->start + 1.0e-9);
+    double eta = avg > 0 ? (pr->niter - i) / avg : 0;
+
+    uint64_t res64 = 0;
+    for (j = 0; j < N && j * MPT_LIMB_BITS < 64; ++j) res64 |= (uint64_t)S[j] << (j * MPT_LIMB_BITS);
+
+    char ipc[64] = "";
+    if (pr->fd[MPT_PERF_CYCLES] >= 0 && pr->fd[MPT_PERF_INSNS] >= 0) {
+        uint64_t v[MPT_PROG_NPERF];
+        prog_perf_read(pr, v);
+        uint64_t dc = v[MPT_PERF_CYCLES] - pr->perf1[MPT_PERF_CYCLES], di = v[MPT_PERF_INSNS] - pr->perf1[MPT_PERF_INSNS];
+        snprintf(ipc, sizeof(ipc), ", IPC %.2lf", dc > 0 ? (double)di / dc : 0.0);
+        memcpy(pr->perf1, v, sizeof(v));
+    }
+
+    int64_t s = (int64_t)eta;
+    fprintf(stderr, "[MPT_info]: M%lli (%s): iteration %lli/%lli (%.2lf%%), %.1lf iter/s, ETA %lli:%02i:%02i, res64 %016llx%s\n", (long long int)pr->p, pr->engine, (long long int)i, (long long int)pr->niter, 100.0 * i / pr->niter, rate, (long long int)(s / 3600), (int)(s / 60 % 60), (int)(s % 60), (unsigned long long int)res64, ipc);
+
+    pr->last = now;
+    pr->ilast = i;
+    pr->next = i + pr->step;
+}
+
+void mpt_prog_free(mpt_prog_t* pr, int64_t i) {
+    if (!pr->active) return;
+
+    int64_t n = i - pr->i0;
+    if (n <= 0) n = 1;
+
+    // where the cycles went (the rest is checkpoints, progress lines, and anything else in the loop)
+    if (pr->cycles) {
+        uint64_t tot = mpt_rdtsc() - pr->tsc0, sum = 0;
+        char buf[256];
+        int len = 0, k;
+        for (k = 0; k < MPT_PHASE_N; ++k) {
+            len += snprintf(&buf[len], sizeof(buf) - len, "%s %.1lf%%, ", prog_phase_names[k], 100.0 * pr->cyc[k] / (tot + 1));
+            sum += pr->cyc[k];
+        }
+        snprintf(&buf[len], sizeof(buf) - len, "other %.1lf%%", 100.0 * (tot > sum ? tot - sum : 0) / (tot + 1));
+        fprintf(stderr, "[MPT_info]: M%lli (%s): %.0lf cycles/iter: %s\n", (long long int)pr->p, pr->engine, (double)tot / n, buf);
+    }
+
+    if (pr->fd[MPT_PERF_CYCLES] >= 0) {
+        uint64_t v[MPT_PROG_NPERF];
+        prog_perf_read(pr, v);
+        int k;
+        for (k = 0; k < MPT_PROG_NPERF; ++k) v[k] -= pr->perf0[k];
+        fprintf(stderr, "[MPT_info]: M%lli (%s): IPC %.2lf, %.1lf cache misses/iter, %.1lf L1D misses/iter\n", (long long int)pr->p, pr->engine, v[MPT_PERF_CYCLES] > 0 ? (double)v[MPT_PERF_INSNS] / v[MPT_PERF_CYCLES] : 0.0, (double)v[MPT_PERF_LLC_MISS] / n, (double)v[MPT_PERF_L1D_MISS] / n);
+    }
+
+#ifdef __linux__
+    int k;
+    for (k = 0; k < MPT_PROG_NPERF; ++k) {
+        if (pr->fd[k] >= 0) close(pr->fd[k]);
+    }
+#endif
+    pr->active = false;
+}
@@ -0,0 +1,465 @@
+/* proof.c - Pietrzak proofs of the PRP test, which can be verified with a small fraction of its squarings
+ *
+ * The PRP test computes B = 3^(2^T) (mod 2^p - 1), with T = s * 2^k (the largest one that is at most 'p'), and the
+ *   rest of the squarings up to 'p' are cheap enough to just be redone. A proof of 'B' has 'k' levels: the claim
+ *   A^(2^t) == B is halved with the middle M = A^(2^(t/2)), and the two halves are combined into a single claim
+ *   (A^r * M)^(2^(t/2)) == M^r * B, where 'r' is a hash of everything before it (Fiat-Shamir), so the prover can't
+ *   pick a bad 'M' that happens to work. After 'k' levels, the claim is checked directly, with 's' squarings
+ *
+ * So, the verifier does 's' squarings, plus 2 exponentiations by a 64 bit 'r' per level, instead of 'p' squarings
+ *
+ * To build the proof, the PRP test writes the term after every 's' iterations (2^k terms in all) to a file next
+ *   to the proof (they are too big to keep in memory), and each middle is a product of some of them, with the
+ *   exponents from the 'r's that came before it, which is built as a tree (an exponentiation and a
+ *   multiplication at each node), so it costs about 2^k exponentiations in all
+ *
+ * The 'r's are the first 64 bits of SHA3-256 hashes, of the header and 'B' for the first one, and then of the last
+ *   hash and each middle
+ *
+ */
+
+// for 'fseeko' and 'off_t'
+#define _POSIX_C_SOURCE 200809L
+
+#include "MPT-impl.h"
+
+#include <sys/types.h>
+
+
+// the magic bytes at the start of each file
+static const char proof_magic[8] = { 'M', 'P', 'T', 'P', 'R', 'O', 'O', 'F' };
+
+const char* mpt_proof_dir = NULL;
+
+
+/* SHA3-256 */
+
+// the state of a hash
+typedef struct {
+    uint64_t st[25];
+    int pos;
+} proof_sha3_t;
+
+// the round constants, and the rotations and lane order of rho and pi
+static const uint64_t proof_rc[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL,
+};
+static const int proof_rot[24] = { 1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44 };
+static const int proof_pi[24] = { 10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1 };
+
+// the rate of SHA3-256 (in bytes)
+#define PROOF_RATE 136
+
+static uint64_t proof_rotl(uint64_t x, int n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+// the Keccak-f[1600] permutation
+static void proof_keccak(uint64_t* st) {
+    uint64_t bc[5], t;
+    int r, i, j;
+    for (r = 0; r < 24; ++r) {
+        // theta
+        for (i = 0; i < 5; ++i) bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+        for (i = 0; i < 5; ++i) {
+            t = bc[(i + 4) % 5] ^ proof_rotl(bc[(i + 1) % 5], 1);
+            for (j = 0; j < 25; j += 5) st[j + i] ^= t;
+        }
+
+        // rho and pi
+        t = st[1];
+        for (i = 0; i < 24; ++i) {
+            j = proof_pi[i];
+            bc[0] = st[j];
+            st[j] = proof_rotl(t, proof_rot[i]);
+            t = bc[0];
+        }
+
+        // chi
+        for (j = 0; j < 25; j += 5) {
+            for (i = 0; i < 5; ++i) bc[i] = st[j + i];
+            for (i = 0; i < 5; ++i) st[j + i] ^= ~bc[(i + 1) % 5] & bc[(i + 2) % 5];
+        }
+
+        // iota
+        st[0] ^= proof_rc[r];
+    }
+}
+
+static void proof_sha3_init(proof_sha3_t* h) {
+    memset(h->st, 0, sizeof(h->st));
+    h->pos = 0;
+}
+
+static void proof_sha3_bytes(proof_sha3_t* h, const uint8_t* b, int64_t n) {
+    int64_t i;
+    for (i = 0; i < n; ++i) {
+        h->st[h->pos / 8] ^= (uint64_t)b[i] << (8 * (h->pos % 8));
+        if (++h->pos == PROOF_RATE) {
+            proof_keccak(h->st);
+            h->pos = 0;
+        }
+    }
+}
+
+// hash 'n' 64 bit words (as little endian bytes)
+static void proof_sha3_words(proof_sha3_t* h, const uint64_t* W, int64_t n) {
+    uint8_t b[8];
+    int64_t i;
+    int j;
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < 8; ++j) b[j] = (uint8_t)(W[i] >> (8 * j));
+        proof_sha3_bytes(h, b, 8);
+    }
+}
+
+// finish the hash, and store the 32 byte digest in 'out'
+static void proof_sha3_final(proof_sha3_t* h, uint8_t* out) {
+    h->st[h->pos / 8] ^= (uint64_t)0x06 << (8 * (h->pos % 8));
+    h->st[(PROOF_RATE - 1) / 8] ^= (uint64_t)0x80 << (8 * ((PROOF_RATE - 1) % 8));
+    proof_keccak(h->st);
+
+    int i;
+    for (i = 0; i < 32; ++i) out[i] = (uint8_t)(h->st[i / 8] >> (8 * (i % 8)));
+}
+
+
+/* utils */
+
+// the header (all integers are little endian): magic[8], version (u32), p (i64), k (u32)
+#define PROOF_HEADER_LEN (8 + 4 + 8 + 4)
+
+static void proof_header(uint8_t* hdr, int64_t p, int k) {
+    int i;
+    memcpy(hdr, proof_magic, 8);
+    for (i = 0; i < 4; ++i) hdr[8 + i] = (uint8_t)((uint32_t)MPT_PROOF_VERSION >> (8 * i));
+    for (i = 0; i < 8; ++i) hdr[12 + i] = (uint8_t)((uint64_t)p >> (8 * i));
+    for (i = 0; i < 4; ++i) hdr[20 + i] = (uint8_t)((uint32_t)k >> (8 * i));
+}
+
+// the next 'r' in the hash chain 'hash' (32 bytes, which is updated), after the 'n' words in 'W'
+static uint64_t proof_next_r(uint8_t* hash, const uint64_t* W, int64_t n) {
+    proof_sha3_t h;
+    proof_sha3_init(&h);
+    proof_sha3_bytes(&h, hash, 32);
+    proof_sha3_words(&h, W, n);
+    proof_sha3_final(&h, hash);
+
+    uint64_t r = 0;
+    int i;
+    for (i = 0; i < 8; ++i) r |= (uint64_t)hash[i] << (8 * i);
+    return r;
+}
+
+// pack 'X' (with (p / MPT_LIMB_BITS + 1) limbs) into the 'n' words of 'W'
+static void proof_pack(int64_t p, int64_t n, mpt_limb_t* X, uint64_t* W) {
+    int64_t N = p / MPT_LIMB_BITS + 1, i;
+    memset(W, 0, n * sizeof(*W));
+    for (i = 0; i < N; ++i) W[i * MPT_LIMB_BITS / 64] |= (uint64_t)X[i] << (i * MPT_LIMB_BITS % 64);
+}
+
+// unpack the 'n' words of 'W' into 'X'
+static void proof_unpack(int64_t p, uint64_t* W, mpt_limb_t* X) {
+    int64_t N = p / MPT_LIMB_BITS + 1, i;
+    for (i = 0; i < N; ++i) X[i] = (mpt_limb_t)(W[i * MPT_LIMB_BITS / 64] >> (i * MPT_LIMB_BITS % 64));
+}
+
+// write the 'n' words of 'W' to 'fp', and return whether it worked
+static bool proof_write_words(FILE* fp, const uint64_t* W, int64_t n) {
+    uint8_t b[8];
+    int64_t i;
+    int j;
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < 8; ++j) b[j] = (uint8_t)(W[i] >> (8 * j));
+        if (fwrite(b, 1, 8, fp) != 8) return false;
+    }
+    return true;
+}
+
+// read 'n' words from 'fp' into 'W', and return whether it worked
+static bool proof_read_words(FILE* fp, uint64_t* W, int64_t n) {
+    uint8_t b[8];
+    int64_t i;
+    int j;
+    for (i = 0; i < n; ++i) {
+        if (fread(b, 1, 8, fp) != 8) return false;
+        W[i] = 0;
+        for (j = 0; j < 8; ++j) W[i] |= (uint64_t)b[j] << (8 * j);
+    }
+    return true;
+}
+
+// R = X^e (mod 2^p - 1), where 'X' is reduced
+// NOTE: 'R' and 'X' must not overlap
+static void proof_pow(int64_t p, mpt_limb_t* X, uint64_t e, mpt_limb_t* R, mpt_limb_t* T) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    mpt_set_0(R, N);
+    R[0] = 1;
+    if (e == 0) return;
+
+    memcpy(R, X, N * MPT_LIMB_SIZE);
+    int i;
+    for (i = 62 - __builtin_clzll(e); i >= 0; --i) {
+        mpt_sqr_mod(p, R, 0, T);
+        if ((e >> i) & 1) mpt_mul_mod(p, R, X, R, T);
+    }
+}
+
+
+/* proving */
+
+int mpt_proof_power(int64_t p) {
+    // about sqrt(p) / 4 steps of 's' (so the verifier does about 4 * sqrt(p) squarings)
+    int k = (63 - __builtin_clzll((uint64_t)p)) / 2 - 2;
+    if (k < 1) k = 1;
+    if (k > MPT_PROOF_MAXPOWER) k = MPT_PROOF_MAXPOWER;
+    return k;
+}
+
+bool mpt_proof_init(mpt_proof_t* pf, int64_t p, bool resumed) {
+    pf->active = mpt_proof_dir != NULL && *mpt_proof_dir;
+    if (!pf->active) return false;
+
+    pf->p = p;
+    pf->k = mpt_proof_power(p);
+    pf->s = p >> pf->k;
+    pf->n = (p + 63) / 64;
+
+    size_t len = strlen(mpt_proof_dir) + 40;
+    pf->path = malloc(len);
+    pf->res = malloc(len + 4);
+    snprintf(pf->path, len, "%s/M%lli.proof", mpt_proof_dir, (long long int)p);
+    snprintf(pf->res, len + 4, "%s.res", pf->path);
+
+    // a resumed test needs the terms from before it was stopped
+    pf->fp = fopen(pf->res, resumed ? "r+b" : "w+b");
+    if (pf->fp == NULL) {
+        fprintf(stderr, "[MPT_warn]: Couldn't open '%s', so there won't be a proof of M%lli\n", pf->res, (long long int)p);
+        free(pf->path);
+        free(pf->res);
+        pf->active = false;
+        return false;
+    }
+
+    pf->W = malloc(pf->n * sizeof(*pf->W));
+    return true;
+}
+
+void mpt_proof_step(mpt_proof_t* pf, int64_t i, mpt_limb_t* X) {
+    if (!pf->active || i % pf->s != 0 || i == 0 || i > (pf->s << pf->k)) return;
+
+    // (flushed right away, so a test that is killed and resumed from a checkpoint still has it)
+    proof_pack(pf->p, pf->n, X, pf->W);
+    if (fseeko(pf->fp, (off_t)(i / pf->s - 1) * pf->n * 8, SEEK_SET) != 0 || !proof_write_words(pf->fp, pf->W, pf->n) || fflush(pf->fp) != 0) {
+        fprintf(stderr, "[MPT_warn]: Couldn't write to '%s', so there won't be a proof of M%lli\n", pf->res, (long long int)pf->p);
+        mpt_proof_free(pf, false);
+    }
+}
+
+// read the term after 'j * s' iterations into 'X'
+static bool proof_read(mpt_proof_t* pf, int64_t j, mpt_limb_t* X) {
+    if (fseeko(pf->fp, (off_t)(j - 1) * pf->n * 8, SEEK_SET) != 0 || !proof_read_words(pf->fp, pf->W, pf->n)) return false;
+    proof_unpack(pf->p, pf->W, X);
+    return true;
+}
+
+// R = the product of the middles of the segments under node 'c' (at depth 'd') of level 'i', where the lower half
+//   of each split (at depth 'e') is raised to r[e + 1], and 'B' has (i - d) * N limbs of scratch space
+static bool proof_tree(mpt_proof_t* pf, int i, int d, int64_t c, uint64_t* r, mpt_limb_t* R, mpt_limb_t* B, mpt_limb_t* T) {
+    if (d == i - 1) return proof_read(pf, (2 * c + 1) << (pf->k - i), R);
+
+    int64_t N = pf->p / MPT_LIMB_BITS + 1;
+    if (!proof_tree(pf, i, d + 1, 2 * c, r, B, &B[N], T)) return false;
+    proof_pow(pf->p, B, r[d + 1], R, T);
+    if (!proof_tree(pf, i, d + 1, 2 * c + 1, r, B, &B[N], T)) return false;
+    mpt_mul_mod(pf->p, R, B, R, T);
+    return true;
+}
+
+// build the proof from the terms, and write it to 'pf->path'
+static bool proof_build(mpt_proof_t* pf) {
+    int64_t p = pf->p, N = p / MPT_LIMB_BITS + 1;
+    int k = pf->k, i;
+    mpt_limb_t* M = malloc((k + 1) * N * MPT_LIMB_SIZE), *B = &M[N];
+    mpt_limb_t* T = malloc(mpt_mod_scratch(p) * MPT_LIMB_SIZE);
+    uint64_t r[MPT_PROOF_MAXPOWER + 1];
+    uint8_t hdr[PROOF_HEADER_LEN], hash[32];
+
+    size_t len = strlen(pf->path) + 8;
+    char* tmp = malloc(len);
+    snprintf(tmp, len, "%s.tmp", pf->path);
+    FILE* fp = fopen(tmp, "wb");
+
+    // the header and 'B', which start the hash chain
+    proof_header(hdr, p, k);
+    bool ok = fp != NULL && proof_read(pf, (int64_t)1 << k, M);
+    if (ok) {
+        proof_sha3_t h;
+        proof_sha3_init(&h);
+        proof_sha3_bytes(&h, hdr, PROOF_HEADER_LEN);
+        proof_sha3_words(&h, pf->W, pf->n);
+        proof_sha3_final(&h, hash);
+        ok = fwrite(hdr, 1, PROOF_HEADER_LEN, fp) == PROOF_HEADER_LEN && proof_write_words(fp, pf->W, pf->n);
+    }
+
+    // then the middles
+    for (i = 1; ok && i <= k; ++i) {
+        ok = proof_tree(pf, i, 0, 0, r, M, B, T);
+        if (!ok) break;
+        proof_pack(p, pf->n, M, pf->W);
+        r[i] = proof_next_r(hash, pf->W, pf->n);
+        ok = proof_write_words(fp, pf->W, pf->n);
+    }
+
+    if (fp != NULL) {
+        ok = (fclose(fp) == 0) && ok;
+        ok = ok && rename(tmp, pf->path) == 0;
+        if (!ok) remove(tmp);
+    }
+
+    free(tmp);
+    free(T);
+    free(M);
+    return ok;
+}
+
+bool mpt_proof_free(mpt_proof_t* pf, bool done) {
+    if (!pf->active) return false;
+
+    bool res = false;
+    if (done) {
+        res = proof_build(pf);
+        if (!res) fprintf(stderr, "[MPT_warn]: Couldn't write the proof '%s'\n", pf->path);
+    }
+
+    fclose(pf->fp);
+    if (done) remove(pf->res);
+    free(pf->W);
+    free(pf->path);
+    free(pf->res);
+    pf->active = false;
+    return res;
+}
+
+
+/* verifying */
+
+// read a term from 'fp' into 'X' (the words are in 'W'), and return whether it is there, reduced, and a unit
+//   (mod 2^p - 1), using 'G' (with 2 * (p / MPT_LIMB_BITS + 1) limbs) for the GCD
+// NOTE: a term that isn't a unit (like 0) could cancel out both sides of a claim, so a forged proof would pass
+static bool proof_read_term(FILE* fp, int64_t p, int64_t n, uint64_t* W, mpt_limb_t* X, mpt_limb_t* G) {
+    if (!proof_read_words(fp, W, n)) return false;
+
+    // no bits past 'p', and not 2^p - 1 itself
+    if (p % 64 != 0 && (W[n - 1] >> (p % 64)) != 0) return false;
+    int64_t i;
+    bool ones = true;
+    for (i = 0; ones && i < n; ++i) ones = W[i] == (i == n - 1 && p % 64 != 0 ? ((uint64_t)1 << (p % 64)) - 1 : UINT64_MAX);
+    if (ones) return false;
+
+    proof_unpack(p, W, X);
+
+    // gcd(X, 2^p - 1) == 1 (which also rules out 0)
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    memcpy(G, X, N * MPT_LIMB_SIZE);
+    mpt_set_Mp(&G[N], p);
+    mpt_gcd_n(N, G, &G[N], G);
+    for (i = 1; i < N && G[i] == 0; ++i);
+    return G[0] == 1 && i == N;
+}
+
+bool mpt_proof_verify(mpt_verify_t* v, const char* fname) {
+    v->p = 0;
+    v->k = 0;
+    v->valid = v->prp = false;
+    v->res64 = 0;
+    v->why = NULL;
+
+    FILE* fp = fopen(fname, "rb");
+    if (fp == NULL) {
+        v->why = "couldn't open it";
+        return false;
+    }
+
+    // the header
+    uint8_t hdr[PROOF_HEADER_LEN];
+    int64_t p = 0, i;
+    int k = 0;
+    if (fread(hdr, 1, PROOF_HEADER_LEN, fp) == PROOF_HEADER_LEN && memcmp(hdr, proof_magic, 8) == 0) {
+        for (i = 0; i < 8; ++i) p |= (int64_t)((uint64_t)hdr[12 + i] << (8 * i));
+        for (i = 0; i < 4; ++i) k |= (int)((uint32_t)hdr[20 + i] << (8 * i));
+        if (hdr[8] != MPT_PROOF_VERSION || hdr[9] != 0 || hdr[10] != 0 || hdr[11] != 0) v->why = "unknown version";
+        else if (p < 3 || !mpt_isprime(p)) v->why = "bad exponent";
+        else if (k != mpt_proof_power(p)) v->why = "bad power";
+    } else {
+        v->why = "not a proof";
+    }
+    if (v->why != NULL) {
+        fclose(fp);
+        return false;
+    }
+    v->p = p;
+    v->k = k;
+
+    int64_t N = p / MPT_LIMB_BITS + 1, n = (p + 63) / 64, s = p >> k;
+    uint64_t* W = malloc(n * sizeof(*W));
+    mpt_limb_t* X = malloc(4 * N * MPT_LIMB_SIZE), *A = &X[N], *B = &X[2 * N], *U = &X[3 * N];
+    mpt_limb_t* T = malloc(mpt_mod_scratch(p) * MPT_LIMB_SIZE), *G = malloc(2 * N * MPT_LIMB_SIZE);
+    uint8_t hash[32];
+
+    // B = 3^(2^T), which starts the hash chain
+    if (!proof_read_term(fp, p, n, W, B, G)) {
+        v->why = "bad residue";
+    } else {
+        proof_sha3_t h;
+        proof_sha3_init(&h);
+        proof_sha3_bytes(&h, hdr, PROOF_HEADER_LEN);
+        proof_sha3_words(&h, W, n);
+        proof_sha3_final(&h, hash);
+
+        // the final residue, 3^(2^p) == B^(2^(p - T)), since 'B' is what is proven
+        memcpy(X, B, N * MPT_LIMB_SIZE);
+        for (i = 0; i < p - (s << k); ++i) mpt_sqr_mod(p, X, 0, T);
+        mpt_set_0(U, N);
+        U[0] = p == 3 ? 2 : 9;
+        v->prp = mpt_cmp(N, X, U) == 0;
+        v->res64 = 0;
+        for (i = 0; i < N && i * MPT_LIMB_BITS < 64; ++i) v->res64 |= (uint64_t)X[i] << (i * MPT_LIMB_BITS);
+    }
+
+    // A^(2^(s * 2^k)) == B, halved at each level
+    mpt_set_0(A, N);
+    A[0] = 3;
+    for (i = 1; v->why == NULL && i <= k; ++i) {
+        if (!proof_read_term(fp, p, n, W, X, G)) {
+            v->why = "bad residue";
+            break;
+        }
+        uint64_t r = proof_next_r(hash, W, n);
+
+        // A = A^r * M, and B = M^r * B
+        proof_pow(p, A, r, U, T);
+        mpt_mul_mod(p, U, X, A, T);
+        proof_pow(p, X, r, U, T);
+        mpt_mul_mod(p, U, B, B, T);
+    }
+
+    if (v->why == NULL) {
+        for (i = 0; i < s; ++i) mpt_sqr_mod(p, A, 0, T);
+        v->valid = mpt_cmp(N, A, B) == 0;
+        if (!v->valid) v->why = "the residues don't match";
+    }
+    if (!v->valid) v->prp = false;
+
+    free(G);
+    free(T);
+    free(X);
+    free(W);
+    fclose(fp);
+    return v->valid;
+}
@@ -0,0 +1,161 @@
+/* prp.c - the base 3 Fermat probable prime (PRP) test of 2^p - 1, with Gerbicz-Li error checking
+ *
+ * If 2^p - 1 is prime, then 3^(2^p - 2) == 1, so x = 3^(2^p) == 9 (mod 2^p - 1), which is just 'p' squarings of 3
+ *   (with 'mpt_sqr_mod', the same as the LL test). Unlike the LL test, the squarings can be checked as they go:
+ *
+ * The squarings are done in blocks of 'L', and 'd' is the product of the term at the start of each block (starting
+ *   with d = x0, the first term). Since each of those terms is the one before it to the power 2^L, the product of
+ *   all but the last one, to the power 2^L, is the product of all but the first one, so:
+ *     d(k) == x0 * d(k-1)^(2^L)
+ *   where d(k-1) is the product before the current term was multiplied in. So, after every 'L' blocks (L^2
+ *   squarings), this is checked (which costs 'L' squarings), and a single error anywhere since the last check
+ *   (in either 'x' or 'd') makes it fail, in which case the test goes back to the state after the last check
+ *   that passed. The squarings after the last whole block (less than 'L') are just done twice
+ *
+ * Only the states that have been checked are written to checkpoints, and a resumed test starts a new product
+ *   (with x0 = d = the term it resumed from), so the checks never depend on anything that wasn't checked
+ *
+ * If 'mpt_proof_dir' is set, the terms that a proof needs are kept as they go by (see 'src/proof.c'), and the
+ *   proof is written at the end
+ *
+ */
+
+#include "MPT-impl.h"
+
+#include <math.h>
+
+
+int64_t mpt_prp_inject = 0;
+
+
+/* utils */
+
+// return the low 64 bits of 'X' (with 'N' limbs)
+static uint64_t prp_res64(int64_t N, mpt_limb_t* X) {
+    uint64_t r = 0;
+    int64_t i;
+    for (i = 0; i < N && i * MPT_LIMB_BITS < 64; ++i) r |= (uint64_t)X[i] << (i * MPT_LIMB_BITS);
+    return r;
+}
+
+// X = X^(2^n) (mod 2^p - 1), where 'X' is the term after 'i' iterations, and each term is given to 'pf' (if it
+//   isn't NULL)
+static void prp_sqrn(int64_t p, mpt_limb_t* X, int64_t n, mpt_limb_t* T, mpt_proof_t* pf, int64_t i) {
+    int64_t j;
+    for (j = 0; j < n; ++j) {
+        mpt_sqr_mod(p, X, 0, T);
+        if (pf != NULL) mpt_proof_step(pf, i + j + 1, X);
+    }
+}
+
+
+/* PRP */
+
+int64_t mpt_prp_block(int64_t p) {
+    // about MPT_PRP_CHECKS checks per test (the overhead is about 3 / L, from the check and the multiplication
+    //   per block)
+    int64_t L = (int64_t)sqrt((double)p / MPT_PRP_CHECKS);
+    return L < 2 ? 2 : L;
+}
+
+bool mpt_prp(mpt_prp_t* prp, int64_t p, mpt_ctx_t* ctx) {
+    prp->p = p;
+    prp->prp = false;
+    prp->res64 = 0;
+    prp->L = 0;
+    prp->nchecks = prp->nerrors = 0;
+    prp->proof = false;
+
+    // special cases (3 is 0 mod 3, and 'p' must be prime for the rest)
+    if (p == 2) {
+        prp->prp = true;
+        return true;
+    }
+    if (!mpt_isprime(p)) return false;
+
+    int64_t N = p / MPT_LIMB_BITS + 1, L = mpt_prp_block(p);
+    prp->L = L;
+
+    // the term and the product, the first term of the product, the copies from the last check, and the product
+    //   before the last block (which is what is checked)
+    mpt_ctx_begin(ctx);
+    mpt_limb_t* X = mpt_ctx_limbs(ctx, 6 * N);
+    mpt_limb_t* D = &X[N], *X0 = &X[2 * N], *VX = &X[3 * N], *VD = &X[4 * N], *C = &X[5 * N];
+    mpt_limb_t* T = mpt_ctx_limbs(ctx, mpt_mod_scratch(p));
+
+    // x = 3 to begin (or resume from a checkpoint)
+    mpt_set_0(X, N);
+    X[0] = 3;
+    mpt_ckpt_t ck;
+    mpt_ckpt_init(&ck, p, "prp", "prp0");
+    int64_t i = mpt_ckpt_load(&ck, X), vi;
+    memcpy(X0, X, N * MPT_LIMB_SIZE);
+    memcpy(D, X, N * MPT_LIMB_SIZE);
+    memcpy(VX, X, N * MPT_LIMB_SIZE);
+    memcpy(VD, X, N * MPT_LIMB_SIZE);
+    vi = i;
+    mpt_proof_t pf;
+    mpt_proof_init(&pf, p, i > 0);
+    mpt_prog_t pr;
+    mpt_prog_init(&pr, p, p, "prp0", i);
+
+    // the number of squarings in whole blocks, and the number of blocks since the last check
+    int64_t end = p / L * L, nb = 0;
+    bool injected = false;
+    while (i + L <= end) {
+        prp_sqrn(p, X, L, T, &pf, i);
+        if (mpt_prp_inject > i && mpt_prp_inject <= i + L && !injected) {
+            // (for testing the checks, see 'mpt_prp_inject')
+            X[0] ^= 1;
+            injected = true;
+        }
+        i += L;
+        nb++;
+
+        bool check = nb == L || i + L > end;
+        if (check) memcpy(C, D, N * MPT_LIMB_SIZE);
+        mpt_mul_mod(p, D, X, D, T);
+        if (!check) continue;
+
+        // d(k) == x0 * d(k-1)^(2^L)
+        prp_sqrn(p, C, L, T, NULL, 0);
+        mpt_mul_mod(p, C, X0, C, T);
+        prp->nchecks++;
+        nb = 0;
+        if (mpt_cmp(N, C, D) == 0) {
+            memcpy(VX, X, N * MPT_LIMB_SIZE);
+            memcpy(VD, D, N * MPT_LIMB_SIZE);
+            vi = i;
+            if (mpt_ckpt_due(&ck)) mpt_ckpt_save(&ck, X, i);
+            if (mpt_prog_due(&pr, i)) mpt_prog_report(&pr, i, X);
+        } else {
+            fprintf(stderr, "[MPT_warn]: Error detected in the PRP test of M%lli at iteration %lli, going back to iteration %lli\n", (long long int)p, (long long int)i, (long long int)vi);
+            prp->nerrors++;
+            memcpy(X, VX, N * MPT_LIMB_SIZE);
+            memcpy(D, VD, N * MPT_LIMB_SIZE);
+            i = vi;
+        }
+    }
+
+    // the rest of the squarings, twice (until they agree), from the state after the last check
+    while (true) {
+        memcpy(C, X, N * MPT_LIMB_SIZE);
+        prp_sqrn(p, C, p - i, T, NULL, 0);
+        prp_sqrn(p, X, p - i, T, &pf, i);
+        if (mpt_cmp(N, C, X) == 0) break;
+
+        fprintf(stderr, "[MPT_warn]: Error detected in the PRP test of M%lli at iteration %lli, going back to iteration %lli\n", (long long int)p, (long long int)p, (long long int)i);
+        prp->nerrors++;
+        memcpy(X, VX, N * MPT_LIMB_SIZE);
+    }
+    mpt_ckpt_free(&ck, true);
+    prp->proof = mpt_proof_free(&pf, true);
+    mpt_prog_free(&pr, p);
+
+    // 3^(2^p) == 9 (mod 2^p - 1), which is 2 for p == 3
+    mpt_set_0(C, N);
+    C[0] = p == 3 ? 2 : 9;
+    prp->prp = mpt_cmp(N, C, X) == 0;
+    prp->res64 = prp_res64(N, X);
+    return prp->prp;
+}
@@ -0,0 +1,421 @@
+/* radix.c - decimal conversion of big numbers (in both directions), in subquadratic time
+ *
+ * Both directions split the number in half by a power of 10, P(k) = 10^(MPT_DEC_BLOCK * 2^k), recursively, down
+ *   to blocks of MPT_DEC_BLOCK digits, which are converted directly, 9 digits at a time (which is quadratic, but
+ *   only in the size of a block). The powers only depend on 'k', so each is computed once (as the square of the
+ *   one before it), and kept for every conversion after that, in every thread
+ *
+ * Reading a string joins the halves, A = hi * P(k) + lo, with 'mpt_mul'
+ *
+ * Writing a string splits the number into hi = A / P(k) and lo = A - hi * P(k). There is no division, so each
+ *   power also keeps its reciprocal R(k) = floor(B^(2m) / P(k)), where 'B' is the limb base, and 'm' is the limbs
+ *   of P(k). It comes from Newton's iteration, starting from the square of the reciprocal before it (which is
+ *   already right to about half of its limbs). Then, each quotient is a product with R(k) (Barrett), which is at
+ *   most 2 too small, and is fixed up with a subtraction or two
+ *
+ * With the products done by Toom-Cook, both directions are O(M(n) log n), instead of O(n^2)
+ *
+ */
+
+#include "MPT-impl.h"
+
+#include <math.h>
+
+
+#if MPT_DEC_BLOCK % 9 != 0 || MPT_DEC_BLOCK < 27
+#error "MPT_DEC_BLOCK must be a multiple of 9 (and at least 27)"
+#endif
+
+// the most 32 bit words that a block takes (each 9 digits is less than 2^30)
+#define RADIX_W32 ((MPT_DEC_BLOCK / 9 * 30 + 31) / 32 + 1)
+
+// the most powers (which is more digits than any string could have)
+#define RADIX_MAXK 48
+
+// a power of 10, P(k) = 10^(MPT_DEC_BLOCK * 2^k)
+typedef struct {
+    // the limbs of 'P' (the top one is not 0)
+    int64_t m;
+    mpt_limb_t* P;
+
+    // floor(B^(2m) / P), with 'm + 1' limbs (or NULL, until a conversion to decimal needs it)
+    mpt_limb_t* R;
+} radix_pow_t;
+
+// the powers so far (guarded by 'radix_mx')
+// NOTE: an entry is never changed once it is set, so the conversions read them without the lock, after
+//   'radix_need' has made sure they are there
+static radix_pow_t radix_pows[RADIX_MAXK];
+static int radix_npows = 0;
+static pthread_mutex_t radix_mx = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* helpers */
+
+// return the limbs of 'A' (with 'n' limbs), without any zeros at the top
+static int64_t radix_norm(mpt_limb_t* A, int64_t n) {
+    while (n > 0 && A[n - 1] == 0) n--;
+    return n;
+}
+
+// C = A * B, where 'A' has 'NA' limbs, 'B' has 'NB' limbs (either way around), and 'C' has 'NA + NB' limbs
+static void radix_mul(mpt_limb_t* C, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB) {
+    if (NA < NB) {
+        mpt_limb_t* t = A;
+        int64_t nt = NA;
+        A = B;
+        NA = NB;
+        B = t;
+        NB = nt;
+    }
+    if (NB == 0) {
+        mpt_set_0(C, NA);
+        return;
+    }
+
+    mpt_limb_t* T = malloc((mpt_mul_scratch(NA, NB) + 1) * MPT_LIMB_SIZE);
+    mpt_mul(C, A, NA, B, NB, T);
+    free(T);
+}
+
+// return whether A >= P, where 'A' has 'n' limbs, and 'P' has 'm' limbs (n >= m)
+static bool radix_ge(mpt_limb_t* A, int64_t n, mpt_limb_t* P, int64_t m) {
+    if (radix_norm(A, n) > m) return true;
+    return mpt_cmp(m, A, P) >= 0;
+}
+
+// 'w' (with 'nw' 32 bit words, least significant first) as limbs in 'A' (which has room for the same bytes, in
+//   whole limbs), and return the limbs
+static int64_t radix_from32(uint32_t* w, int64_t nw, mpt_limb_t* A) {
+    int64_t n = (nw * 4 + MPT_LIMB_SIZE - 1) / MPT_LIMB_SIZE, i;
+    mpt_set_0(A, n);
+    for (i = 0; i < nw * 4; ++i) {
+        A[i / MPT_LIMB_SIZE] |= (mpt_limb_t)((w[i / 4] >> (8 * (i % 4))) & 0xff) << (8 * (i % MPT_LIMB_SIZE));
+    }
+    return radix_norm(A, n);
+}
+
+// 'A' (with 'n' limbs) as 32 bit words in 'w' (which has room for the same bytes, in whole words), and return the
+//   words
+static int64_t radix_to32(mpt_limb_t* A, int64_t n, uint32_t* w) {
+    int64_t nw = (n * MPT_LIMB_SIZE + 3) / 4, i;
+    memset(w, 0, nw * sizeof(*w));
+    for (i = 0; i < n * (int64_t)MPT_LIMB_SIZE; ++i) {
+        w[i / 4] |= (uint32_t)((A[i / MPT_LIMB_SIZE] >> (8 * (i % MPT_LIMB_SIZE))) & 0xff) << (8 * (i % 4));
+    }
+    while (nw > 0 && w[nw - 1] == 0) nw--;
+    return nw;
+}
+
+// the digit 'j' of 's', where the ones before the start (j < 0) are leading zeros
+// NOTE: 's' must be all digits up to 'j' (see 'mpt_setdecstr')
+static uint32_t radix_dig(const char* s, int64_t j) {
+    return j < 0 ? 0 : s[j] - '0';
+}
+
+
+/* powers */
+
+// R = floor(B^(2m) / P) for 'pw', by Newton's iteration from 'R' (which must not be more than that)
+static void radix_recip(radix_pow_t* pw) {
+    int64_t m = pw->m, ne, nd;
+    mpt_limb_t* R = pw->R, *X = malloc((2 * m + 1) * MPT_LIMB_SIZE), *E = malloc((2 * m + 1) * MPT_LIMB_SIZE);
+    mpt_limb_t* D = malloc((3 * m + 2) * MPT_LIMB_SIZE), one = 1;
+
+    while (true) {
+        // E = B^(2m) - P * R (which is P times the error of 'R')
+        radix_mul(X, pw->P, m, R, m + 1);
+        mpt_set_0(E, 2 * m + 1);
+        E[2 * m] = 1;
+        if (mpt_sub_n(2 * m + 1, E, E, X) != 0) {
+            // (too large, which Newton's iteration never gives, but just in case)
+            mpt_rshift(m + 1, R, R, 1);
+            continue;
+        }
+        ne = radix_norm(E, 2 * m + 1);
+
+        // R += R * E / B^(2m), which doubles the correct limbs, and never passes the answer
+        nd = ne + m + 1 - 2 * m;
+        if (nd > 0) {
+            radix_mul(D, R, m + 1, E, ne);
+            nd = radix_norm(&D[2 * m], nd);
+        }
+        if (nd <= 0) break;
+        mpt_add(R, R, m + 1, &D[2 * m], nd);
+    }
+
+    // it is off by a few at most now, so fix it up exactly
+    while (radix_ge(E, 2 * m + 1, pw->P, m)) {
+        mpt_sub(E, E, 2 * m + 1, pw->P, m);
+        mpt_add(R, R, m + 1, &one, 1);
+    }
+
+    free(D);
+    free(E);
+    free(X);
+}
+
+// the first guess at R(0), from the top 64 bits of P(0) (as a double), which is right to about 40 bits
+static void radix_recip0(radix_pow_t* pw) {
+    int64_t m = pw->m, tb = m * MPT_LIMB_BITS - 1, i;
+    mpt_limb_t* P = pw->P;
+    while (((P[tb / MPT_LIMB_BITS] >> (tb % MPT_LIMB_BITS)) & 1) == 0) tb--;
+
+    // u = the top 64 bits, so P < (u + 1) * 2^(tb - 63), and B^(2m) / P > 2^(2m*bits - tb + 63) / (u + 1)
+    uint64_t u = 0, v;
+    for (i = 0; i < 64; ++i) {
+        int64_t b = tb - i;
+        u = (u << 1) | (uint64_t)((P[b / MPT_LIMB_BITS] >> (b % MPT_LIMB_BITS)) & 1);
+    }
+    v = (uint64_t)(ldexp(1.0, 126) / ((double)u + 1.0) * (1.0 - ldexp(1.0, -40)));
+
+    // R = v * 2^(2m*bits - tb - 63)
+    int64_t s = 2 * m * MPT_LIMB_BITS - tb - 63;
+    mpt_set_0(pw->R, m + 1);
+    for (i = 0; i < 64; ++i) {
+        int64_t b = s + i;
+        if ((v >> i) & 1) pw->R[b / MPT_LIMB_BITS] |= (mpt_limb_t)1 << (b % MPT_LIMB_BITS);
+    }
+}
+
+// make sure P(0) through P(k) are there (and their reciprocals, if 'recip')
+static void radix_need(int k, bool recip) {
+    int i;
+    pthread_mutex_lock(&radix_mx);
+
+    if (radix_npows == 0) {
+        // P(0) = 10^MPT_DEC_BLOCK, 9 digits at a time
+        uint32_t w[RADIX_W32];
+        int64_t nw = 1, j;
+        w[0] = 1;
+        for (i = 0; i < MPT_DEC_BLOCK / 9; ++i) {
+            uint64_t c = 0;
+            for (j = 0; j < nw; ++j) {
+                uint64_t t = (uint64_t)w[j] * 1000000000 + c;
+                w[j] = (uint32_t)t;
+                c = t >> 32;
+            }
+            if (c != 0) w[nw++] = (uint32_t)c;
+        }
+
+        radix_pow_t* pw = &radix_pows[0];
+        pw->P = malloc((nw * 4 / MPT_LIMB_SIZE + 1) * MPT_LIMB_SIZE);
+        pw->m = radix_from32(w, nw, pw->P);
+        pw->R = NULL;
+        radix_npows = 1;
+    }
+
+    // P(i) = P(i-1)^2
+    while (radix_npows <= k) {
+        radix_pow_t* pr = &radix_pows[radix_npows - 1], *pw = &radix_pows[radix_npows];
+        mpt_limb_t* T = malloc((mpt_sqr_scratch(pr->m) + 1) * MPT_LIMB_SIZE);
+        pw->P = malloc(2 * pr->m * MPT_LIMB_SIZE);
+        mpt_sqr(pr->m, pr->P, pw->P, T);
+        pw->m = radix_norm(pw->P, 2 * pr->m);
+        pw->R = NULL;
+        free(T);
+        radix_npows++;
+    }
+
+    for (i = 0; recip && i <= k; ++i) {
+        radix_pow_t* pw = &radix_pows[i];
+        if (pw->R != NULL) continue;
+        int64_t m = pw->m;
+        mpt_limb_t* R = malloc((m + 1) * MPT_LIMB_SIZE);
+
+        if (i == 0) {
+            pw->R = R;
+            radix_recip0(pw);
+        } else {
+            // R(i-1)^2 is B^(4m') / P(i), where 'm'' is the limbs of P(i-1) (and m is 2m' or 2m' - 1)
+            radix_pow_t* pr = &radix_pows[i - 1];
+            int64_t sh = 4 * pr->m - 2 * m;
+            mpt_limb_t* S = malloc(2 * (pr->m + 1) * MPT_LIMB_SIZE);
+            radix_mul(S, pr->R, pr->m + 1, pr->R, pr->m + 1);
+            memcpy(R, &S[sh], (m + 1) * MPT_LIMB_SIZE);
+            free(S);
+            pw->R = R;
+        }
+        radix_recip(pw);
+    }
+
+    pthread_mutex_unlock(&radix_mx);
+}
+
+void mpt_radix_clear() {
+    pthread_mutex_lock(&radix_mx);
+    int i;
+    for (i = 0; i < radix_npows; ++i) {
+        free(radix_pows[i].P);
+        free(radix_pows[i].R);
+    }
+    radix_npows = 0;
+    pthread_mutex_unlock(&radix_mx);
+}
+
+
+/* to decimal */
+
+// write 'A' (with 'n' limbs, and less than 10^MPT_DEC_BLOCK) to 'out', as exactly MPT_DEC_BLOCK digits
+static void radix_get_block(mpt_limb_t* A, int64_t n, char* out) {
+    uint32_t w[RADIX_W32 + 2];
+    int64_t nw = radix_to32(A, n, w), k = MPT_DEC_BLOCK, i;
+    while (k > 0) {
+        // divide by 10^9 over 32 bit pieces (so there is no 128 bit division), which gives the next 9 digits
+        uint64_t r = 0;
+        for (i = nw - 1; i >= 0; --i) {
+            uint64_t t = (r << 32) | w[i];
+            w[i] = (uint32_t)(t / 1000000000);
+            r = t % 1000000000;
+        }
+        while (nw > 0 && w[nw - 1] == 0) nw--;
+        for (i = 0; i < 9; ++i) {
+            out[--k] = '0' + (char)(r % 10);
+            r /= 10;
+        }
+    }
+}
+
+// Q = A / P(k), and A = A - Q * P(k), where 'A' has 'n' limbs (m <= n <= 2m, and A < P(k)^2), and 'Q' has room
+//   for 'n - m + 2' limbs, and return the limbs of 'Q'
+static int64_t radix_divrem(mpt_limb_t* A, int64_t n, radix_pow_t* pw, mpt_limb_t* Q) {
+    int64_t m = pw->m, na = n - m + 1, nq, i;
+    mpt_limb_t* X = malloc((na + m + 1) * MPT_LIMB_SIZE), one = 1;
+
+    // Q = (A / B^(m-1)) * R / B^(m+1), which is at most 2 too small
+    radix_mul(X, &A[m - 1], na, pw->R, m + 1);
+    memcpy(Q, &X[m + 1], na * MPT_LIMB_SIZE);
+    Q[na] = 0;
+    nq = radix_norm(Q, na + 1);
+
+    // A -= Q * P (which is at most A, so it fits in 'n' limbs)
+    radix_mul(X, Q, nq, pw->P, m);
+    for (i = nq + m; i < n; ++i) X[i] = 0;
+    mpt_sub_n(n, A, A, X);
+    free(X);
+
+    while (radix_ge(A, n, pw->P, m)) {
+        mpt_sub(A, A, n, pw->P, m);
+        mpt_add(Q, Q, na + 1, &one, 1);
+    }
+    return radix_norm(Q, na + 1);
+}
+
+// write 'A' (with 'n' limbs, and less than P(k)) to 'out', as exactly 'MPT_DEC_BLOCK * 2^k' digits
+// NOTE: this destroys 'A'
+static void radix_get(mpt_limb_t* A, int64_t n, int k, char* out) {
+    n = radix_norm(A, n);
+    if (k == 0) {
+        radix_get_block(A, n, out);
+        return;
+    }
+
+    int64_t h = (int64_t)MPT_DEC_BLOCK << (k - 1);
+    radix_pow_t* pw = &radix_pows[k - 1];
+    if (n < pw->m || !radix_ge(A, n, pw->P, pw->m)) {
+        // (the top half is all zeros)
+        memset(out, '0', h);
+        radix_get(A, n, k - 1, &out[h]);
+        return;
+    }
+
+    mpt_limb_t* Q = malloc((n - pw->m + 2) * MPT_LIMB_SIZE);
+    int64_t nq = radix_divrem(A, n, pw, Q);
+    radix_get(Q, nq, k - 1, out);
+    free(Q);
+    radix_get(A, pw->m, k - 1, &out[h]);
+}
+
+void mpt_getdecstr(mpt_limb_t* A, int64_t sz, char* output) {
+    int64_t n = radix_norm(A, sz), i;
+
+    // a number below 2^bits has at most 1 + bits * log10(2) digits, which gives the smallest block size that fits
+    int64_t bits = n * MPT_LIMB_BITS, nd = bits * 30103 / 100000 + 1;
+    int k = 0;
+    while (((int64_t)MPT_DEC_BLOCK << k) < nd) k++;
+    if (k > 0) radix_need(k - 1, true);
+
+    nd = (int64_t)MPT_DEC_BLOCK << k;
+    mpt_limb_t* W = malloc((n + 1) * MPT_LIMB_SIZE);
+    char* buf = malloc(nd + 1);
+    memcpy(W, A, n * MPT_LIMB_SIZE);
+    radix_get(W, n, k, buf);
+
+    // without the leading zeros (but "0" for 0)
+    for (i = 0; i < nd - 1 && buf[i] == '0'; ++i);
+    memcpy(output, &buf[i], nd - i);
+    output[nd - i] = '\0';
+
+    free(buf);
+    free(W);
+}
+
+
+/* from decimal */
+
+// A = the MPT_DEC_BLOCK digits of 's' from 'j' (see 'radix_dig'), and return its limbs ('A' has room for the limbs
+//   of P(0))
+static int64_t radix_set_block(const char* s, int64_t j, mpt_limb_t* A) {
+    uint32_t w[RADIX_W32];
+    int64_t nw = 0, i, d;
+    for (d = 0; d < MPT_DEC_BLOCK; d += 9) {
+        // w = w * 10^9 + the next 9 digits
+        uint64_t c = 0;
+        for (i = 0; i < 9; ++i) c = 10 * c + radix_dig(s, j + d + i);
+        for (i = 0; i < nw; ++i) {
+            uint64_t t = (uint64_t)w[i] * 1000000000 + c;
+            w[i] = (uint32_t)t;
+            c = t >> 32;
+        }
+        if (c != 0) w[nw++] = (uint32_t)c;
+    }
+    return radix_from32(w, nw, A);
+}
+
+// the most limbs that 'radix_set' uses for level 'k' (the product is a limb more than P(k) at most)
+static int64_t radix_cap(int k) {
+    return k == 0 ? radix_pows[0].m + 1 : 2 * radix_pows[k - 1].m;
+}
+
+// A = the 'MPT_DEC_BLOCK * 2^k' digits of 's' from 'j' (see 'radix_dig'), and return its limbs ('A' has room for
+//   'radix_cap(k)' limbs)
+static int64_t radix_set(const char* s, int64_t j, int k, mpt_limb_t* A) {
+    if (k == 0) return radix_set_block(s, j, A);
+
+    int64_t h = (int64_t)MPT_DEC_BLOCK << (k - 1);
+    if (j + h <= 0) {
+        // (the top half is all leading zeros)
+        return radix_set(s, j + h, k - 1, A);
+    }
+
+    radix_pow_t* pw = &radix_pows[k - 1];
+    int64_t cap = radix_cap(k - 1);
+    mpt_limb_t* H = malloc(2 * cap * MPT_LIMB_SIZE), *L = &H[cap];
+    int64_t nh = radix_set(s, j, k - 1, H), nl = radix_set(s, j + h, k - 1, L), n = nh + pw->m;
+
+    // A = hi * P(k-1) + lo
+    if (nh == 0) {
+        memcpy(A, L, nl * MPT_LIMB_SIZE);
+        n = nl;
+    } else {
+        radix_mul(A, H, nh, pw->P, pw->m);
+        mpt_add(A, A, n, L, nl);
+    }
+    free(H);
+    return radix_norm(A, n);
+}
+
+void mpt_setdecstr(mpt_limb_t* A, int64_t N, char* str) {
+    // only the leading digits are read (so "12x4" is 12)
+    int64_t len = strspn(str, "0123456789"), n, i;
+    int k = 0;
+    while (((int64_t)MPT_DEC_BLOCK << k) < len) k++;
+    radix_need(k > 0 ? k - 1 : 0, false);
+
+    mpt_limb_t* W = malloc(radix_cap(k) * MPT_LIMB_SIZE);
+    n = radix_set(str, len - ((int64_t)MPT_DEC_BLOCK << k), k, W);
+
+    // (any limbs past 'N' are ignored)
+    for (i = 0; i < N; ++i) A[i] = i < n ? W[i] : 0;
+    free(W);
+}
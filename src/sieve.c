@@ -0,0 +1,161 @@
+/* sieve.c - segmented Sieve of Eratosthenes, for enumerating the prime exponents in a range
+ *
+ * The numbers are stored on a mod 30 wheel: each byte holds the 8 numbers in a block of 30 that are coprime to
+ *   2, 3, and 5 (one bit each), so multiples of those are never stored or crossed off. The range is sieved one
+ *   segment (of MPT_SIEVE_SEGMENT bytes, which fits in the L1 cache) at a time, by the primes up to the square root
+ *   of the end of the range, and a batch of segments (one per thread) is sieved in parallel before the primes in
+ *   them are handed out in order
+ *
+ * For each sieving prime 'q', the multiples q * m with 'm' coprime to 30 are crossed off, which is 8 interleaved
+ *   arithmetic progressions: for each residue of 'm' (mod 30), q * m always lands on the same bit, and each step
+ *   of 30 in 'm' is 'q' bytes further on
+ *
+ */
+
+#include "MPT-impl.h"
+
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// the residues (mod 30) that are coprime to 30, which are the bits of each byte (in order)
+static const int sieve_W[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+// the bit for each residue (mod 30), or -1 if it isn't on the wheel
+static const int sieve_B[30] = {
+    -1,  0, -1, -1, -1, -1, -1,  1, -1, -1, -1,  2, -1,  3, -1,
+    -1, -1,  4, -1,  5, -1, -1, -1,  6, -1, -1, -1, -1, -1,  7,
+};
+
+
+/* sieving */
+
+// sieve the 'nb' bytes at 'S', which start at the number 'base' (a multiple of 30), by the primes in 'bp'
+static void sieve_segment(uint8_t* S, int64_t nb, int64_t base, int64_t nbp, uint32_t* bp) {
+    memset(S, 0xff, nb);
+
+    // 1 isn't prime
+    if (base == 0) S[0] &= ~1;
+
+    int64_t end = base + 30 * nb, j;
+    int i;
+    for (j = 0; j < nbp; ++j) {
+        int64_t q = bp[j];
+
+        // the first multiplier, which starts at 'q' (the smaller ones have already been crossed off by smaller primes)
+        if (q * q >= end) break;
+        int64_t m0 = (base + q - 1) / q;
+        if (m0 < q) m0 = q;
+
+        for (i = 0; i < 8; ++i) {
+            // the first 'm' (at least 'm0') that is 'sieve_W[i]' (mod 30)
+            int64_t m = m0 + (sieve_W[i] - m0 % 30 + 30) % 30;
+            uint8_t mask = ~(uint8_t)(1 << sieve_B[(q * sieve_W[i]) % 30]);
+
+            int64_t k;
+            for (k = (q * m - base) / 30; k < nb; k += q) S[k] &= mask;
+        }
+    }
+}
+
+// sieve the next batch of segments of 's' into 's->seg'
+static void sieve_batch(mpt_sieve_t* s) {
+    int64_t nb = (s->hi - s->next + 29) / 30;
+    if (nb > s->nseg * MPT_SIEVE_SEGMENT) nb = s->nseg * MPT_SIEVE_SEGMENT;
+
+    int64_t nseg = (nb + MPT_SIEVE_SEGMENT - 1) / MPT_SIEVE_SEGMENT, i;
+    #pragma omp parallel for schedule(static) if (nseg > 1)
+    for (i = 0; i < nseg; ++i) {
+        int64_t sb = i * MPT_SIEVE_SEGMENT, snb = nb - sb < MPT_SIEVE_SEGMENT ? nb - sb : MPT_SIEVE_SEGMENT;
+        sieve_segment(&s->seg[sb], snb, s->next + 30 * sb, s->nbp, s->bp);
+    }
+
+    s->base = s->next;
+    s->nbyte = nb;
+    s->next += 30 * nb;
+    s->pos = 0;
+    s->cur = nb > 0 ? s->seg[0] : 0;
+}
+
+
+/* iterator */
+
+void mpt_sieve_init(mpt_sieve_t* s, int64_t lo, int64_t hi) {
+    if (lo < 0) lo = 0;
+    if (hi < lo) hi = lo;
+    s->lo = lo;
+    s->hi = hi;
+
+    // the sieving primes (7 up to the square root of 'hi'), with a plain sieve, since there are so few
+    int64_t r = (int64_t)sqrt((double)hi), j;
+    while (r > 1 && r * r >= hi) r--;
+    while ((r + 1) * (r + 1) < hi) r++;
+    uint8_t* isc = calloc(r + 1, 1);
+    s->nbp = 0;
+    s->bp = malloc((r / 2 + 1) * sizeof(*s->bp));
+    for (j = 2; j <= r; ++j) {
+        if (isc[j]) continue;
+        if (j > 5) s->bp[s->nbp++] = (uint32_t)j;
+        int64_t k;
+        for (k = j * j; k <= r; k += j) isc[k] = 1;
+    }
+    free(isc);
+
+    // a segment per thread
+    s->nseg = 1;
+#ifdef _OPENMP
+    s->nseg = omp_get_max_threads();
+#endif
+    s->seg = malloc(s->nseg * MPT_SIEVE_SEGMENT);
+
+    s->small = 0;
+    s->next = lo / 30 * 30;
+    s->base = s->next;
+    s->nbyte = 0;
+    s->pos = 0;
+    s->cur = 0;
+}
+
+int64_t mpt_sieve_next(mpt_sieve_t* s) {
+    static const int64_t small[3] = { 2, 3, 5 };
+
+    // the ones that aren't on the wheel
+    while (s->small < 3) {
+        int64_t q = small[s->small++];
+        if (q >= s->lo && q < s->hi) return q;
+    }
+
+    while (true) {
+        // the next byte with any bits left
+        while (s->cur == 0) {
+            if (++s->pos >= s->nbyte) {
+                if (s->next >= s->hi) return -1;
+                sieve_batch(s);
+            } else {
+                s->cur = s->seg[s->pos];
+            }
+        }
+
+        int b = __builtin_ctz(s->cur);
+        s->cur &= s->cur - 1;
+
+        int64_t q = s->base + 30 * s->pos + sieve_W[b];
+        if (q >= s->hi) {
+            s->next = s->hi;
+            s->nbyte = 0;
+            s->cur = 0;
+            return -1;
+        }
+        if (q >= s->lo) return q;
+    }
+}
+
+void mpt_sieve_free(mpt_sieve_t* s) {
+    free(s->bp);
+    free(s->seg);
+    s->bp = NULL;
+    s->seg = NULL;
+}
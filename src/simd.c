@@ -0,0 +1,61 @@
+/* simd.c - squaring (mod 2^p - 1) of several numbers at once, each for its own 'p', one in each vector lane
+ *
+ * For small and mid sized exponents, a single squaring is too short to keep the vector units busy (the carry
+ *   chains of the basecase are all scalar), but the exponents of a batch that are close together go through
+ *   almost the same steps. So, up to MPT_SIMD_LANES of them are stored together, digit by digit (the same digit
+ *   of each lane is in one vector), and squared all at once, with 'k_simd_sqr' (in 'MPT-kern.h', so it is
+ *   compiled for each instruction set). Only the reduction depends on each lane's 'p', which is where its top
+ *   digit is, and where it ends (a different digit, and a shift by a different amount, in each lane)
+ *
+ */
+
+#include "MPT-impl.h"
+
+
+int64_t mpt_simd_digits(int64_t p) {
+    return (p + MPT_SIMD_BITS - 1) / MPT_SIMD_BITS;
+}
+
+int64_t mpt_simd_words(int64_t n) {
+    // 'x' and 'x2' have 'n' digits, and 'z' and 'w' have '2n' columns
+    return 6 * n * MPT_SIMD_LANES;
+}
+
+void mpt_simd_init(mpt_simd_t* s, int np, const int64_t* p, uint64_t* W, uint64_t x0) {
+    int l;
+    s->np = np;
+    s->n = 0;
+    for (l = 0; l < MPT_SIMD_LANES; ++l) {
+        s->p[l] = p[l < np ? l : 0];
+        s->q[l] = mpt_simd_digits(s->p[l]) - 1;
+        s->t[l] = s->p[l] - MPT_SIMD_BITS * s->q[l];
+        if (s->q[l] + 1 > s->n) s->n = s->q[l] + 1;
+    }
+
+    int64_t n = s->n, L = MPT_SIMD_LANES;
+    s->x = W;
+    s->x2 = &W[n * L];
+    s->z = &W[2 * n * L];
+    s->w = &W[4 * n * L];
+
+    memset(s->x, 0, n * L * sizeof(uint64_t));
+    for (l = 0; l < L; ++l) s->x[l] = x0;
+}
+
+bool mpt_simd_iszero(mpt_simd_t* s, int l) {
+    int64_t q = s->q[l], L = MPT_SIMD_LANES, j;
+    const uint64_t M = (1ULL << MPT_SIMD_BITS) - 1;
+
+    // the value is in [0, 2^p - 1], so it is either all zeros, or all ones
+    bool all0 = true, all1 = s->x[q * L + l] == (1ULL << s->t[l]) - 1;
+    for (j = 0; j <= q; ++j) {
+        uint64_t v = s->x[j * L + l];
+        all0 = all0 && v == 0;
+        if (j < q) all1 = all1 && v == M;
+    }
+    return all0 || all1;
+}
+
+void mpt_simd_sqr(mpt_simd_t* s, uint64_t c) {
+    mpt_kern.simd_sqr(s, c);
+}
@@ -0,0 +1,414 @@
+/* sqr.c - subquadratic squaring (Karatsuba, Toom-3, Toom-4), and products on top of it
+ *
+ * Each algorithm splits 'A' into pieces (the coefficients of a polynomial), squares the polynomial at a few
+ *   points (recursively, with 'mpt_sqr'), and interpolates the coefficients of the square back out
+ *
+ * A product of two different numbers is two squarings, since 4AB = (A + B)^2 - (A - B)^2 (see 'mpt_mul'), so it
+ *   is just as fast, and there is only one set of subquadratic algorithms to tune
+ *
+ * All the scratch space is passed in by the caller (see 'mpt_sqr_scratch'), so there are no allocations
+ *
+ */
+
+#include "MPT-impl.h"
+
+
+/* helpers */
+
+// R = |A - B|, where 'A' has 'NA' limbs and 'B' has 'NB' limbs (NA >= NB), and 'R' has 'NA' limbs
+static void h_absdiff(mpt_limb_t* R, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB) {
+    int64_t i;
+    bool AgeB = false;
+    for (i = NB; i < NA; ++i) {
+        if (A[i] != 0) {
+            AgeB = true;
+            break;
+        }
+    }
+
+    if (AgeB || mpt_cmp(NB, A, B) >= 0) {
+        mpt_sub(R, A, NA, B, NB);
+    } else {
+        mpt_sub_n(NB, R, B, A);
+        for (i = NB; i < NA; ++i) R[i] = 0;
+    }
+}
+
+// R = A << s, where 'A' has 'NA' limbs, and 'R' has 'NR' limbs (NR > NA)
+static void h_shl(mpt_limb_t* R, int64_t NR, mpt_limb_t* A, int64_t NA, int s) {
+    int64_t i;
+    R[NA] = mpt_lshift(NA, R, A, s);
+    for (i = NA + 1; i < NR; ++i) R[i] = 0;
+}
+
+// C += X << (off * MPT_LIMB_BITS), where 'C' has 'NC' limbs, and 'X' has 'NX' limbs
+// NOTE: the result must fit in 'C'
+static void h_add_at(mpt_limb_t* C, int64_t NC, int64_t off, mpt_limb_t* X, int64_t NX) {
+    // only the non-zero limbs matter (the rest may run past the end of 'C')
+    while (NX > 0 && X[NX - 1] == 0) NX--;
+    if (NX == 0) return;
+
+    mpt_limb_t c = mpt_add_n(NX, &C[off], &C[off], X);
+    int64_t i = off + NX;
+    while (c > 0 && i < NC) {
+        C[i] += c;
+        c = C[i] < c;
+        i++;
+    }
+}
+
+
+/* Karatsuba */
+
+// split into 'a0 + a1*B^n0', so:
+// A^2 = a0^2 + (a0^2 + a1^2 - (a0 - a1)^2)*B^n0 + a1^2*B^(2*n0)
+void mpt_sqr_kara(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T) {
+    int64_t n0 = N - N / 2, n1 = N / 2;
+    mpt_limb_t* a0 = A, *a1 = &A[n0];
+
+    // scratch layout
+    mpt_limb_t* d = T, *dsq = &T[n0], *rec = &T[3 * n0 + 1];
+
+    // |a0 - a1|^2
+    h_absdiff(d, a0, n0, a1, n1);
+    mpt_sqr(n0, d, dsq, rec);
+
+    // low and high halves go directly into the result
+    mpt_sqr(n0, a0, C, rec);
+    mpt_sqr(n1, a1, &C[2 * n0], rec);
+
+    // middle = a0^2 + a1^2 - |a0 - a1|^2 (which is 2*a0*a1, so it is non-negative)
+    mpt_limb_t b = mpt_sub_n(2 * n0, dsq, C, dsq);
+    mpt_limb_t c = mpt_add(dsq, dsq, 2 * n0, &C[2 * n0], 2 * n1);
+    dsq[2 * n0] = c - b;
+
+    h_add_at(C, 2 * N, n0, dsq, 2 * n0 + 1);
+}
+
+
+/* Toom-3 */
+
+// split into 'a0 + a1*x + a2*x^2' (with x = B^n), evaluate the square at x = 0, 1, -1, 2, inf,
+//   and interpolate the coefficients 'c0 ... c4'
+void mpt_sqr_toom3(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T) {
+    int64_t n = (N + 2) / 3, s = N - 2 * n, L = 2 * n + 2, i;
+
+    // must have a non-empty top piece
+    if (s <= 0) {
+        mpt_sqr_kara(N, A, C, T);
+        return;
+    }
+
+    mpt_limb_t* a0 = A, *a1 = &A[n], *a2 = &A[2 * n];
+
+    // scratch layout
+    mpt_limb_t* ev1 = T, *evm = &T[n + 1], *ev2 = &T[2 * (n + 1)];
+    mpt_limb_t* W1 = &T[3 * (n + 1)], *Wm = &W1[L], *W2 = &Wm[L], *tmp = &W2[L], *rec = &tmp[L];
+
+    /* evaluate */
+
+    // ev2 = a0 + a2, as a temporary
+    ev2[n] = mpt_add(ev2, a0, n, a2, s);
+
+    // A(1) = (a0 + a2) + a1, and |A(-1)| = |(a0 + a2) - a1|
+    ev1[n] = ev2[n] + mpt_add_n(n, ev1, ev2, a1);
+    h_absdiff(evm, ev2, n + 1, a1, n);
+
+    // A(2) = (2*a2 + a1)*2 + a0
+    for (i = 0; i < s; ++i) ev2[i] = a2[i];
+    for (i = s; i <= n; ++i) ev2[i] = 0;
+    mpt_lshift(n + 1, ev2, ev2, 1);
+    ev2[n] += mpt_add_n(n, ev2, ev2, a1);
+    mpt_lshift(n + 1, ev2, ev2, 1);
+    ev2[n] += mpt_add_n(n, ev2, ev2, a0);
+
+    /* square */
+
+    mpt_sqr(n + 1, ev1, W1, rec);
+    mpt_sqr(n + 1, evm, Wm, rec);
+    mpt_sqr(n + 1, ev2, W2, rec);
+
+    // c0 and c4 go directly into the result
+    mpt_sqr(n, a0, C, rec);
+    for (i = 2 * n; i < 4 * n; ++i) C[i] = 0;
+    mpt_sqr(s, a2, &C[4 * n], rec);
+
+    mpt_limb_t* c0 = C, *c4 = &C[4 * n];
+
+    /* interpolate */
+
+    // Wm = (W1 - Wm) / 2 = c1 + c3
+    // W1 = (W1 + Wm) / 2 = c0 + c2 + c4
+    mpt_sub_n(L, tmp, W1, Wm);
+    mpt_add_n(L, W1, W1, Wm);
+    mpt_rshift(L, Wm, tmp, 1);
+    mpt_rshift(L, W1, W1, 1);
+
+    // W1 = c2
+    mpt_sub(W1, W1, L, c0, 2 * n);
+    mpt_sub(W1, W1, L, c4, 2 * s);
+
+    // W2 = (W2 - c0 - 4*c2 - 16*c4) / 2 = c1 + 4*c3
+    mpt_sub(W2, W2, L, c0, 2 * n);
+    mpt_lshift(L, tmp, W1, 2);
+    mpt_sub_n(L, W2, W2, tmp);
+    h_shl(tmp, L, c4, 2 * s, 4);
+    mpt_sub_n(L, W2, W2, tmp);
+    mpt_rshift(L, W2, W2, 1);
+
+    // W2 = (W2 - (c1 + c3)) / 3 = c3
+    mpt_sub_n(L, W2, W2, Wm);
+    mpt_divexact_1(L, W2, W2, 3);
+
+    // Wm = c1
+    mpt_sub_n(L, Wm, Wm, W2);
+
+    h_add_at(C, 2 * N, n, Wm, L);
+    h_add_at(C, 2 * N, 2 * n, W1, L);
+    h_add_at(C, 2 * N, 3 * n, W2, L);
+}
+
+
+/* Toom-4 */
+
+// split into 'a0 + a1*x + a2*x^2 + a3*x^3' (with x = B^n), evaluate the square at x = 0, 1, -1, 2, -2, 1/2, inf,
+//   and interpolate the coefficients 'c0 ... c6'
+// NOTE: since every evaluation is squared, all of them are non-negative, and the interpolation is ordered so that
+//   every intermediate value is also non-negative
+void mpt_sqr_toom4(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T) {
+    int64_t n = (N + 3) / 4, s = N - 3 * n, L = 2 * n + 2, i;
+
+    // must have a non-empty top piece
+    if (s <= 0) {
+        mpt_sqr_toom3(N, A, C, T);
+        return;
+    }
+
+    mpt_limb_t* a0 = A, *a1 = &A[n], *a2 = &A[2 * n], *a3 = &A[3 * n];
+
+    // scratch layout
+    mpt_limb_t* e = T, *o = &e[n + 1];
+    mpt_limb_t* ev1 = &o[n + 1], *evm1 = &ev1[n + 1], *ev2 = &evm1[n + 1], *evm2 = &ev2[n + 1], *evh = &evm2[n + 1];
+    mpt_limb_t* W1 = &evh[n + 1], *Wm1 = &W1[L], *W2 = &Wm1[L], *Wm2 = &W2[L], *Wh = &Wm2[L], *tmp = &Wh[L], *rec = &tmp[L];
+
+    /* evaluate */
+
+    // A(1) and |A(-1)|, from the even and odd parts
+    e[n] = mpt_add_n(n, e, a0, a2);
+    o[n] = mpt_add(o, a1, n, a3, s);
+    mpt_add_n(n + 1, ev1, e, o);
+    h_absdiff(evm1, e, n + 1, o, n + 1);
+
+    // A(2) and |A(-2)|, from the even part 'a0 + 4*a2' and the odd part '2*a1 + 8*a3'
+    h_shl(e, n + 1, a2, n, 2);
+    e[n] += mpt_add_n(n, e, e, a0);
+
+    for (i = 0; i < s; ++i) o[i] = a3[i];
+    for (i = s; i <= n; ++i) o[i] = 0;
+    mpt_lshift(n + 1, o, o, 2);
+    o[n] += mpt_add_n(n, o, o, a1);
+    mpt_lshift(n + 1, o, o, 1);
+
+    mpt_add_n(n + 1, ev2, e, o);
+    h_absdiff(evm2, e, n + 1, o, n + 1);
+
+    // 8*A(1/2) = ((2*a0 + a1)*2 + a2)*2 + a3
+    for (i = 0; i < n; ++i) evh[i] = a0[i];
+    evh[n] = 0;
+    mpt_lshift(n + 1, evh, evh, 1);
+    evh[n] += mpt_add_n(n, evh, evh, a1);
+    mpt_lshift(n + 1, evh, evh, 1);
+    evh[n] += mpt_add_n(n, evh, evh, a2);
+    mpt_lshift(n + 1, evh, evh, 1);
+    mpt_add(evh, evh, n + 1, a3, s);
+
+    /* square */
+
+    mpt_sqr(n + 1, ev1, W1, rec);
+    mpt_sqr(n + 1, evm1, Wm1, rec);
+    mpt_sqr(n + 1, ev2, W2, rec);
+    mpt_sqr(n + 1, evm2, Wm2, rec);
+    mpt_sqr(n + 1, evh, Wh, rec);
+
+    // c0 and c6 go directly into the result
+    mpt_sqr(n, a0, C, rec);
+    for (i = 2 * n; i < 6 * n; ++i) C[i] = 0;
+    mpt_sqr(s, a3, &C[6 * n], rec);
+
+    mpt_limb_t* c0 = C, *c6 = &C[6 * n];
+
+    /* interpolate */
+
+    // Wm1 = (W1 - Wm1) / 2 = c1 + c3 + c5
+    // W1 = (W1 + Wm1) / 2 = c0 + c2 + c4 + c6
+    mpt_sub_n(L, tmp, W1, Wm1);
+    mpt_add_n(L, W1, W1, Wm1);
+    mpt_rshift(L, Wm1, tmp, 1);
+    mpt_rshift(L, W1, W1, 1);
+
+    // Wm2 = (W2 - Wm2) / 4 = c1 + 4*c3 + 16*c5
+    // W2 = (W2 + Wm2) / 2 = c0 + 4*c2 + 16*c4 + 64*c6
+    mpt_sub_n(L, tmp, W2, Wm2);
+    mpt_add_n(L, W2, W2, Wm2);
+    mpt_rshift(L, Wm2, tmp, 2);
+    mpt_rshift(L, W2, W2, 1);
+
+    // W1 = c2 + c4
+    mpt_sub(W1, W1, L, c0, 2 * n);
+    mpt_sub(W1, W1, L, c6, 2 * s);
+
+    // W2 = 4*c2 + 16*c4
+    mpt_sub(W2, W2, L, c0, 2 * n);
+    h_shl(tmp, L, c6, 2 * s, 6);
+    mpt_sub_n(L, W2, W2, tmp);
+
+    // W2 = (W2 - 4*(c2 + c4)) / 12 = c4
+    mpt_lshift(L, tmp, W1, 2);
+    mpt_sub_n(L, W2, W2, tmp);
+    mpt_rshift(L, W2, W2, 2);
+    mpt_divexact_1(L, W2, W2, 3);
+
+    // W1 = c2
+    mpt_sub_n(L, W1, W1, W2);
+
+    // Wh = (Wh - 64*c0 - 16*c2 - 4*c4 - c6) / 2 = 16*c1 + 4*c3 + c5
+    h_shl(tmp, L, c0, 2 * n, 6);
+    mpt_sub_n(L, Wh, Wh, tmp);
+    mpt_lshift(L, tmp, W1, 4);
+    mpt_sub_n(L, Wh, Wh, tmp);
+    mpt_lshift(L, tmp, W2, 2);
+    mpt_sub_n(L, Wh, Wh, tmp);
+    mpt_sub(Wh, Wh, L, c6, 2 * s);
+    mpt_rshift(L, Wh, Wh, 1);
+
+    // Wm2 = ((c1 + 4*c3 + 16*c5) - (c1 + c3 + c5)) / 3 = c3 + 5*c5
+    mpt_sub_n(L, Wm2, Wm2, Wm1);
+    mpt_divexact_1(L, Wm2, Wm2, 3);
+
+    // tmp = (16*(c1 + c3 + c5) - Wh) / 3 = 4*c3 + 5*c5
+    mpt_lshift(L, tmp, Wm1, 4);
+    mpt_sub_n(L, tmp, tmp, Wh);
+    mpt_divexact_1(L, tmp, tmp, 3);
+
+    // tmp = (tmp - Wm2) / 3 = c3
+    mpt_sub_n(L, tmp, tmp, Wm2);
+    mpt_divexact_1(L, tmp, tmp, 3);
+
+    // Wm2 = (Wm2 - c3) / 5 = c5
+    mpt_sub_n(L, Wm2, Wm2, tmp);
+    mpt_divexact_1(L, Wm2, Wm2, 5);
+
+    // Wm1 = c1
+    mpt_sub_n(L, Wm1, Wm1, tmp);
+    mpt_sub_n(L, Wm1, Wm1, Wm2);
+
+    h_add_at(C, 2 * N, n, Wm1, L);
+    h_add_at(C, 2 * N, 2 * n, W1, L);
+    h_add_at(C, 2 * N, 3 * n, tmp, L);
+    h_add_at(C, 2 * N, 4 * n, W2, L);
+    h_add_at(C, 2 * N, 5 * n, Wm2, L);
+}
+
+
+/* dispatch */
+
+// return the larger of 'mpt_sqr_scratch(n)' and 'mpt_sqr_scratch(n + 1)', since the recursive calls use both
+static int64_t h_scratch2(int64_t n) {
+    int64_t a = mpt_sqr_scratch(n), b = mpt_sqr_scratch(n + 1);
+    return a > b ? a : b;
+}
+
+int64_t mpt_sqr_scratch(int64_t N) {
+    if (N < MPT_SQR_KARA_THRESH) {
+        return 0;
+    } else if (N < MPT_SQR_TOOM3_THRESH) {
+        int64_t n0 = N - N / 2;
+        return 3 * n0 + 1 + mpt_sqr_scratch(n0);
+    } else if (N < MPT_SQR_TOOM4_THRESH) {
+        int64_t n = (N + 2) / 3;
+        return 3 * (n + 1) + 4 * (2 * n + 2) + h_scratch2(n);
+    } else {
+        int64_t n = (N + 3) / 4;
+        return 7 * (n + 1) + 6 * (2 * n + 2) + h_scratch2(n);
+    }
+}
+
+void mpt_sqr(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T) {
+    if (mpt_sqr_threads > 1 && N >= MPT_SQR_PAR_THRESH && N < MPT_SQR_KARA_THRESH * mpt_sqr_threads) {
+        mpt_sqr_comba_par(N, A, C, mpt_sqr_threads);
+    } else if (N < MPT_SQR_KARA_THRESH) {
+        mpt_sqr_comba(N, A, C);
+    } else if (N < MPT_SQR_TOOM3_THRESH) {
+        mpt_sqr_kara(N, A, C, T);
+    } else if (N < MPT_SQR_TOOM4_THRESH) {
+        mpt_sqr_toom3(N, A, C, T);
+    } else {
+        mpt_sqr_toom4(N, A, C, T);
+    }
+}
+
+
+/* products */
+
+// C = A * B (schoolbook), where 'A' has 'NA' limbs, 'B' has 'NB' limbs, and 'C' has 'NA + NB' limbs
+static void h_mul_basecase(mpt_limb_t* C, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB) {
+    int64_t i, j;
+    mpt_limb_t lohi[2], s[2], cy;
+    for (i = 0; i < NA + NB; ++i) C[i] = 0;
+
+    for (j = 0; j < NB; ++j) {
+        // C += A * B[j] * B^j, one row at a time (each limb is at most (B-1)^2 + 2(B-1), so the carry fits)
+        cy = 0;
+        for (i = 0; i < NA; ++i) {
+            mptl_mul(A[i], B[j], lohi);
+            mptl_add(lohi[0], cy, s);
+            cy = lohi[1] + s[1];
+            mptl_add(C[i + j], s[0], s);
+            C[i + j] = s[0];
+            cy += s[1];
+        }
+        C[NA + j] = cy;
+    }
+}
+
+int64_t mpt_mul_scratch(int64_t NA, int64_t NB) {
+    if (NB < MPT_SQR_KARA_THRESH) {
+        return 0;
+    } else if (NA >= 2 * NB) {
+        return 2 * NB + mpt_mul_scratch(NB, NB);
+    } else {
+        int64_t n = NA + 1;
+        return 6 * n + mpt_sqr_scratch(n);
+    }
+}
+
+void mpt_mul(mpt_limb_t* C, mpt_limb_t* A, int64_t NA, mpt_limb_t* B, int64_t NB, mpt_limb_t* T) {
+    if (NB < MPT_SQR_KARA_THRESH) {
+        h_mul_basecase(C, A, NA, B, NB);
+    } else if (NA >= 2 * NB) {
+        // in pieces of 'NB' limbs of 'A', so each product is balanced
+        mpt_limb_t* P = T;
+        int64_t i, k;
+        for (i = 0; i < NA + NB; ++i) C[i] = 0;
+        for (i = 0; i < NA; i += NB) {
+            k = NA - i < NB ? NA - i : NB;
+            mpt_mul(P, B, NB, &A[i], k, &T[2 * NB]);
+            h_add_at(C, NA + NB, i, P, NB + k);
+        }
+    } else {
+        // C = ((A + B)^2 - (A - B)^2) / 4 (where the sum, and the difference, have one more limb than 'A')
+        int64_t n = NA + 1, i;
+        mpt_limb_t* U = T, *V = &T[n], *SU = &T[2 * n], *SV = &T[4 * n];
+        for (i = 0; i < NA; ++i) U[i] = A[i];
+        U[NA] = 0;
+        mpt_add(U, U, n, B, NB);
+        h_absdiff(V, A, NA, B, NB);
+        V[NA] = 0;
+
+        mpt_sqr(n, U, SU, &T[6 * n]);
+        mpt_sqr(n, V, SV, &T[6 * n]);
+        mpt_sub_n(2 * n, SU, SU, SV);
+        mpt_rshift(2 * n, SU, SU, 2);
+        for (i = 0; i < NA + NB; ++i) C[i] = SU[i];
+    }
+}
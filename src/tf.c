@@ -0,0 +1,345 @@
+/* tf.c - trial factoring of 2^p - 1
+ *
+ * Any factor 'q' of 2^p - 1 (for prime 'p') is of the form 2kp + 1, and is 1 or 7 (mod 8). So, the candidates
+ *   are split up into classes by 'k' (mod TF_M), where TF_M = 4 * 3 * 5 * 7 * 11, and only the classes which
+ *   have the right residue (mod 8) and no factor of 3, 5, 7, or 11 are kept (960 of the 4620). The 'k's in each
+ *   class are then sieved by the next few thousand primes, and the ones left are tested by computing 2^p (mod q)
+ *   with Montgomery multiplication (with a single limb if 'q' fits in 64 bits, and with 2 limbs otherwise)
+ *
+ * The search is done one bit level at a time (all of the 'q' in [2^b, 2^(b+1)) across all of the classes), so
+ *   small factors are found first
+ *
+ */
+
+#include "MPT-impl.h"
+
+#include <math.h>
+
+
+// number of 'k' classes, and the primes they remove
+#define TF_M (4 * 3 * 5 * 7 * 11)
+static const int tf_cprimes[] = { 3, 5, 7, 11 };
+
+// length of a sieve block (in 'k's of a single class)
+#define TF_BLOCK 32768
+
+// number of candidates that are tested at once
+#define TF_BATCH 4
+
+
+/* Montgomery arithmetic (mod q) */
+
+// modulus, which is odd, and less than 2^127
+typedef struct {
+
+    // the modulus (as q1:q0), and -q^-1 (mod 2^64)
+    uint64_t q0, q1;
+    uint64_t qi;
+
+    // 2^64 or 2^128 (mod q), i.e. 1 in Montgomery form
+    uint64_t r0, r1;
+
+} tf_mod_t;
+
+// a * b + c + d, returning the low part, and storing the high part in '*hi' (this can't overflow)
+static inline uint64_t tf_mac(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t* hi) {
+    uint64_t lo = mpt_mul64(a, b, hi);
+    lo += c;
+    *hi += lo < c;
+    lo += d;
+    *hi += lo < d;
+    return lo;
+}
+
+// return a * b * 2^-64 (mod q), where a, b < q < 2^64
+static inline uint64_t tf_mul1(tf_mod_t* m, uint64_t a, uint64_t b) {
+    return mpt_montmul64(a, b, m->q0, m->qi);
+}
+
+// return 2 * a (mod q), where a < q < 2^64
+static inline uint64_t tf_dbl1(tf_mod_t* m, uint64_t a) {
+    uint64_t r = a << 1;
+    return r - (m->q0 & -((a >> 63) | (r >= m->q0)));
+}
+
+// R = A * B * 2^-128 (mod q), where A, B < q < 2^127, and each is 2 limbs (CIOS)
+static inline void tf_mul2(tf_mod_t* m, uint64_t* A, uint64_t* B, uint64_t* R) {
+    uint64_t t0 = 0, t1 = 0, t2 = 0, c, u, x;
+    int i;
+    for (i = 0; i < 2; ++i) {
+        // t += A * B[i]
+        t0 = tf_mac(A[0], B[i], t0, 0, &c);
+        t1 = tf_mac(A[1], B[i], t1, c, &c);
+        t2 += c;
+
+        // t = (t + u * q) / 2^64, which is exact
+        u = t0 * m->qi;
+        tf_mac(u, m->q0, t0, 0, &c);
+        t0 = tf_mac(u, m->q1, t1, c, &c);
+        t1 = t2 + c;
+        t2 = 0;
+    }
+
+    // it is less than 2q now
+    x = t0 - m->q0;
+    c = t0 < m->q0;
+    u = t1 - m->q1 - c;
+    c = (t1 < m->q1) | ((t1 == m->q1) & c);
+    R[0] = c ? t0 : x;
+    R[1] = c ? t1 : u;
+}
+
+// A = 2 * A (mod q), where A < q < 2^127
+static inline void tf_dbl2(tf_mod_t* m, uint64_t* A) {
+    uint64_t a0 = A[0] << 1, a1 = (A[1] << 1) | (A[0] >> 63);
+    uint64_t c = a0 < m->q0, x = a0 - m->q0, u = a1 - m->q1 - c;
+    c = (a1 < m->q1) | ((a1 == m->q1) & c);
+    A[0] = c ? a0 : x;
+    A[1] = c ? a1 : u;
+}
+
+// set up 'm' for the modulus q1:q0 (which is odd, and less than 2^127)
+static void tf_mod_init(tf_mod_t* m, uint64_t q0, uint64_t q1) {
+    m->q0 = q0;
+    m->q1 = q1;
+    m->qi = mpt_neginv64(q0);
+
+    if (q1 == 0) {
+        // 2^64 (mod q)
+        m->r0 = (0 - q0) % q0;
+        m->r1 = 0;
+    } else {
+#ifdef __SIZEOF_INT128__
+        // 2^128 (mod q)
+        unsigned __int128 q = ((unsigned __int128)q1 << 64) | q0, r = (0 - q) % q;
+        m->r0 = (uint64_t)r;
+        m->r1 = (uint64_t)(r >> 64);
+#else
+        // start with the highest power of 2 that is less than 'q', and double it up to 2^128
+        int lg = 127 - __builtin_clzll(q1), i;
+        uint64_t R[2] = { 0, (uint64_t)1 << (lg - 64) };
+        for (i = lg; i < 128; ++i) tf_dbl2(m, R);
+        m->r0 = R[0];
+        m->r1 = R[1];
+#endif
+    }
+}
+
+// for each 'j' less than 'n' (which is at most TF_BATCH), set D[j] to whether 2^p == 1 (mod Q[j]), i.e. whether
+//   it divides 2^p - 1
+// The 'Q[j]' must all be less than 2^64, or all at least 2^64, and they are done together, so that the
+//   multiplications for each are independent (and overlap, instead of waiting on each other)
+static void tf_test(int64_t p, int n, uint64_t* Q0, uint64_t* Q1, bool* D) {
+    tf_mod_t m[TF_BATCH];
+    int j;
+    for (j = 0; j < TF_BATCH; ++j) {
+        // the unused ones are just copies
+        int jj = j < n ? j : n - 1;
+        tf_mod_init(&m[j], Q0[jj], Q1[jj]);
+    }
+
+    // left to right binary powering, starting with 2 (for the top bit of 'p')
+    int i = 62 - __builtin_clzll(p);
+    if (Q1[0] == 0) {
+        uint64_t X[TF_BATCH];
+        for (j = 0; j < TF_BATCH; ++j) X[j] = tf_dbl1(&m[j], m[j].r0);
+        for (; i >= 0; --i) {
+            for (j = 0; j < TF_BATCH; ++j) X[j] = tf_mul1(&m[j], X[j], X[j]);
+            if ((p >> i) & 1) {
+                for (j = 0; j < TF_BATCH; ++j) X[j] = tf_dbl1(&m[j], X[j]);
+            }
+        }
+        for (j = 0; j < n; ++j) D[j] = X[j] == m[j].r0;
+    } else {
+        uint64_t X[TF_BATCH][2];
+        for (j = 0; j < TF_BATCH; ++j) {
+            X[j][0] = m[j].r0;
+            X[j][1] = m[j].r1;
+            tf_dbl2(&m[j], X[j]);
+        }
+        for (; i >= 0; --i) {
+            for (j = 0; j < TF_BATCH; ++j) tf_mul2(&m[j], X[j], X[j], X[j]);
+            if ((p >> i) & 1) {
+                for (j = 0; j < TF_BATCH; ++j) tf_dbl2(&m[j], X[j]);
+            }
+        }
+        for (j = 0; j < n; ++j) D[j] = X[j][0] == m[j].r0 && X[j][1] == m[j].r1;
+    }
+}
+
+
+/* sieve */
+
+// return the smallest 'k' such that 2kp + 1 >= 2^b (saturating at UINT64_MAX)
+static uint64_t tf_kstart(int64_t p, int b) {
+    // divide (2^b - 1) by 2p, one bit at a time, and round up
+    uint64_t d = 2 * (uint64_t)p, r = 0, k = 0;
+    int i;
+    for (i = 0; i < b; ++i) {
+        if (k >> 63) return UINT64_MAX;
+        r = 2 * r + 1;
+        k = 2 * k + (r >= d);
+        if (r >= d) r -= d;
+    }
+    return k + (r != 0);
+}
+
+// return whether the class 'c' (of 'k', mod TF_M) can have any factors
+static bool tf_class_ok(int64_t p, int c) {
+    // 2kp + 1 must be 1 or 7 (mod 8)
+    int q8 = (int)((2 * (p % 8) * c + 1) % 8);
+    if (q8 != 1 && q8 != 7) return false;
+
+    // and can't have a small factor (unless it is 'p', which never divides 2kp + 1)
+    int i;
+    for (i = 0; i < (int)(sizeof(tf_cprimes) / sizeof(*tf_cprimes)); ++i) {
+        int s = tf_cprimes[i];
+        if (s != p && (2 * (p % s) * c + 1) % s == 0) return false;
+    }
+    return true;
+}
+
+int mpt_tf_bits(int64_t p) {
+    // the largest 'b' such that b * 2^b <= 2 * MPT_TF_COST_RATIO * p^3 * log2(p) (see 'MPT_TF_COST_RATIO')
+    double lim = 2.0 * MPT_TF_COST_RATIO * (double)p * (double)p * (double)p * (64 - __builtin_clzll(p));
+    int b = 1;
+    while (b < MPT_TF_MAXBITS && (b + 1) * ldexp(1.0, b + 1) <= lim) b++;
+    return b;
+}
+
+bool mpt_tf(mpt_tf_t* tf, int64_t p, int bits) {
+    tf->p = p;
+    tf->found = false;
+    tf->k = 0;
+    tf->q[0] = tf->q[1] = 0;
+    tf->ntested = 0;
+
+    // any factor of a composite 2^p - 1 is less than 2^(p/2 + 1) (and this keeps 'q' from being 2^p - 1 itself),
+    //   and 'k' must fit in 64 bits
+    int lgp = 64 - __builtin_clzll(2 * p);
+    if (bits > p / 2 + 1) bits = p / 2 + 1;
+    if (bits > MPT_TF_MAXBITS) bits = MPT_TF_MAXBITS;
+    if (bits > 62 + lgp) bits = 62 + lgp;
+    tf->bits = bits;
+    if (p < 3 || bits < lgp) return false;
+
+    // the sieving primes, (2p * TF_M)^-1 modulo each of them, and the next 'i' that each crosses off
+    int64_t* sp = malloc(MPT_TF_SIEVE_PRIMES * sizeof(*sp));
+    int64_t* spi = malloc(MPT_TF_SIEVE_PRIMES * sizeof(*spi));
+    int64_t* so = malloc(MPT_TF_SIEVE_PRIMES * sizeof(*so));
+    // (only the ones which can cross off more than one 'k' in a class are needed, see below)
+    uint64_t kmax = tf_kstart(p, bits) / TF_M + 1;
+    int64_t smax = 2 * (kmax < TF_BLOCK ? (int64_t)kmax : TF_BLOCK);
+    int ns = 0, j;
+    int64_t s;
+    for (s = 13; ns < MPT_TF_SIEVE_PRIMES && s < smax; s += 2) {
+        // trial division by the ones before it (and the class primes, which don't divide anything past 11)
+        bool isp = s % 3 != 0 && s % 5 != 0 && s % 7 != 0 && s % 11 != 0;
+        for (j = 0; isp && j < ns && sp[j] * sp[j] <= s; ++j) isp = s % sp[j] != 0;
+        if (!isp) continue;
+
+        sp[ns] = s;
+        ns++;
+    }
+
+    // 'p' itself never divides 2kp + 1, so it is taken out
+    int ns2 = 0;
+    for (j = 0; j < ns; ++j) {
+        if (sp[j] == p) continue;
+        sp[ns2] = sp[j];
+        spi[ns2] = mpt_modinv((2 * (p % sp[j]) * TF_M) % sp[j], sp[j]);
+        ns2++;
+    }
+    ns = ns2;
+
+    // the sieve, as bits (set if 2kp + 1 may still be prime)
+    uint64_t* sv = malloc(TF_BLOCK / 8);
+
+    uint64_t K[TF_BATCH], Q0[TF_BATCH], Q1[TF_BATCH];
+    bool D[TF_BATCH];
+
+    int b, c, n;
+    for (b = lgp - 1; b < bits && !tf->found; ++b) {
+        // the range of 'k' for this bit level
+        uint64_t klo = tf_kstart(p, b), khi = tf_kstart(p, b + 1);
+        if (klo < 1) klo = 1;
+
+        for (c = 0; c < TF_M && !tf->found; ++c) {
+            if (!tf_class_ok(p, c)) continue;
+
+            // k = c + TF_M * i, for i in [ilo, ihi)
+            uint64_t ilo = klo > (uint64_t)c ? (klo - c + TF_M - 1) / TF_M : 0;
+            uint64_t ihi = khi > (uint64_t)c ? (khi - c + TF_M - 1) / TF_M : 0;
+            if (ilo >= ihi) continue;
+
+            // only use the primes which can cross off more than one (the rest don't save much)
+            int64_t nsc = 0;
+            while (nsc < ns && sp[nsc] < 2 * (int64_t)(ihi - ilo < TF_BLOCK ? ihi - ilo : TF_BLOCK)) nsc++;
+
+            // the first 'i' that each one crosses off, which are: i == -(2pc + 1) * (2p * TF_M)^-1 (mod s)
+            for (j = 0; j < nsc; ++j) {
+                s = sp[j];
+                int64_t t = (2 * (p % s) * c + 1) % s;
+                so[j] = ((s - t) * spi[j] + s - (int64_t)(ilo % s)) % s;
+
+                // if 2kp + 1 is the prime itself, then it is a factor, so leave it
+                uint64_t k = c + TF_M * (ilo + so[j]);
+                if (k < (uint64_t)s && 2 * (uint64_t)p * k + 1 == (uint64_t)s) so[j] += s;
+            }
+
+            uint64_t i0;
+            for (i0 = ilo; i0 < ihi && !tf->found; i0 += TF_BLOCK) {
+                int64_t len = ihi - i0 < TF_BLOCK ? (int64_t)(ihi - i0) : TF_BLOCK, i;
+                int64_t nw = (len + 63) / 64;
+                memset(sv, 0xff, nw * 8);
+                if (len % 64 != 0) sv[nw - 1] = ((uint64_t)1 << (len % 64)) - 1;
+
+                // cross off the 'i' where 2kp + 1 is divisible by a sieving prime (and keep where each left off)
+                for (j = 0; j < nsc; ++j) {
+                    s = sp[j];
+                    for (i = so[j]; i < len; i += s) sv[i / 64] &= ~((uint64_t)1 << (i % 64));
+                    so[j] = i - len;
+                }
+
+                // test the ones that are left, a batch at a time (the ones in a bit level are all the same size)
+                int64_t w;
+                n = 0;
+                for (w = 0; w <= nw && !tf->found; ++w) {
+                    uint64_t bw = w < nw ? sv[w] : 0;
+                    while (bw != 0 || (w == nw && n > 0)) {
+                        if (bw != 0) {
+                            i = 64 * w + __builtin_ctzll(bw);
+                            bw &= bw - 1;
+
+                            // q = 2kp + 1
+                            K[n] = c + TF_M * (i0 + i);
+                            Q0[n] = tf_mac(K[n], 2 * (uint64_t)p, 1, 0, &Q1[n]);
+                            if (++n < TF_BATCH) continue;
+                        }
+
+                        tf_test(p, n, Q0, Q1, D);
+                        tf->ntested += n;
+                        for (j = 0; j < n; ++j) {
+                            if (D[j]) {
+                                tf->found = true;
+                                tf->k = K[j];
+                                tf->q[0] = Q0[j];
+                                tf->q[1] = Q1[j];
+                                break;
+                            }
+                        }
+                        n = 0;
+                        if (tf->found) break;
+                    }
+                }
+            }
+        }
+    }
+
+    free(sp);
+    free(spi);
+    free(so);
+    free(sv);
+
+    return tf->found;
+}
@@ -2,12 +2,38 @@
  *
  */
 
+// for 'posix_memalign'
+#define _POSIX_C_SOURCE 200809L
+
 #include "MPT-impl.h"
 
 
+// the start time (see 'mpt_time_init')
+static struct timeval mpt_start_time = (struct timeval){ .tv_sec = 0, .tv_usec = 0 };
+
+// start the clock of 'mpt_time'
+void mpt_time_init() {
+    gettimeofday(&mpt_start_time, NULL);
+}
+
+// return the time since it started
+double mpt_time() {
+    struct timeval curtime;
+    gettimeofday(&curtime, NULL);
+    return (curtime.tv_sec - mpt_start_time.tv_sec) + 1.0e-6 * (curtime.tv_usec - mpt_start_time.tv_usec);
+}
+
+// allocate a buffer of 'sz' bytes (rounded up to a whole number of cache lines), aligned to MPT_ALIGN bytes
+void* mpt_alloc_aligned(size_t sz) {
+    void* res = NULL;
+    sz = (sz + MPT_ALIGN - 1) / MPT_ALIGN * MPT_ALIGN;
+    if (posix_memalign(&res, MPT_ALIGN, sz > 0 ? sz : MPT_ALIGN) != 0) return NULL;
+    return res;
+}
+
 // allocate a buffer for enough bits
 mpt_limb_t* mpt_alloc_bits(size_t bts) {
-    return malloc(bts / 8 + MPT_LIMB_SIZE * 8);
+    return mpt_alloc_aligned(bts / 8 + MPT_LIMB_SIZE * 8);
 }
 
 // set the 'p'th mersenne number
@@ -45,37 +71,32 @@ void mpt_set_0(mpt_limb_t* data, int64_t N) {
     
 }
 
-static const char hexchars[] = "0123456789abcdefg";
+static const char hexchars[] = "0123456789abcdef";
 
 // convert a number to hex string
 // 'sz' is the number of limbs 
 // NOTE: output should hold at least (sz * MPT_HDPL + 4) bytes
 void mpt_gethexstr(mpt_limb_t* Mp, int64_t sz, char* output) {
 
-    int64_t i, j, k = 0;
-    for (i = 0; i < sz; ++i) {
+    // a whole limb at a time, from the most significant, so each digit is just a shift (and the string comes out
+    //   in order)
+    int64_t i, k = 0;
+    int j;
+    for (i = sz - 1; i >= 0; --i) {
         mpt_limb_t word = Mp[i];
-        for (j = 0; j < MPT_HDPL; ++j) {
-            output[k++] = hexchars[word % 16];
-            word /= 16;
+        for (j = MPT_HDPL - 1; j >= 0; --j) {
+            output[k++] = hexchars[(word >> (4 * j)) & 0xf];
         }
     }
 
     // NUL-terminate
     output[k] = '\0';
 
-    // reverse output
-    for (i = 0; i * 2 < k; ++i) {
-        char t = output[i];
-        output[i] = output[k - i - 1];
-        output[k - i - 1] = t;
-    }
-
 }
 
 static int gethexdig(char c) {
-    /**/ if (c >= 'a' && c <= 'z') return 10 + c - 'a';
-    else if (c >= 'A' && c <= 'Z') return 10 + c - 'A';
+    /**/ if (c >= 'a' && c <= 'f') return 10 + c - 'a';
+    else if (c >= 'A' && c <= 'F') return 10 + c - 'A';
     else if (c >= '0' && c <= '9') return c - '0';
     return 0;
 }
@@ -83,31 +104,17 @@ static int gethexdig(char c) {
 void mpt_sethexstr(mpt_limb_t* Mp, int64_t N, char* str) {
 
     // allow prefix
-    if (str[0] == '0' && str[1] == 'x') str += 2;
-
-    int64_t slen = strlen(str);
-    int64_t i = slen - 1, j, k = 0;
-    
-
-    char tmps[256];
-    while (i >= 0) {
-
-        // get some hex digits
-        Mp[k] = 0;
-        j = 0;
-
-        while (i >= 0 && j < MPT_HDPL) {
-            tmps[j++] = str[i--];
+    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) str += 2;
+
+    // each limb is the next MPT_HDPL digits from the end (and any digits past 'N' limbs are ignored)
+    int64_t i = strlen(str), k;
+    int j;
+    for (k = 0; k < N; ++k) {
+        mpt_limb_t word = 0;
+        for (j = 0; j < (int)MPT_HDPL && i > 0; ++j) {
+            word |= (mpt_limb_t)gethexdig(str[--i]) << (4 * j);
         }
-
-        j--;
-        while (j >= 0) {
-            Mp[k] = 16 * Mp[k] + gethexdig(tmps[j--]);
-        }        
-
-        k++;
+        Mp[k] = word;
     }
-    
-    while (k < N) Mp[k++] = 0;
 
-}
\ No newline at end of file
+}
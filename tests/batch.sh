@@ -0,0 +1,40 @@
+#!/bin/sh
+# tests/batch.sh - test the batch driver (./MPT), which must find exactly the Mersenne primes in a range
+#
+# Each run has more threads than the machine may have cores, so the exponents finish out of order, and the
+#   results (one line of JSON each) are sorted before they are compared
+#
+
+MPT=./MPT
+status=0
+
+# the Mersenne prime exponents up to 5000, and the number of primes up to 5000 (each of which gets one line)
+known="2 3 5 7 13 17 19 31 61 89 107 127 521 607 1279 2203 2281 3217 4253 4423"
+nprimes=669
+
+# run MPT with the arguments, and check its results
+check() {
+    out=$($MPT "$@" 2>/dev/null)
+    if [ $? -ne 0 ]; then
+        echo "FAIL: '$MPT $*' failed" >&2
+        status=1
+        return
+    fi
+    got=$(echo "$out" | grep '"prime": true' | sed 's/^{"p": \([0-9]*\),.*/\1/' | sort -n | tr '\n' ' ' | sed 's/ $//')
+    n=$(echo "$out" | grep -c '"p": ')
+    if [ "$got" != "$known" ]; then
+        echo "FAIL: '$MPT $*' found: $got" >&2
+        status=1
+    fi
+    if [ "$n" -ne "$nprimes" ]; then
+        echo "FAIL: '$MPT $*' gave $n results, not $nprimes" >&2
+        status=1
+    fi
+}
+
+check -j 3 2 5000
+check -j 3 -t 0 -B 0 2 5000
+check -j 3 -e simd0 2 5000
+seq 1 5000 | check -j 2 -f -
+
+exit $status
@@ -0,0 +1,111 @@
+/* tests/ckpt.c - test the checkpoints of the LL test, and that each engine resumes from them
+ *
+ * The term after 'k' iterations is written to a checkpoint (with 'mpt_ckpt_save'), and then each engine must pick
+ *   up from it and get the right result. If the term in it is wrong (but the checkpoint is valid), the result
+ *   must be wrong too, which shows that the engine really resumed (rather than starting over), and a checkpoint
+ *   that has been damaged must be ignored
+ *
+ */
+
+// for 'mkdtemp'
+#define _POSIX_C_SOURCE 200809L
+
+#include "test.h"
+
+#include <unistd.h>
+
+
+// the exponent (M4423 is prime), and the iteration that the checkpoints are from
+#define CKPT_P 4423
+#define CKPT_ITER 2000
+
+// the engines that can resume from a checkpoint
+static const char* ckpt_engines[] = { "basic0", "ntt0", "fft0", "ifma0", NULL };
+
+// write a checkpoint of 'S' after 'iter' iterations, and wait for it to be written
+static void ckpt_write(mpt_limb_t* S, int64_t iter) {
+    mpt_ckpt_t c;
+    mpt_ckpt_init(&c, CKPT_P, "ll", "test");
+    mpt_ckpt_save(&c, S, iter);
+    mpt_ckpt_free(&c, false);
+}
+
+// return whether the checkpoint file is there
+static bool ckpt_exists(const char* path) {
+    return access(path, F_OK) == 0;
+}
+
+// run 'eng' (which should resume from the checkpoint), check its result, and that the checkpoint is gone after
+static void ckpt_check_engine(mpt_ctx_t* ctx, const char* name, const char* path, bool isp) {
+    const mpt_engine_t* eng = mpt_engine_find(name);
+    bool res = eng->test(ctx, CKPT_P);
+    TEST_CHECK(res == isp, "%s resumed M%i as %s", name, CKPT_P, res ? "prime" : "composite");
+    TEST_CHECK(!ckpt_exists(path), "%s left its checkpoint behind", name);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    char dir[] = "/tmp/MPT-ckpt-XXXXXX";
+    TEST_CHECK(mkdtemp(dir) != NULL, "couldn't make a temporary directory");
+    if (test_nfail > 0) return test_done();
+    mpt_ckpt_dir = dir;
+    char path[256];
+    snprintf(path, sizeof(path), "%s/M%i.ll.ckpt", dir, CKPT_P);
+
+    int64_t N = CKPT_P / MPT_LIMB_BITS + 1, i;
+    mpt_limb_t* S = calloc(N, MPT_LIMB_SIZE);
+    mpt_limb_t* R = calloc(N, MPT_LIMB_SIZE);
+    mpt_limb_t* T = malloc(mpt_ll_scratch(CKPT_P) * MPT_LIMB_SIZE);
+
+    // the term after CKPT_ITER iterations
+    S[0] = 4;
+    for (i = 0; i < CKPT_ITER; ++i) mpt_ll_step(CKPT_P, S, T);
+
+    // it comes back the same
+    ckpt_write(S, CKPT_ITER);
+    mpt_ckpt_t c;
+    mpt_ckpt_init(&c, CKPT_P, "ll", "test");
+    int64_t iter = mpt_ckpt_load(&c, R);
+    mpt_ckpt_free(&c, true);
+    TEST_CHECK(iter == CKPT_ITER && mpt_cmp(N, R, S) == 0, "the checkpoint was read back as iteration %lli", (long long int)iter);
+    TEST_CHECK(!ckpt_exists(path), "the checkpoint wasn't removed once the test was done");
+
+    // a damaged one is ignored (and the term is left alone)
+    ckpt_write(S, CKPT_ITER);
+    FILE* fp = fopen(path, "r+b");
+    if (fp != NULL) {
+        fseek(fp, -3, SEEK_END);
+        int ch = fgetc(fp);
+        fseek(fp, -3, SEEK_END);
+        fputc(ch ^ 0x10, fp);
+        fclose(fp);
+    }
+    memset(R, 0, N * MPT_LIMB_SIZE);
+    mpt_ckpt_init(&c, CKPT_P, "ll", "test");
+    iter = mpt_ckpt_load(&c, R);
+    mpt_ckpt_free(&c, true);
+    TEST_CHECK(iter == 0 && R[0] == 0, "a damaged checkpoint was read as iteration %lli", (long long int)iter);
+
+    // each engine resumes from the right term (and finds that M4423 is prime), and from the wrong one (so it doesn't)
+    mpt_ctx_t ctx;
+    mpt_ctx_init(&ctx);
+    int k;
+    for (k = 0; ckpt_engines[k] != NULL; ++k) {
+        ckpt_write(S, CKPT_ITER);
+        ckpt_check_engine(&ctx, ckpt_engines[k], path, true);
+
+        mpt_addl(N, S, 1);
+        ckpt_write(S, CKPT_ITER);
+        mpt_subl(N, S, 1);
+        ckpt_check_engine(&ctx, ckpt_engines[k], path, false);
+    }
+    mpt_ctx_free(&ctx);
+
+    free(S);
+    free(R);
+    free(T);
+    remove(path);
+    rmdir(dir);
+    return test_done();
+}
@@ -0,0 +1,80 @@
+/* tests/ctx.c - test the test contexts (see 'mpt_ctx_t'), and their arenas
+ *
+ * The arena must hand out aligned buffers that don't overlap, and after a reset, the same allocations must fit in
+ *   the memory it already has. A context must give the same results no matter which exponents it was used for
+ *   before, so the engines are run on exponents of very different sizes, in no particular order
+ *
+ */
+
+#include "test.h"
+
+
+// the sizes of the allocations (in bytes), which add up to more than the first block
+static const size_t ctx_sizes[] = { 1, 63, 64, 65, 1000, 4096, 100000, 7, 1 << 20, 3, 0 };
+
+// allocate 'ctx_sizes' from 'ar', fill each with its own byte, and check that they are aligned, and still hold
+//   their own byte after all of them have been filled (so none of them overlap)
+static void ctx_check_arena(mpt_arena_t* ar, char** ptrs) {
+    int i;
+    for (i = 0; ctx_sizes[i] != 0; ++i) {
+        ptrs[i] = mpt_arena_alloc(ar, ctx_sizes[i]);
+        TEST_CHECK((uintptr_t)ptrs[i] % MPT_ALIGN == 0, "an arena allocation of %zu bytes isn't aligned", ctx_sizes[i]);
+        memset(ptrs[i], i + 1, ctx_sizes[i]);
+    }
+    for (i = 0; ctx_sizes[i] != 0; ++i) {
+        size_t j;
+        for (j = 0; j < ctx_sizes[i] && ptrs[i][j] == (char)(i + 1); ++j);
+        TEST_CHECK(j == ctx_sizes[i], "an arena allocation of %zu bytes was overwritten", ctx_sizes[i]);
+    }
+}
+
+// an engine, on exponents of very different sizes, in no particular order (the Mersenne primes are 4423, 127,
+//   2203, 607, 3217, and 2)
+static void ctx_check_engine(mpt_ctx_t* ctx, const char* name) {
+    static const int64_t ps[] = { 4423, 127, 2203, 4421, 601, 2207, 607, 3217, 2, 0 };
+    static const bool isp[] = { true, true, true, false, false, false, true, true, true };
+    const mpt_engine_t* eng = mpt_engine_find(name);
+    int i;
+    for (i = 0; ps[i] != 0; ++i) {
+        bool res = eng->test(ctx, ps[i]);
+        TEST_CHECK(res == isp[i], "%s (after other exponents) says M%lli is %s", name, (long long int)ps[i], res ? "prime" : "composite");
+    }
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    // (plain aligned buffers)
+    size_t sz;
+    for (sz = 1; sz < 5000; sz = sz * 3 + 1) {
+        void* buf = mpt_alloc_aligned(sz);
+        TEST_CHECK((uintptr_t)buf % MPT_ALIGN == 0, "mpt_alloc_aligned of %zu bytes isn't aligned", sz);
+        free(buf);
+    }
+
+    // the first round takes more than one block, and after the reset, the same round fits in the one block
+    mpt_arena_t ar;
+    mpt_arena_init(&ar);
+    char* ptrs[sizeof(ctx_sizes) / sizeof(*ctx_sizes)];
+    ctx_check_arena(&ar, ptrs);
+    mpt_arena_reset(&ar);
+    size_t total = ar.total;
+    char* base = ar.base;
+    ctx_check_arena(&ar, ptrs);
+    TEST_CHECK(ar.total == total && ar.base == base, "the arena grew from %zu to %zu bytes after a reset", total, ar.total);
+    mpt_arena_reset(&ar);
+    TEST_CHECK(ar.total == total && ar.base == base, "the arena was reallocated after a reset");
+    mpt_arena_free(&ar);
+
+    // one context for all of them (which also switches between their plans)
+    mpt_ctx_t ctx;
+    mpt_ctx_init(&ctx);
+    ctx_check_engine(&ctx, "fft0");
+    ctx_check_engine(&ctx, "ntt0");
+    ctx_check_engine(&ctx, "ifma0");
+    ctx_check_engine(&ctx, "basic0");
+    ctx_check_engine(&ctx, "fft0");
+    mpt_ctx_free(&ctx);
+
+    return test_done();
+}
@@ -0,0 +1,82 @@
+/* tests/engines.c - test every engine on the known Mersenne primes and composites (see 'test_known')
+ *
+ * Each engine keeps one context for all of its exponents, the same as a thread of the batch driver. The engines
+ *   that test many exponents at once (see 'mpt_engine_t') are also given batches of them, with mixed sizes (and
+ *   ones that aren't prime), the same way the batch driver does
+ *
+ */
+
+#include "test.h"
+
+
+// an engine, and the largest exponent it is tested up to (so the slower ones don't take too long)
+typedef struct {
+    const char* name;
+    int64_t maxp;
+} engines_case_t;
+
+static const engines_case_t engines_cases[] = {
+    { "auto", 12000 },
+    { "basic0", 12000 },
+    { "ntt0", 4500 },
+    { "fft0", 12000 },
+    { "ifma0", 12000 },
+    { "prp0", 4500 },
+    { "simd0", 4500 },
+    { NULL, 0 },
+};
+
+// the engine being tested, and its context
+typedef struct {
+    const mpt_engine_t* eng;
+    mpt_ctx_t ctx;
+} engines_arg_t;
+
+static bool engines_test(void* arg, int64_t p) {
+    engines_arg_t* a = arg;
+    return a->eng->test(&a->ctx, p);
+}
+
+// test the batches of 'eng' (which has 'test_n'): every exponent up to 600 (a full batch at a time), some of
+//   mixed sizes, and ones that don't fill the lanes
+static void engines_check_n(const mpt_engine_t* eng, mpt_ctx_t* ctx) {
+    static const int64_t mixed[] = { 4423, 3, 127, 4421, 1279, 2, 9, 607, 1277, 31, 4, 0 };
+    int64_t p[64];
+    bool res[64];
+    int n, l;
+
+    for (p[0] = 1; p[0] <= 600; p[0] += eng->lanes) {
+        for (l = 1; l < eng->lanes; ++l) p[l] = p[0] + l;
+        eng->test_n(ctx, eng->lanes, p, res);
+        for (l = 0; l < eng->lanes; ++l) {
+            TEST_CHECK(res[l] == test_is_mp(p[l]), "%s says M%lli is %s (in a batch)", eng->name, (long long int)p[l], res[l] ? "prime" : "composite");
+        }
+    }
+
+    for (n = 1; n <= eng->lanes; ++n) {
+        for (l = 0; l < n; ++l) p[l] = mixed[(n + l) % 11];
+        eng->test_n(ctx, n, p, res);
+        for (l = 0; l < n; ++l) {
+            TEST_CHECK(res[l] == test_is_mp(p[l]), "%s says M%lli is %s (in a batch of %i)", eng->name, (long long int)p[l], res[l] ? "prime" : "composite", n);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    int k;
+    for (k = 0; engines_cases[k].name != NULL; ++k) {
+        engines_arg_t a;
+        a.eng = mpt_engine_find(engines_cases[k].name);
+        TEST_CHECK(a.eng != NULL, "there is no engine '%s'", engines_cases[k].name);
+        if (a.eng == NULL) continue;
+
+        mpt_ctx_init(&a.ctx);
+        test_known(engines_cases[k].name, engines_test, &a, engines_cases[k].maxp);
+        if (a.eng->test_n != NULL) engines_check_n(a.eng, &a.ctx);
+        mpt_ctx_free(&a.ctx);
+    }
+
+    return test_done();
+}
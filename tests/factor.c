@@ -0,0 +1,98 @@
+/* tests/factor.c - test the factoring of 2^p - 1 against known factors
+ *
+ * Each trial factoring is given exactly enough bits to reach the smallest factor (and not the next one), so it
+ *   must find that factor, and with one bit less (or for a Mersenne prime), it must find nothing. Each P-1 is given
+ *   bounds that reach exactly one factor 'q' (in the stage that 'q - 1' needs), or none
+ *
+ */
+
+#include "test.h"
+
+
+// an exponent, and the smallest factor of 2^p - 1 (or 0, if it is prime), which is the only one below 2^bits
+typedef struct {
+    int64_t p;
+    uint64_t q;
+    int bits;
+} factor_case_t;
+
+static const factor_case_t factor_cases[] = {
+    { 11, 23, 5 },
+    { 23, 47, 6 },
+    { 29, 233, 8 },
+    { 37, 223, 8 },
+    { 43, 431, 9 },
+    { 47, 2351, 12 },
+    { 67, 193707721, 28 },
+    { 73, 439, 9 },
+    { 83, 167, 8 },
+    { 103, 2550183799ULL, 32 },
+    { 31, 0, 31 },
+    { 61, 0, 40 },
+    { 89, 0, 32 },
+    { 0, 0, 0 },
+};
+
+// trial factor 'c->p' up to 'bits' bits, and check that it finds 'q' (or nothing, if 'q' is 0)
+static void factor_check_tf(const factor_case_t* c, int bits, uint64_t q) {
+    mpt_tf_t tf;
+    bool found = mpt_tf(&tf, c->p, bits);
+    TEST_CHECK(found == (q != 0) && tf.found == found, "TF of M%lli to %i bits: found=%i", (long long int)c->p, bits, (int)found);
+    if (found && q != 0) {
+        TEST_CHECK(tf.q[1] == 0 && tf.q[0] == q, "TF of M%lli to %i bits found %llu, not %llu", (long long int)c->p, bits, (unsigned long long int)tf.q[0], (unsigned long long int)q);
+        TEST_CHECK(tf.k * 2 * c->p + 1 == q, "TF of M%lli found k=%llu", (long long int)c->p, (unsigned long long int)tf.k);
+    }
+}
+
+// an exponent, the bounds of P-1, and the factor of 2^p - 1 that they find (and in which stage), or 0
+typedef struct {
+    int64_t p, B1, B2;
+    uint64_t q;
+    int stage;
+} factor_pm1_case_t;
+
+static const factor_pm1_case_t factor_pm1_cases[] = {
+    // 193707721 - 1 = 2^3 * 3^3 * 5 * 67 * 2677, and 761838257287 - 1 needs 8539
+    { 67, 3000, 3000, 193707721, 1 },
+    // 228479 - 1 = 2 * 71 * 1609, and the others need 7349 and 17093
+    { 71, 1000, 2000, 228479, 2 },
+    { 71, 1000, 1000, 0, 0 },
+    { 89, 10000, 200000, 0, 0 },
+    { 127, 10000, 200000, 0, 0 },
+    { 0, 0, 0, 0, 0 },
+};
+
+// run P-1, and check that it finds 'c->q' (or nothing)
+static void factor_check_pm1(const factor_pm1_case_t* c) {
+    int64_t N = c->p / MPT_LIMB_BITS + 1, i;
+    mpt_pm1_t pm1;
+    bool found = mpt_pm1(&pm1, c->p, c->B1, c->B2);
+    TEST_CHECK(found == (c->q != 0), "P-1 of M%lli with B1=%lli, B2=%lli: found=%i", (long long int)c->p, (long long int)c->B1, (long long int)c->B2, (int)found);
+    if (found && c->q != 0) {
+        // (the factor, as limbs)
+        mpt_limb_t* Q = malloc(N * MPT_LIMB_SIZE);
+        uint64_t v = c->q;
+        for (i = 0; i < N; ++i) {
+            Q[i] = (mpt_limb_t)v;
+            v = MPT_LIMB_BITS < 64 ? v >> (MPT_LIMB_BITS % 64) : 0;
+        }
+        TEST_CHECK(mpt_cmp(N, pm1.f, Q) == 0, "P-1 of M%lli didn't find %llu", (long long int)c->p, (unsigned long long int)c->q);
+        TEST_CHECK(pm1.stage == c->stage, "P-1 of M%lli found %llu in stage %i", (long long int)c->p, (unsigned long long int)c->q, pm1.stage);
+        free(Q);
+    }
+    mpt_pm1_free(&pm1);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    int i;
+    for (i = 0; factor_cases[i].p != 0; ++i) {
+        const factor_case_t* c = &factor_cases[i];
+        factor_check_tf(c, c->bits, c->q);
+        if (c->q != 0) factor_check_tf(c, c->bits - 1, 0);
+    }
+    for (i = 0; factor_pm1_cases[i].p != 0; ++i) factor_check_pm1(&factor_pm1_cases[i]);
+
+    return test_done();
+}
@@ -0,0 +1,67 @@
+/* tests/isprime.c - test 'mpt_isprime_u64' against trial division, and on the numbers that fool weaker tests
+ *
+ */
+
+#include "test.h"
+
+// (for 'mpt_isprime_u64', which is static)
+#include "MPT-impl.h"
+
+
+// return whether 'n' is prime, by trial division (so 'n' should be less than about 2^40)
+static bool isprime_slow(uint64_t n) {
+    uint64_t d;
+    if (n < 2) return false;
+    for (d = 2; d * d <= n; ++d) {
+        if (n % d == 0) return false;
+    }
+    return true;
+}
+
+// check every number in [lo, hi) against trial division
+static void isprime_check_range(uint64_t lo, uint64_t hi) {
+    uint64_t n;
+    for (n = lo; n < hi; ++n) {
+        bool res = mpt_isprime_u64(n), exp = isprime_slow(n);
+        TEST_CHECK(res == exp, "mpt_isprime_u64 says %llu is %s", (unsigned long long int)n, res ? "prime" : "composite");
+    }
+}
+
+// check a single number
+static void isprime_check(uint64_t n, bool exp) {
+    bool res = mpt_isprime_u64(n);
+    TEST_CHECK(res == exp, "mpt_isprime_u64 says %llu is %s", (unsigned long long int)n, res ? "prime" : "composite");
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    // small ones, and around the switch to more bases (2^32)
+    isprime_check_range(0, 200000);
+    isprime_check_range(((uint64_t)1 << 32) - 3000, ((uint64_t)1 << 32) + 3000);
+    isprime_check_range(1000000000000ULL, 1000000000000ULL + 200);
+
+    // the smallest strong pseudoprimes to the first few prime bases (each fools all the bases before it), and
+    //   Carmichael numbers
+    static const uint64_t psp[] = {
+        2047, 1373653, 25326001, 3215031751ULL, 2152302898747ULL, 3474749660383ULL, 341550071728321ULL,
+        3825123056546413051ULL, 561, 1105, 41041, 0
+    };
+    int i;
+    for (i = 0; psp[i] != 0; ++i) isprime_check(psp[i], false);
+
+    // large primes, and composites with large factors (up to the top of the range)
+    isprime_check(2305843009213693951ULL, true);
+    isprime_check(576460752303423487ULL, false);
+    isprime_check(1000000000000000003ULL, true);
+    isprime_check(4294967291ULL * 4294967291ULL, false);
+    isprime_check(4294967291ULL * 4294967279ULL, false);
+    isprime_check(18446744073709551557ULL, true);
+    isprime_check(18446744073709551559ULL, false);
+    isprime_check(18446744073709551615ULL, false);
+
+    // (negative numbers aren't prime)
+    TEST_CHECK(!mpt_isprime(-7), "mpt_isprime says -7 is prime");
+
+    return test_done();
+}
@@ -0,0 +1,276 @@
+/* tests/mod.c - test the arithmetic (mod 2^p - 1)
+ *
+ * The reductions and the squarings (mod 2^p - 1) are checked against a slow reduction that just adds the part
+ *   past bit 'p' back onto the bottom until it fits (see 'mod_ref'). Then each of the other representations
+ *   (see 'mod_reps') squares a random number (minus 2, as in the LL test) a few times, along with 'mpt_sqr_mod',
+ *   and each result must be the same
+ *
+ */
+
+#include "test.h"
+
+
+// the number of squarings for each exponent
+#define MOD_ITERS 20
+
+// C = A - c (mod 2^p - 1), fully reduced, where 'A' has 'NA' limbs, and 'C' has (p / MPT_LIMB_BITS + 1)
+static void mod_ref(int64_t NA, mpt_limb_t* A, mpt_limb_t* C, int64_t p, mpt_limb_t c) {
+    int64_t N = p / MPT_LIMB_BITS + 1, M = (NA > N ? NA : N) + 1, q = p / MPT_LIMB_BITS, i;
+    int r = p % MPT_LIMB_BITS;
+    mpt_limb_t mask = ((mpt_limb_t)1 << r) - 1;
+    mpt_limb_t* X = calloc(M, MPT_LIMB_SIZE);
+    mpt_limb_t* H = calloc(M, MPT_LIMB_SIZE);
+
+    // X = A + (2^p - 1 - c), which is never negative
+    memcpy(X, A, NA * MPT_LIMB_SIZE);
+    for (i = 0; i < q; ++i) H[i] = ~(mpt_limb_t)0;
+    H[q] = mask;
+    mpt_subl(M, H, c);
+    mpt_add_n(M, X, X, H);
+
+    // X = (X mod 2^p) + (X >> p), until the part past bit 'p' is 0
+    for (;;) {
+        memset(H, 0, M * MPT_LIMB_SIZE);
+        for (i = q; i < M; ++i) H[i - q] = X[i];
+        if (r > 0) mpt_rshift(M, H, H, r);
+        for (i = 0; i < M && H[i] == 0; ++i);
+        if (i == M) break;
+
+        for (i = q + 1; i < M; ++i) X[i] = 0;
+        X[q] &= mask;
+        mpt_add_n(M, X, X, H);
+    }
+
+    // (2^p - 1 is 0)
+    for (i = 0; i < q && X[i] == (mpt_limb_t)~(mpt_limb_t)0; ++i);
+    if (i == q && X[q] == mask) memset(X, 0, N * MPT_LIMB_SIZE);
+
+    memcpy(C, X, N * MPT_LIMB_SIZE);
+    free(X);
+    free(H);
+}
+
+// check the reductions, and the squarings (mod 2^p - 1), on a random number
+static void mod_check_ref(int64_t p, uint64_t* s) {
+    static const mpt_limb_t cs[] = { 0, 2, 5 };
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    mpt_limb_t* A = malloc(2 * N * MPT_LIMB_SIZE);
+    mpt_limb_t* A2 = malloc(2 * N * MPT_LIMB_SIZE);
+    mpt_limb_t* C = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* R = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* T = malloc(mpt_ll_scratch(p) * MPT_LIMB_SIZE);
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        mpt_limb_t c = cs[i];
+        if (p < 4 && c >= 2) continue;
+
+        // any number of up to 2N limbs
+        test_fill(2 * N, A, s);
+        mod_ref(2 * N, A, R, p, c);
+        mpt_mod2pm1_c(2 * N, A, C, p, c);
+        TEST_CHECK(mpt_cmp(N, C, R) == 0, "mpt_mod2pm1_c of M%lli, c=%i", (long long int)p, (int)c);
+        mpt_mod2pm1_par(2 * N, A, C, p, c, 3);
+        TEST_CHECK(mpt_cmp(N, C, R) == 0, "mpt_mod2pm1_par of M%lli, c=%i", (long long int)p, (int)c);
+
+        // the square of any number of N limbs (which doesn't have to be reduced)
+        mpt_sqr_naive(N, A, A2);
+        mod_ref(2 * N, A2, R, p, c);
+        if (N < MPT_SQR_KARA_THRESH) {
+            mpt_sqr_mod2pm1(N, A, C, p, c);
+            TEST_CHECK(mpt_cmp(N, C, R) == 0, "mpt_sqr_mod2pm1 of M%lli, c=%i", (long long int)p, (int)c);
+        }
+        memcpy(C, A, N * MPT_LIMB_SIZE);
+        mpt_sqr_mod(p, C, c, T);
+        TEST_CHECK(mpt_cmp(N, C, R) == 0, "mpt_sqr_mod of M%lli, c=%i", (long long int)p, (int)c);
+        if (c == 2) {
+            memcpy(C, A, N * MPT_LIMB_SIZE);
+            mpt_ll_step(p, C, T);
+            TEST_CHECK(mpt_cmp(N, C, R) == 0, "mpt_ll_step of M%lli", (long long int)p);
+        }
+    }
+
+    free(A);
+    free(A2);
+    free(C);
+    free(R);
+    free(T);
+}
+
+// check the unrolled kernels (see 'mpt_kern_t') of every kernel version that has them, for every 'p' up to
+//   MPT_SQR_SMALL_N limbs, on a random number less than 2^p
+static void mod_check_small(uint64_t* s) {
+    static const char* kerns[] = { "generic", "adx", "avx2", "avx512", NULL };
+    static const mpt_limb_t cs[] = { 0, 2, 5 };
+    mpt_limb_t S[MPT_SQR_SMALL_N], A[MPT_SQR_SMALL_N], A2[2 * MPT_SQR_SMALL_N], R[MPT_SQR_SMALL_N];
+    int k, i;
+    for (k = 0; kerns[k] != NULL; ++k) {
+        if (!mpt_kern_init(kerns[k]) || mpt_kern.sqr_small == NULL) continue;
+
+        int64_t p;
+        for (p = 3; p < MPT_SQR_SMALL_N * (int64_t)MPT_LIMB_BITS; ++p) {
+            int64_t N = p / MPT_LIMB_BITS + 1;
+            if (p % MPT_LIMB_BITS == 0) continue;
+            for (i = 0; i < 3; ++i) {
+                mpt_limb_t c = cs[i];
+                if (p < 4 && c >= 2) continue;
+                test_fill(N, A, s);
+                A[N - 1] &= ((mpt_limb_t)1 << (p % MPT_LIMB_BITS)) - 1;
+                memcpy(S, A, N * MPT_LIMB_SIZE);
+                mpt_kern.sqr_small[N](S, p, c);
+                mpt_sqr_naive(N, A, A2);
+                mod_ref(2 * N, A2, R, p, c);
+                TEST_CHECK(mpt_cmp(N, S, R) == 0, "the unrolled '%s' kernel of M%lli, c=%i", kerns[k], (long long int)p, (int)c);
+            }
+        }
+    }
+    mpt_kern_init(getenv("MPT_KERN"));
+}
+
+// a number (mod 2^p - 1) in one of the representations
+typedef union {
+    mpt_fft_t fft;
+    mpt_r52_t r52;
+} mod_num_t;
+
+// a representation: its name, and how to set it up for 'p' (with the number 'S'), square it (returning the
+//   roundoff error, if it has one), get it back into 'S', and free it
+typedef struct {
+    const char* name;
+    void (*init)(mod_num_t* x, int64_t p, mpt_limb_t* S);
+    double (*sqr)(mod_num_t* x, int64_t c);
+    void (*get)(mod_num_t* x, mpt_limb_t* S);
+    void (*free)(mod_num_t* x);
+} mod_rep_t;
+
+// the IBDWT (see 'mpt_fft_t'), with the default number of digits
+static void mod_fft_init(mod_num_t* x, int64_t p, mpt_limb_t* S) {
+    mpt_fft_init(&x->fft, p, 0);
+    mpt_fft_set(&x->fft, S);
+}
+
+// the IBDWT, with enough digits that the complex transform is done in four steps (see MPT_FFT_4STEP_THRESH)
+static void mod_fft4_init(mod_num_t* x, int64_t p, mpt_limb_t* S) {
+    mpt_fft_init(&x->fft, p, 2 * MPT_FFT_4STEP_THRESH);
+    mpt_fft_set(&x->fft, S);
+}
+
+static double mod_fft_sqr(mod_num_t* x, int64_t c) {
+    return mpt_fft_sqr(&x->fft, c);
+}
+
+static void mod_fft_get(mod_num_t* x, mpt_limb_t* S) {
+    mpt_fft_get(&x->fft, S);
+}
+
+static void mod_fft_free(mod_num_t* x) {
+    mpt_fft_free(&x->fft);
+}
+
+// 52 bit digits (see 'mpt_r52_t'), with IFMA (if the CPU and the kernels have it), and with the scalar code
+static void mod_r52_init(mod_num_t* x, int64_t p, mpt_limb_t* S) {
+    mpt_r52_init(&x->r52, p);
+    mpt_r52_set(&x->r52, S);
+}
+
+static void mod_r52s_init(mod_num_t* x, int64_t p, mpt_limb_t* S) {
+    mod_r52_init(x, p, S);
+    x->r52.ifma = false;
+}
+
+static double mod_r52_sqr(mod_num_t* x, int64_t c) {
+    mpt_r52_sqr(&x->r52, c);
+    return 0;
+}
+
+static void mod_r52_get(mod_num_t* x, mpt_limb_t* S) {
+    mpt_r52_get(&x->r52, S);
+}
+
+static void mod_r52_free(mod_num_t* x) {
+    mpt_r52_free(&x->r52);
+}
+
+static const mod_rep_t mod_reps[] = {
+    { "IBDWT", mod_fft_init, mod_fft_sqr, mod_fft_get, mod_fft_free },
+    { "R52", mod_r52_init, mod_r52_sqr, mod_r52_get, mod_r52_free },
+    { "R52 (scalar)", mod_r52s_init, mod_r52_sqr, mod_r52_get, mod_r52_free },
+    { NULL, NULL, NULL, NULL, NULL },
+};
+
+// (which is only for large exponents, so it isn't in 'mod_reps')
+static const mod_rep_t mod_fft4 = { "IBDWT (four-step)", mod_fft4_init, mod_fft_sqr, mod_fft_get, mod_fft_free };
+
+// square a random number (mod 2^p - 1) with 'rep', and check it against 'mpt_sqr_mod' (and that the roundoff
+//   error stays safely below 0.5)
+static void mod_check(const mod_rep_t* rep, int64_t p, uint64_t* s) {
+    int64_t N = p / MPT_LIMB_BITS + 1;
+    mpt_limb_t* S = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* R = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* T = malloc(mpt_ll_scratch(p) * MPT_LIMB_SIZE);
+
+    // (less than 2^p)
+    test_fill(N, S, s);
+    S[N - 1] &= ((mpt_limb_t)1 << (p % MPT_LIMB_BITS)) - 1;
+
+    mod_num_t x;
+    rep->init(&x, p, S);
+
+    int i;
+    double maxerr = 0;
+    for (i = 0; i < MOD_ITERS; ++i) {
+        double err = rep->sqr(&x, 2);
+        if (err > maxerr) maxerr = err;
+        mpt_sqr_mod(p, S, 2, T);
+        rep->get(&x, R);
+        if (mpt_cmp(N, R, S) != 0) break;
+    }
+    TEST_CHECK(i == MOD_ITERS, "%s of M%lli differs after %i squarings", rep->name, (long long int)p, i + 1);
+    TEST_CHECK(maxerr < 0.4, "%s of M%lli has a roundoff error of %g", rep->name, (long long int)p, maxerr);
+
+    rep->free(&x);
+    free(S);
+    free(R);
+    free(T);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    uint64_t s = 7;
+    int k;
+
+    // every size of the unrolled kernels, the basecase, and past it (but not multiples of the limb size, see
+    //   'mpt_fold_t')
+    int64_t ps[] = { 3, 5, 7, 61, 65, 89, 127, 521, 607, 1001, 1279, 4253, 5119, 5209, 9941, 21701, 86243, 0 };
+    for (k = 0; ps[k] != 0; ++k) mod_check_ref(ps[k], &s);
+    int64_t p;
+    for (p = 2; p <= 1100; p += 9) {
+        if (p % MPT_LIMB_BITS != 0) mod_check_ref(p, &s);
+    }
+
+    mod_check_small(&s);
+
+    // with more threads, past where the reduction is done in parallel (see MPT_MOD_PAR_THRESH)
+    mpt_sqr_threads = 3;
+    mod_check_ref(21701, &s);
+    mod_check_ref(MPT_MOD_PAR_THRESH * MPT_LIMB_BITS + 7, &s);
+    mpt_sqr_threads = 1;
+
+    for (k = 0; mod_reps[k].name != NULL; ++k) {
+        for (p = 3; p < 600; p += 14) mod_check(&mod_reps[k], p, &s);
+        mod_check(&mod_reps[k], 4423, &s);
+        mod_check(&mod_reps[k], 21701, &s);
+        mod_check(&mod_reps[k], 86243, &s);
+    }
+
+    // the four-step transform, on 1 thread and on more (which split up the rows and columns)
+    for (k = 1; k <= 3; k += 2) {
+        mpt_sqr_threads = k;
+        mod_check(&mod_fft4, 86243, &s);
+        mod_check(&mod_fft4, 756839, &s);
+    }
+    mpt_sqr_threads = 1;
+
+    return test_done();
+}
@@ -0,0 +1,124 @@
+/* tests/plan.c - test the plan cache (see 'mpt_plan_get'), in memory and in files
+ *
+ * The tables here are just a pattern that depends on the length, and the number of times they are computed is
+ *   counted, so each way of getting them can be checked: computed once (even by many threads at once), mapped
+ *   from the file that was written, and computed again if the file is damaged
+ *
+ */
+
+// for 'mkdtemp'
+#define _POSIX_C_SOURCE 200809L
+
+#include "test.h"
+
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// the kind and length of the tables here (a length that no transform uses), and their size
+#define PLAN_KIND MPT_PLAN_NTT
+#define PLAN_LEN 777
+#define PLAN_SIZE(_len) ((size_t)(_len) * sizeof(uint64_t))
+
+// the number of times the tables were computed
+static int plan_nfill = 0;
+
+static void plan_fill(void* data, int64_t len) {
+    uint64_t* W = data;
+    int64_t i;
+    for (i = 0; i < len; ++i) W[i] = (uint64_t)len * 1000003 + (uint64_t)i;
+    #pragma omp atomic
+    plan_nfill++;
+}
+
+// get the tables of 'len', and check that they were computed 'nfill' times so far, and that they are right
+static const uint64_t* plan_check(const char* what, int64_t len, int nfill) {
+    const uint64_t* W = mpt_plan_get(PLAN_KIND, len, PLAN_SIZE(len), plan_fill);
+    int64_t i;
+    for (i = 0; i < len && W[i] == (uint64_t)len * 1000003 + (uint64_t)i; ++i);
+    TEST_CHECK(i == len, "%s: the tables of %lli are wrong", what, (long long int)len);
+    TEST_CHECK((uintptr_t)W % MPT_ALIGN == 0, "%s: the tables of %lli aren't aligned", what, (long long int)len);
+    TEST_CHECK(plan_nfill == nfill, "%s: the tables were computed %i times, not %i", what, plan_nfill, nfill);
+    return W;
+}
+
+// run 'name' on M4423 (prime) and M4421 (not)
+static void plan_check_engine(mpt_ctx_t* ctx, const char* name) {
+    const mpt_engine_t* eng = mpt_engine_find(name);
+    TEST_CHECK(eng->test(ctx, 4423) && !eng->test(ctx, 4421), "%s with the plans from files", name);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    // in memory, the same tables every time
+    const uint64_t* W = plan_check("the first time", PLAN_LEN, 1);
+    TEST_CHECK(plan_check("the second time", PLAN_LEN, 1) == W, "the tables were moved");
+    TEST_CHECK(plan_check("another length", PLAN_LEN + 1, 2) != W, "two lengths have the same tables");
+
+    // many threads at once (after they're cleared), which still compute them once
+    mpt_plan_clear();
+    plan_nfill = 0;
+    const uint64_t* Wt[8];
+    int i;
+    #pragma omp parallel for num_threads(8)
+    for (i = 0; i < 8; ++i) Wt[i] = mpt_plan_get(PLAN_KIND, PLAN_LEN, PLAN_SIZE(PLAN_LEN), plan_fill);
+    for (i = 1; i < 8; ++i) TEST_CHECK(Wt[i] == Wt[0], "two threads got different tables");
+    plan_check("from many threads", PLAN_LEN, 1);
+
+    // in files, which are written the first time, and then mapped
+    char dir[] = "/tmp/MPT-plan-XXXXXX";
+    TEST_CHECK(mkdtemp(dir) != NULL, "couldn't make a temporary directory");
+    if (test_nfail > 0) return test_done();
+    mpt_plan_dir = dir;
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ntt-%i.plan", dir, PLAN_LEN);
+
+    mpt_plan_clear();
+    plan_nfill = 0;
+    plan_check("before the file", PLAN_LEN, 1);
+    TEST_CHECK(access(path, F_OK) == 0, "the plan file '%s' wasn't written", path);
+    mpt_plan_clear();
+    plan_check("from the file", PLAN_LEN, 1);
+
+    // a damaged file is ignored (and they're computed again)
+    FILE* fp = fopen(path, "r+b");
+    if (fp != NULL) {
+        fseek(fp, -5, SEEK_END);
+        int ch = fgetc(fp);
+        fseek(fp, -5, SEEK_END);
+        fputc(ch ^ 0x01, fp);
+        fclose(fp);
+    }
+    mpt_plan_clear();
+    plan_check("from a damaged file", PLAN_LEN, 2);
+    mpt_plan_clear();
+    remove(path);
+
+    // the engines, with their plans written to files, and then mapped from them
+    mpt_ctx_t ctx;
+    int k;
+    for (k = 0; k < 2; ++k) {
+        mpt_ctx_init(&ctx);
+        plan_check_engine(&ctx, "ntt0");
+        plan_check_engine(&ctx, "fft0");
+        mpt_ctx_free(&ctx);
+        mpt_plan_clear();
+    }
+
+    // (remove the files the engines wrote)
+    int64_t len;
+    for (len = 1; len <= ((int64_t)1 << 24); len *= 2) {
+        snprintf(path, sizeof(path), "%s/ntt-%lli.plan", dir, (long long int)len);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/fft-%lli.plan", dir, (long long int)len);
+        remove(path);
+    }
+    TEST_CHECK(rmdir(dir) == 0, "there are files left in '%s'", dir);
+    mpt_plan_dir = NULL;
+
+    return test_done();
+}
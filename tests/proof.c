@@ -0,0 +1,113 @@
+/* tests/proof.c - test that a real PRP proof verifies, and that forged ones don't
+ *
+ * The forged proofs have a term that isn't a unit (mod 2^p - 1), like 0, which could make both sides of the
+ *   claim 0, so they would pass if the verifier didn't reject them
+ *
+ */
+
+// for 'mkdtemp'
+#define _POSIX_C_SOURCE 200809L
+
+#include "test.h"
+
+#include <unistd.h>
+
+
+// the size of the header of a proof, and the number of 64 bit words per term (see 'src/proof.c')
+#define PROOF_HDR 24
+#define PROOF_WORDS(_p) (((_p) + 63) / 64)
+
+// write a proof to 'fname', with the header 'hdr', the last term 'B', and every middle term set to 'M' (only
+//   the low word of the terms is given, and the rest is 0, unless 'ones' is set, in which case they're all 1s)
+static void proof_forge(const char* fname, const uint8_t* hdr, int64_t p, int k, uint64_t B, uint64_t M, bool ones) {
+    FILE* fp = fopen(fname, "wb");
+    fwrite(hdr, 1, PROOF_HDR, fp);
+    int64_t n = PROOF_WORDS(p), i, j;
+    for (i = 0; i <= k; ++i) {
+        for (j = 0; j < n; ++j) {
+            // (the bits past 'p' must be 0)
+            uint64_t w = ones ? (j == n - 1 && p % 64 != 0 ? ((uint64_t)1 << (p % 64)) - 1 : ~(uint64_t)0) : 0;
+            if (j == 0 && !ones) w = i == 0 ? B : M;
+            fwrite(&w, sizeof(w), 1, fp);
+        }
+    }
+    fclose(fp);
+}
+
+// verify 'fname', and check that the result is 'valid'
+static void proof_check(const char* what, const char* fname, bool valid) {
+    mpt_verify_t v;
+    mpt_proof_verify(&v, fname);
+    TEST_CHECK(v.valid == valid, "%s: valid=%i, why: %s", what, (int)v.valid, v.why ? v.why : "(none)");
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    char dir[] = "/tmp/MPT-proof-XXXXXX";
+    TEST_CHECK(mkdtemp(dir) != NULL, "couldn't make a temporary directory");
+    if (test_nfail > 0) return test_done();
+    mpt_proof_dir = dir;
+
+    mpt_ctx_t ctx;
+    mpt_ctx_init(&ctx);
+
+    // M4409 isn't prime, and M4423 is
+    int64_t ps[] = { 4409, 4423 };
+    int pi;
+    for (pi = 0; pi < 2; ++pi) {
+        int64_t p = ps[pi];
+        int k = mpt_proof_power(p);
+        char real[256], fake[256];
+        snprintf(real, sizeof(real), "%s/M%lli.proof", dir, (long long int)p);
+        snprintf(fake, sizeof(fake), "%s/M%lli.fake", dir, (long long int)p);
+
+        mpt_prp_t prp;
+        mpt_prp(&prp, p, &ctx);
+        TEST_CHECK(prp.proof, "no proof was written for M%lli", (long long int)p);
+        if (!prp.proof) continue;
+        proof_check("a real proof", real, true);
+
+        uint8_t hdr[PROOF_HDR];
+        FILE* fp = fopen(real, "rb");
+        size_t got = fread(hdr, 1, PROOF_HDR, fp);
+        fclose(fp);
+        TEST_CHECK(got == PROOF_HDR, "couldn't read the proof of M%lli", (long long int)p);
+        if (got != PROOF_HDR) continue;
+
+        // a forged result of 5 (i.e. not a PRP), with zeros in the middle
+        proof_forge(fake, hdr, p, k, 5, 0, false);
+        proof_check("a forged proof with B=5, and zero middles", fake, false);
+
+        // a forged result of 9 (i.e. a PRP), with zeros in the middle
+        proof_forge(fake, hdr, p, k, 9, 0, false);
+        proof_check("a forged proof with B=9, and zero middles", fake, false);
+
+        // every term is 0 (and 2^p - 1, which is the same thing)
+        proof_forge(fake, hdr, p, k, 0, 0, false);
+        proof_check("a forged proof of all zeros", fake, false);
+        proof_forge(fake, hdr, p, k, 0, 0, true);
+        proof_check("a forged proof of all ones", fake, false);
+
+        // the real proof, with only the first middle set to 0
+        fp = fopen(real, "rb");
+        FILE* fo = fopen(fake, "wb");
+        int64_t n = PROOF_WORDS(p), i;
+        uint64_t w;
+        for (i = 0; fread(&w, sizeof(w), 1, fp) == 1; ++i) {
+            // (the header is 3 words, then 'B', then the middles)
+            if (i >= 3 + n && i < 3 + 2 * n) w = 0;
+            fwrite(&w, sizeof(w), 1, fo);
+        }
+        fclose(fp);
+        fclose(fo);
+        proof_check("a real proof, with the first middle set to 0", fake, false);
+
+        remove(real);
+        remove(fake);
+    }
+
+    mpt_ctx_free(&ctx);
+    rmdir(dir);
+    return test_done();
+}
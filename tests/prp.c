@@ -0,0 +1,34 @@
+/* tests/prp.c - test that the Gerbicz-Li checks of the PRP test catch an error, and recover from it
+ *
+ * A bit is flipped in the middle of each test (see 'mpt_prp_inject'), and the result must still be right
+ *
+ */
+
+#include "test.h"
+
+
+// run the PRP test of 2^p - 1 with an error at iteration 'inj', and check that it was caught, and the result
+static void prp_check(mpt_ctx_t* ctx, int64_t p, int64_t inj, bool isprp) {
+    mpt_prp_inject = inj;
+    mpt_prp_t prp;
+    mpt_prp(&prp, p, ctx);
+    TEST_CHECK(prp.prp == isprp, "M%lli with an error at iteration %lli: prp=%i", (long long int)p, (long long int)inj, (int)prp.prp);
+    TEST_CHECK(prp.nerrors >= 1, "M%lli with an error at iteration %lli: no errors in %lli checks", (long long int)p, (long long int)inj, (long long int)prp.nchecks);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    mpt_ctx_t ctx;
+    mpt_ctx_init(&ctx);
+
+    // M4423 is prime, and M4421 isn't, and the errors are early, in the middle, and in the last block
+    prp_check(&ctx, 4423, 100, true);
+    prp_check(&ctx, 4423, 2000, true);
+    prp_check(&ctx, 4421, 2000, false);
+    prp_check(&ctx, 4423, 4400, true);
+
+    mpt_ctx_free(&ctx);
+    mpt_prp_inject = 0;
+    return test_done();
+}
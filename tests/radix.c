@@ -0,0 +1,69 @@
+/* tests/radix.c - test the decimal conversions (see 'src/radix.c')
+ *
+ * Random numbers of many sizes are converted to decimal and back, and malformed strings are read up to the first
+ *   character that isn't a digit
+ *
+ */
+
+#include "test.h"
+
+
+// set 'A' to 'v', with 'N' limbs
+static void radix_set64(mpt_limb_t* A, int64_t N, uint64_t v) {
+    int64_t i;
+    for (i = 0; i < N; ++i) {
+        A[i] = (mpt_limb_t)v;
+        v = MPT_LIMB_BITS < 64 ? v >> (MPT_LIMB_BITS % 64) : 0;
+    }
+}
+
+// read 'str', and check that it is 'v'
+static void radix_check(const char* str, uint64_t v) {
+    int64_t N = 64 / MPT_LIMB_BITS + 1;
+    mpt_limb_t A[64 / MPT_LIMB_BITS + 1], B[64 / MPT_LIMB_BITS + 1];
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", str);
+    mpt_setdecstr(A, N, buf);
+    radix_set64(B, N, v);
+    TEST_CHECK(mpt_cmp(N, A, B) == 0, "\"%s\" isn't %llu", str, (unsigned long long int)v);
+}
+
+// convert a random number with 'N' limbs to decimal and back (with junk after it), and check that it's the same
+static void radix_check_roundtrip(int64_t N, uint64_t* s) {
+    mpt_limb_t* A = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* B = malloc(N * MPT_LIMB_SIZE);
+    char* str = malloc(N * MPT_LIMB_BITS / 3 + 8);
+    test_fill(N, A, s);
+
+    mpt_getdecstr(A, N, str);
+    strcat(str, "x123");
+    mpt_setdecstr(B, N, str);
+    TEST_CHECK(mpt_cmp(N, A, B) == 0, "the round trip of %lli limbs", (long long int)N);
+
+    free(A);
+    free(B);
+    free(str);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    // malformed strings stop at the first character that isn't a digit
+    radix_check("12x4", 12);
+    radix_check("1204", 1204);
+    radix_check("", 0);
+    radix_check("x12", 0);
+    radix_check("-5", 0);
+    radix_check("42 7", 42);
+    radix_check("0007", 7);
+    radix_check("18446744073709551615", 18446744073709551615ULL);
+    radix_check("18446744073709551615:9", 18446744073709551615ULL);
+
+    // sizes around the blocks, and large enough to split many times
+    uint64_t s = 12345;
+    int64_t N;
+    for (N = 1; N <= 64; ++N) radix_check_roundtrip(N, &s);
+    for (N = 100; N <= 20000; N = N * 3 / 2) radix_check_roundtrip(N, &s);
+
+    return test_done();
+}
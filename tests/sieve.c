@@ -0,0 +1,64 @@
+/* tests/sieve.c - test 'mpt_sieve_t' against 'mpt_isprime_u64'
+ *
+ * The ranges start and end at odd places, and cross the edges of the segments (and of the batches of them, which
+ *   is why this uses more threads than the machine may have cores)
+ *
+ */
+
+#include "test.h"
+
+// (for 'mpt_isprime_u64', which is static)
+#include "MPT-impl.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// the numbers in each segment
+#define SIEVE_SPAN ((int64_t)MPT_SIEVE_SEGMENT * 30)
+
+// check that the sieve gives exactly the primes in [lo, hi), in order
+static void sieve_check(int64_t lo, int64_t hi) {
+    mpt_sieve_t s;
+    mpt_sieve_init(&s, lo, hi);
+
+    int64_t n = lo < 0 ? 0 : lo, q;
+    while ((q = mpt_sieve_next(&s)) >= 0) {
+        // (everything before it isn't prime)
+        for (; n < q && !mpt_isprime_u64(n); ++n);
+        if (n != q || q >= hi) break;
+        n++;
+    }
+    if (q < 0) {
+        for (; n < hi && !mpt_isprime_u64(n); ++n);
+    }
+    TEST_CHECK(q < 0 && n >= hi, "the primes in [%lli, %lli) differ at %lli (the sieve gave %lli)", (long long int)lo, (long long int)hi, (long long int)n, (long long int)q);
+
+    mpt_sieve_free(&s);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+#ifdef _OPENMP
+    omp_set_num_threads(3);
+#endif
+
+    // empty ranges, and the smallest primes (which aren't in the wheel)
+    int64_t lo, hi;
+    for (lo = 0; lo < 40; ++lo) {
+        for (hi = lo; hi < 40; ++hi) sieve_check(lo, hi);
+    }
+
+    // across the edges of the segments, and of the batches of them
+    sieve_check(0, 4 * SIEVE_SPAN + 17);
+    sieve_check(SIEVE_SPAN - 1, SIEVE_SPAN + 1);
+    sieve_check(SIEVE_SPAN - 101, 2 * SIEVE_SPAN + 13);
+    sieve_check(3 * SIEVE_SPAN - 7, 7 * SIEVE_SPAN + 7);
+
+    // far from 0 (so 'lo' is past the primes that the sieve is started with)
+    sieve_check(1000000000007LL, 1000000000007LL + SIEVE_SPAN + 1000);
+
+    return test_done();
+}
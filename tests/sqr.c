@@ -0,0 +1,161 @@
+/* tests/sqr.c - test the squaring kernels against the schoolbook square ('mpt_sqr_naive')
+ *
+ * Random numbers, and ones with every bit set (which have the most carries), of every size up to past the
+ *   crossovers of each algorithm
+ *
+ */
+
+#include "test.h"
+
+
+// a number to square: 'N' limbs, which are random (or all ones), and its square (by the schoolbook method)
+typedef struct {
+    int64_t N;
+    mpt_limb_t* A;
+    mpt_limb_t* C;
+} sqr_case_t;
+
+static void sqr_case_init(sqr_case_t* c, int64_t N, bool ones, uint64_t* s) {
+    c->N = N;
+    c->A = malloc(N * MPT_LIMB_SIZE);
+    c->C = malloc(2 * N * MPT_LIMB_SIZE);
+    if (ones) memset(c->A, 0xff, N * MPT_LIMB_SIZE);
+    else test_fill(N, c->A, s);
+    mpt_sqr_naive(N, c->A, c->C);
+}
+
+static void sqr_case_free(sqr_case_t* c) {
+    free(c->A);
+    free(c->C);
+}
+
+// check the NTT (see 'mpt_ntt_sqr')
+static void sqr_check_ntt(sqr_case_t* c, mpt_limb_t* C) {
+    mpt_ntt_t ntt;
+    mpt_ntt_init(&ntt, c->N);
+    mpt_ntt_sqr(&ntt, c->A, C);
+    mpt_ntt_free(&ntt);
+    TEST_CHECK(mpt_cmp(2 * c->N, C, c->C) == 0, "mpt_ntt_sqr of %lli limbs", (long long int)c->N);
+}
+
+// check the basecase, 'mpt_sqr_comba'
+static void sqr_check_comba(sqr_case_t* c, mpt_limb_t* C) {
+    mpt_sqr_comba(c->N, c->A, C);
+    TEST_CHECK(mpt_cmp(2 * c->N, C, c->C) == 0, "mpt_sqr_comba of %lli limbs", (long long int)c->N);
+}
+
+// check one of the recursive squarings, which use 'T' as scratch space
+static void sqr_check_rec(sqr_case_t* c, mpt_limb_t* C, mpt_limb_t* T, const char* name, void (*sqr)(int64_t N, mpt_limb_t* A, mpt_limb_t* C, mpt_limb_t* T)) {
+    sqr(c->N, c->A, C, T);
+    TEST_CHECK(mpt_cmp(2 * c->N, C, c->C) == 0, "%s of %lli limbs", name, (long long int)c->N);
+}
+
+// check every kernel on 'N' limbs
+static void sqr_check(int64_t N, bool ones, uint64_t* s) {
+    sqr_case_t c;
+    sqr_case_init(&c, N, ones, s);
+    mpt_limb_t* C = malloc(2 * N * MPT_LIMB_SIZE);
+    // ('mpt_sqr_scratch' is only enough for the algorithm that 'mpt_sqr' picks for 'N', and the others may be
+    //   forced here at any size, so this is more than any of them need)
+    mpt_limb_t* T = malloc(2 * mpt_sqr_scratch(N < MPT_SQR_TOOM4_THRESH ? MPT_SQR_TOOM4_THRESH : N) * MPT_LIMB_SIZE);
+
+    sqr_check_comba(&c, C);
+    sqr_check_ntt(&c, C);
+    sqr_check_rec(&c, C, T, "mpt_sqr", mpt_sqr);
+    // (they need at least 2, 3, and 4 pieces)
+    if (N >= 2) sqr_check_rec(&c, C, T, "mpt_sqr_kara", mpt_sqr_kara);
+    if (N >= 3) sqr_check_rec(&c, C, T, "mpt_sqr_toom3", mpt_sqr_toom3);
+    if (N >= 4) sqr_check_rec(&c, C, T, "mpt_sqr_toom4", mpt_sqr_toom4);
+
+    // the parallel basecase, on a few threads, and 'mpt_sqr' with them (which only uses it for some sizes)
+    int nthr;
+    for (nthr = 2; nthr <= 4; ++nthr) {
+        mpt_sqr_comba_par(N, c.A, C, nthr);
+        TEST_CHECK(mpt_cmp(2 * N, C, c.C) == 0, "mpt_sqr_comba_par of %lli limbs on %i threads", (long long int)N, nthr);
+    }
+    mpt_sqr_threads = 3;
+    sqr_check_rec(&c, C, T, "mpt_sqr (on 3 threads)", mpt_sqr);
+    mpt_sqr_threads = 1;
+
+    free(C);
+    free(T);
+    sqr_case_free(&c);
+}
+
+// check 'mpt_mul' of 'NA' by 'NB' limbs (NA >= NB)
+// The square of X = A + B*R (where R = 2^(M * MPT_LIMB_BITS), and A^2 and 2AB are less than R) is
+//   A^2 + 2AB*R + B^2*R^2, so the limbs [M, 2M) are 2AB (by the schoolbook square)
+static void sqr_check_mul(int64_t NA, int64_t NB, uint64_t* s) {
+    int64_t M = 2 * NA + 1, NX = M + NB;
+    mpt_limb_t* X = calloc(NX, MPT_LIMB_SIZE);
+    mpt_limb_t* X2 = malloc(2 * NX * MPT_LIMB_SIZE);
+    mpt_limb_t* C = calloc(M, MPT_LIMB_SIZE);
+    mpt_limb_t* T = malloc(mpt_mul_scratch(NA, NB) * MPT_LIMB_SIZE);
+    test_fill(NA, X, s);
+    test_fill(NB, &X[M], s);
+    mpt_sqr_naive(NX, X, X2);
+
+    mpt_mul(C, X, NA, &X[M], NB, T);
+    mpt_lshift(M, C, C, 1);
+    TEST_CHECK(mpt_cmp(M, C, &X2[M]) == 0, "mpt_mul of %lli by %lli limbs", (long long int)NA, (long long int)NB);
+
+    free(X);
+    free(X2);
+    free(C);
+    free(T);
+}
+
+// check 'mpt_add_n' and 'mpt_sub_n' on 'N' limbs: (A + B) - B must be A, with the carry out as the borrow
+static void sqr_check_addsub(int64_t N, uint64_t* s) {
+    mpt_limb_t* A = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* B = malloc(N * MPT_LIMB_SIZE);
+    mpt_limb_t* R = malloc(N * MPT_LIMB_SIZE);
+    test_fill(N, A, s);
+    test_fill(N, B, s);
+
+    mpt_limb_t cy = mpt_add_n(N, R, A, B);
+    mpt_limb_t bw = mpt_sub_n(N, R, R, B);
+    TEST_CHECK(cy == bw && mpt_cmp(N, R, A) == 0, "mpt_add_n and mpt_sub_n of %lli limbs", (long long int)N);
+
+    free(A);
+    free(B);
+    free(R);
+}
+
+// run every check, with the current kernels
+static void sqr_run() {
+    uint64_t s = 1;
+    int64_t N;
+    for (N = 1; N <= 1000; N += N < 100 ? 1 : 37) {
+        sqr_check(N, false, &s);
+        sqr_check(N, true, &s);
+        sqr_check_addsub(N, &s);
+    }
+
+    // the crossovers of 'mpt_mul', and a short number by a much longer one
+    sqr_check_mul(50, 50, &s);
+    sqr_check_mul(300, 300, &s);
+    sqr_check_mul(301, 150, &s);
+    sqr_check_mul(2000, 90, &s);
+    sqr_check_mul(2000, 7, &s);
+}
+
+int main(int argc, char** argv) {
+    test_init();
+
+    // every version of the kernels that this CPU supports (see 'mpt_kern_init')
+    static const char* kerns[] = { "generic", "adx", "avx2", "avx512", NULL };
+    int k;
+    for (k = 0; kerns[k] != NULL; ++k) {
+        if (!mpt_kern_init(kerns[k])) {
+            printf("  (skipping the '%s' kernels, which this CPU doesn't support)\n", kerns[k]);
+            continue;
+        }
+        int nfail = test_nfail;
+        sqr_run();
+        if (test_nfail > nfail) fprintf(stderr, "  (with the '%s' kernels)\n", kerns[k]);
+    }
+
+    mpt_kern_init(getenv("MPT_KERN"));
+    return test_done();
+}
@@ -0,0 +1,92 @@
+/* tests/test.h - the parts shared by the tests
+ *
+ * Each test is a program (see 'make check'), which checks things with 'TEST_CHECK', and returns nonzero if any of
+ *   them failed. The kernels can be picked with 'MPT_KERN', the same as for MPT
+ *
+ */
+
+#ifndef MPT_TEST_H__
+#define MPT_TEST_H__
+
+#include <MPT.h>
+
+
+// the number of checks that failed
+static int test_nfail = 0;
+
+// check that 'cond' holds, and if it doesn't, print the rest (a format, and its arguments), and count the failure
+#define TEST_CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL: %s:%i: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        test_nfail++; \
+    } \
+} while (0)
+
+// start a test
+static inline void test_init() {
+    mpt_time_init();
+    mpt_kern_init(getenv("MPT_KERN"));
+}
+
+// finish a test, and return its exit code
+static inline int test_done() {
+    mpt_plan_clear();
+    mpt_radix_clear();
+    if (test_nfail > 0) fprintf(stderr, "%i checks failed\n", test_nfail);
+    return test_nfail > 0;
+}
+
+// a random 64 bit value (xorshift64*), from the state 's'
+static inline uint64_t test_rand(uint64_t* s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 0x2545f4914f6cdd1dULL;
+}
+
+// fill 'A' (with 'N' limbs) with random limbs, from the state 's'
+static inline void test_fill(int64_t N, mpt_limb_t* A, uint64_t* s) {
+    int64_t i;
+    for (i = 0; i < N; ++i) A[i] = (mpt_limb_t)test_rand(s);
+}
+
+// the Mersenne prime exponents (up to 44497), ending with 0
+static const int64_t test_mp[] = {
+    2, 3, 5, 7, 13, 17, 19, 31, 61, 89, 107, 127, 521, 607, 1279, 2203, 2281, 3217, 4253, 4423, 9689, 9941,
+    11213, 19937, 21701, 23209, 44497, 0
+};
+
+// return whether 2^p - 1 is prime (for 'p' up to 44497)
+static inline bool test_is_mp(int64_t p) {
+    int i;
+    for (i = 0; test_mp[i] != 0; ++i) {
+        if (test_mp[i] == p) return true;
+    }
+    return false;
+}
+
+// call 'test' (with 'arg') on the known exponents up to 'maxp', and check that it says 2^p - 1 is prime for
+//   exactly the Mersenne prime exponents
+// The rest are every number up to 600 (prime or not), and a few larger prime exponents (some of which don't have
+//   a small factor, so only the whole test finds that they are composite)
+static inline void test_known(const char* what, bool (*test)(void* arg, int64_t p), void* arg, int64_t maxp) {
+    static const int64_t big[] = { 1277, 2221, 3001, 4421, 9973, 11239, 21683, 0 };
+
+    int64_t p;
+    int i = 0, j;
+    for (p = 1; p <= maxp; ++p) {
+        bool isp = test_mp[i] == p, big_p = false;
+        if (isp) i++;
+        for (j = 0; big[j] != 0; ++j) big_p = big_p || big[j] == p;
+
+        if (p <= 600 || isp || big_p) {
+            bool res = test(arg, p);
+            TEST_CHECK(res == isp, "%s says M%lli is %s", what, (long long int)p, res ? "prime" : "composite");
+        }
+    }
+}
+
+
+#endif /* MPT_TEST_H__ */